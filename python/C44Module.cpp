@@ -0,0 +1,330 @@
+// C44Module.cpp
+//
+// CPython extension exposing the C44 point transform to pipeline scripts.
+// Arrays are accessed in place through the buffer protocol (NumPy arrays,
+// memoryviews, array.array...), the GIL is released while transforming and
+// large arrays are split across threads.
+//
+//   import c44
+//   cam = c44.transform(P_world, matrix, invert=True)
+//   c44.transform(points, matrix, out=points, w_divide=True)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "core/C44Transform.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Arrays smaller than this are not worth starting threads for.
+const size_t kMinPointsPerThread = 1 << 16;
+
+
+// Releases a Py_buffer when it goes out of scope.
+struct BufferGuard
+{
+	Py_buffer view;
+	bool      held = false;
+
+	~BufferGuard() { if (held) PyBuffer_Release(&view); }
+};
+
+
+// Parses 16 numbers, either flat or as 4 rows of 4, in the order of the
+// C44Matrix "matrix" knob.
+bool parseMatrix(PyObject* obj, c44::Mat4d& mtx)
+{
+	PyObject* seq = PySequence_Fast(obj, "matrix must be a sequence of 16 numbers or 4x4");
+	if (!seq)
+		return false;
+
+	const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+	bool ok = true;
+
+	if (n == 16) {
+		for (Py_ssize_t i = 0; i < 16 && ok; ++i) {
+			mtx.m[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+			ok = !PyErr_Occurred();
+		}
+	}
+	else if (n == 4) {
+		for (Py_ssize_t r = 0; r < 4 && ok; ++r) {
+			PyObject* row = PySequence_Fast(PySequence_Fast_GET_ITEM(seq, r),
+			                                "matrix rows must be sequences");
+			ok = row && PySequence_Fast_GET_SIZE(row) == 4;
+			for (Py_ssize_t c = 0; c < 4 && ok; ++c) {
+				mtx.m[r * 4 + c] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(row, c));
+				ok = !PyErr_Occurred();
+			}
+			if (row && !ok && !PyErr_Occurred())
+				PyErr_SetString(PyExc_ValueError, "matrix rows must have 4 values");
+			Py_XDECREF(row);
+		}
+	}
+	else {
+		PyErr_SetString(PyExc_ValueError, "matrix must have 16 values or 4 rows of 4");
+		ok = false;
+	}
+
+	Py_DECREF(seq);
+	return ok;
+}
+
+
+// Element type of a buffer: 'e', 'f', 'd' or 0 if unsupported.
+char bufferType(const Py_buffer& view)
+{
+	const char* fmt = view.format ? view.format : "B";
+	if (*fmt == '@' || *fmt == '=' || *fmt == '<')
+		++fmt;
+	if (fmt[1] != '\0')
+		return 0;
+	if (*fmt == 'e' && view.itemsize == 2)
+		return 'e';
+	if (*fmt == 'f' && view.itemsize == 4)
+		return 'f';
+	if (*fmt == 'd' && view.itemsize == 8)
+		return 'd';
+	return 0;
+}
+
+
+// Checks for an (N, 3) or (N, 4) array with contiguous components and
+// returns the point stride in elements.
+bool pointLayout(const Py_buffer& view, const char* what, Py_ssize_t& points,
+                 int& components, size_t& stride)
+{
+	if (view.ndim != 2 || (view.shape[1] != 3 && view.shape[1] != 4)) {
+		PyErr_Format(PyExc_ValueError, "%s must have shape (N, 3) or (N, 4)", what);
+		return false;
+	}
+	if (view.strides[1] != view.itemsize || view.strides[0] <= 0 ||
+	    view.strides[0] % view.itemsize != 0) {
+		PyErr_Format(PyExc_ValueError,
+		             "%s must have contiguous components and a positive row stride", what);
+		return false;
+	}
+	points = view.shape[0];
+	components = int(view.shape[1]);
+	stride = size_t(view.strides[0] / view.itemsize);
+	return true;
+}
+
+
+// Creates numpy.empty(shape, dtype) for the default output.
+PyObject* newOutputArray(Py_ssize_t points, int components, char type)
+{
+	PyObject* numpy = PyImport_ImportModule("numpy");
+	if (!numpy) {
+		PyErr_Clear();
+		PyErr_SetString(PyExc_TypeError, "out= is required when NumPy is not installed");
+		return nullptr;
+	}
+	PyObject* out = PyObject_CallMethod(numpy, "empty", "((ni)s)", points, components,
+	                                    type == 'd' ? "float64" : type == 'e' ? "float16" : "float32");
+	Py_DECREF(numpy);
+	return out;
+}
+
+
+// Splits [0, n) over 'threads' workers; fn(begin, end) runs without the GIL.
+template <typename Fn>
+void parallelPoints(size_t n, unsigned threads, Fn fn)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	threads = unsigned(std::min<size_t>(threads, std::max<size_t>(1, n / kMinPointsPerThread)));
+
+	if (threads <= 1) {
+		fn(size_t(0), n);
+		return;
+	}
+
+	std::vector<std::thread> pool;
+	const size_t per = (n + threads - 1) / threads;
+	for (unsigned t = 1; t < threads; ++t) {
+		const size_t b = std::min(n, t * per);
+		const size_t e = std::min(n, b + per);
+		pool.emplace_back([=] { fn(b, e); });
+	}
+	fn(size_t(0), std::min(n, per));
+	for (std::thread& t : pool)
+		t.join();
+}
+
+
+PyObject* c44_transform(PyObject*, PyObject* args, PyObject* kwargs)
+{
+	static const char* kwlist[] = { "points", "matrix", "out", "invert", "transpose",
+	                                "w_divide", "double", "classify", "threads", nullptr };
+	PyObject* pointsObj = nullptr;
+	PyObject* matrixObj = nullptr;
+	PyObject* outObj = Py_None;
+	int invert = 0, transpose = 0, wDivide = 0, useDouble = 0, useClass = 1;
+	unsigned threads = 0;
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|$OpppppI", const_cast<char**>(kwlist),
+	                                 &pointsObj, &matrixObj, &outObj, &invert, &transpose,
+	                                 &wDivide, &useDouble, &useClass, &threads))
+		return nullptr;
+
+	c44::Mat4d mtx;
+	if (!parseMatrix(matrixObj, mtx))
+		return nullptr;
+	if (transpose)
+		mtx = c44::transpose(mtx);
+	if (invert && !c44::invert(mtx, mtx)) {
+		PyErr_SetString(PyExc_ValueError, "matrix is not invertible");
+		return nullptr;
+	}
+
+	BufferGuard in;
+	if (PyObject_GetBuffer(pointsObj, &in.view, PyBUF_STRIDES | PyBUF_FORMAT) != 0)
+		return nullptr;
+	in.held = true;
+
+	const char type = bufferType(in.view);
+	if (!type) {
+		PyErr_SetString(PyExc_TypeError, "points must be float16, float32 or float64");
+		return nullptr;
+	}
+	Py_ssize_t points = 0;
+	int components = 0;
+	size_t inStride = 0;
+	if (!pointLayout(in.view, "points", points, components, inStride))
+		return nullptr;
+
+	PyObject* result = nullptr;
+	if (outObj == Py_None) {
+		result = newOutputArray(points, components, type);
+		if (!result)
+			return nullptr;
+	}
+	else {
+		Py_INCREF(outObj);
+		result = outObj;
+	}
+
+	BufferGuard out;
+	if (PyObject_GetBuffer(result, &out.view, PyBUF_STRIDES | PyBUF_FORMAT | PyBUF_WRITABLE) != 0) {
+		Py_DECREF(result);
+		return nullptr;
+	}
+	out.held = true;
+
+	Py_ssize_t outPoints = 0;
+	int outComponents = 0;
+	size_t outStride = 0;
+	if (bufferType(out.view) != type ||
+	    !pointLayout(out.view, "out", outPoints, outComponents, outStride) ||
+	    outPoints != points || outComponents != components) {
+		if (!PyErr_Occurred())
+			PyErr_SetString(PyExc_ValueError, "out must match the shape and dtype of points");
+		Py_DECREF(result);
+		return nullptr;
+	}
+
+	const bool wd = wDivide != 0, cls = useClass != 0;
+	const c44::Mat4f mtxf = [&] {
+		c44::Mat4f f;
+		for (int i = 0; i < 16; ++i)
+			f.m[i] = float(mtx.m[i]);
+		return f;
+	}();
+
+	Py_BEGIN_ALLOW_THREADS
+	if (type == 'd') {
+		const double* src = static_cast<const double*>(in.view.buf);
+		double* dst = static_cast<double*>(out.view.buf);
+		parallelPoints(size_t(points), threads, [&](size_t b, size_t e) {
+			c44::transformPoints(mtx, wd, cls, src + b * inStride, inStride,
+			                     dst + b * outStride, outStride, e - b, components);
+		});
+	}
+	else if (type == 'e') {
+		// Half data is converted on the fly by the strided kernels, in float.
+		const uint16_t* src = static_cast<const uint16_t*>(in.view.buf);
+		uint16_t* dst = static_cast<uint16_t*>(out.view.buf);
+		parallelPoints(size_t(points), threads, [&](size_t b, size_t e) {
+			c44::ConstStridedPoints sp;
+			c44::StridedPoints dp;
+			sp.type = dp.type = c44::SampleType::Half;
+			for (int c = 0; c < 4; ++c) {
+				const bool has = c < components;
+				sp.ptr[c] = has ? src + b * inStride + c : nullptr;
+				dp.ptr[c] = has ? dst + b * outStride + c : nullptr;
+				sp.stride[c] = ptrdiff_t(inStride * sizeof(uint16_t));
+				dp.stride[c] = ptrdiff_t(outStride * sizeof(uint16_t));
+			}
+			c44::transformStrided(mtxf, wd, sp, dp, e - b);
+		});
+	}
+	else {
+		const float* src = static_cast<const float*>(in.view.buf);
+		float* dst = static_cast<float*>(out.view.buf);
+		parallelPoints(size_t(points), threads, [&](size_t b, size_t e) {
+			if (useDouble)
+				c44::transformPoints(mtx, wd, cls, src + b * inStride, inStride,
+				                     dst + b * outStride, outStride, e - b, components);
+			else
+				c44::transformPoints(mtxf, wd, cls, src + b * inStride, inStride,
+				                     dst + b * outStride, outStride, e - b, components);
+		});
+	}
+	Py_END_ALLOW_THREADS
+
+	return result;
+}
+
+
+PyObject* c44_classify(PyObject*, PyObject* arg)
+{
+	c44::Mat4d mtx;
+	if (!parseMatrix(arg, mtx))
+		return nullptr;
+	return PyUnicode_FromString(c44::matrixClassName(c44::classify(mtx)));
+}
+
+
+PyMethodDef methods[] = {
+	{ "transform", reinterpret_cast<PyCFunction>(reinterpret_cast<void*>(c44_transform)),
+	  METH_VARARGS | METH_KEYWORDS,
+	  "transform(points, matrix, *, out=None, invert=False, transpose=False,\n"
+	  "          w_divide=False, double=False, classify=True, threads=0)\n"
+	  "\n"
+	  "Applies a C44Matrix matrix to an (N, 3) or (N, 4) float16/float32/float64\n"
+	  "array. float16 points are computed in float32 and rounded back.\n"
+	  "'matrix' holds 16 values (or 4 rows of 4) in the order of the node's\n"
+	  "matrix knob; transpose is applied before invert, as in the node.\n"
+	  "Three-component points have an implicit w of 1. 'out' may be 'points'\n"
+	  "itself for an in-place transform; by default a new NumPy array is\n"
+	  "returned. 'double' computes float32 data in double precision.\n"
+	  "'classify' lets identity/affine matrices take cheaper paths. Large\n"
+	  "arrays are split over 'threads' threads (0 = all cores)." },
+	{ "classify", c44_classify, METH_O,
+	  "classify(matrix) -> 'identity', 'affine' or 'general'" },
+	{ nullptr, nullptr, 0, nullptr }
+};
+
+
+PyModuleDef module = {
+	PyModuleDef_HEAD_INIT,
+	"c44",
+	"Batch 4x4 point transforms sharing C44Matrix's math.",
+	-1,
+	methods,
+	nullptr, nullptr, nullptr, nullptr
+};
+
+} // namespace
+
+
+PyMODINIT_FUNC PyInit_c44()
+{
+	return PyModule_Create(&module);
+}
@@ -5,11 +5,21 @@
 
 static const char* const HELP = "Applies a 4x4 matrix to pixel data.\n"
 		"The matrix can be entered manually, or taken"
-		" from a camera or axis input.\n";
+		" from a camera or axis input or from the input's metadata,"
+		" or composed from several camera/axis inputs with an expression.\n"
+		"In channel matrix mode it applies a matrix of up to 8x8 from any"
+		" set of input channels to any set of output channels instead.\n"
+		"Up to three more matrices can be applied to the same RGBA in the"
+		" same pass, each written to its own output layer.\n";
 
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <chrono>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
 #include <DDImage/Convolve.h>
 #include "DDImage/PixelIop.h"
 #include <DDImage/CameraOp.h>
@@ -23,20 +33,105 @@ static const char* const HELP = "Applies a 4x4 matrix to pixel data.\n"
 #include "DDImage/Matrix3.h"
 #include "DDImage/Matrix4.h"
 
+#include "core/C44Expr.h"
+#include "core/C44MatrixCache.h"
+#include "core/C44Probes.h"
+#include "core/C44Stats.h"
+#include "core/C44Trace.h"
+#include "core/C44Transform.h"
+
 
 using namespace DD::Image;
 
 
 
-static const char* const matrixFromOptions[] = { "manual input", "from camera/axis input", 0};
+static const char* const matrixFromOptions[] = { "manual input", "from camera/axis input", "from input metadata", "from expression", 0};
 static const char* const cameraMatrixOptions[] = { "transform", "translation", "rotation", "scale", "projection", "format" , 0};
+static const char* const metadataLayoutOptions[] = { "4x4 row-major", "4x4 column-major", "3x4 row-major", "3x4 column-major", 0};
+static const char* const fanOutFromOptions[] = { "manual input", "from camera/axis input", "from input metadata", 0};
+
+// Knobs of each fan-out entry.
+static const int kFanOutEntries = c44::kMaxFanOut - 1;
+struct FanOutKnobNames { const char *layer, *from, *type, *key, *matrix, *invert, *wDivide; };
+static const FanOutKnobNames fanOutKnobs[kFanOutEntries] = {
+	{ "fanOut1Layer", "fanOut1From", "fanOut1Type", "fanOut1Key", "fanOut1Matrix", "fanOut1Invert", "fanOut1WDivide" },
+	{ "fanOut2Layer", "fanOut2From", "fanOut2Type", "fanOut2Key", "fanOut2Matrix", "fanOut2Invert", "fanOut2WDivide" },
+	{ "fanOut3Layer", "fanOut3From", "fanOut3Type", "fanOut3Key", "fanOut3Matrix", "fanOut3Invert", "fanOut3WDivide" },
+};
 class C44Matrix : public PixelIop, public ArrayKnobI::ValueProvider
 {
-	int 						_matrixFrom, _matrixOption;
+	int 						_matrixFrom, _matrixOption, _metadataLayout;
+	const char* 				_metadataKey;
+	bool 						_metadataMissing;	// set and reported by _validate
+	const char* 				_expression;
+	std::string 				_expressionError;	// likewise
+
+	// The expression knob compiled, shared by every Op of the node through
+	// the first one and compiled again only when the text changes.
+	mutable std::mutex 								_exprLock;
+	mutable std::shared_ptr<const c44::MatrixExpr> 	_expr;
 	ChannelSet 					channels;
 	Matrix4 					camxforminv, shiftmtx, unproj, array_mtx;
+	c44::PlanarPlan 				engine_plan;
+	unsigned 					compute_mask;	// RGBA channels not passed through
 	ConvolveArray		        _arrayKnob;
-	bool 						_invert, _transpose, _w_divide;
+	bool 						_invert, _transpose, _w_divide, _reproducible;
+
+	// Channel matrix mode: _channelArray from _inChannels to _outChannels,
+	// row r giving the r-th output channel, in place of the 4x4 on RGBA.
+	// channel_in and channel_out list the channels in the kernel's order.
+	bool 						_channelMode;
+	ChannelSet 					_inChannels, _outChannels;
+	ConvolveArray 				_channelArray;
+	c44::ChannelPlan 			channel_plan;
+	Channel 					channel_in[c44::kMaxChannels], channel_out[c44::kMaxChannels];
+
+	// Fan-out: more matrices applied to the same RGBA, each written to the
+	// first four channels of its layer as x y z w, in one pass with the main
+	// matrix. Entries without a layer are off. fanout_plan has the main
+	// matrix first and then the entries that are on; fanout_out lists the
+	// channels of each, Chan_Black where its layer has fewer than four.
+	struct FanOutEntry
+	{
+		ChannelSet 				layer;
+		int 					from, option;
+		const char* 			key;
+		ConvolveArray 			matrix;
+		bool 					invert, wDivide;
+	};
+	FanOutEntry 				_fanOut[kFanOutEntries];
+	c44::FanOutPlan 			fanout_plan;	// count 0 when no entry is on
+	Channel 					fanout_out[c44::kMaxFanOut][4];
+	std::string 				_fanOutMissing;	// metadata keys not found
+
+	// The matrix as applied and its inverse, in double, built with
+	// engine_plan and written to the output metadata when _publish is on.
+	bool 						_publish;
+	const char* 				_publishKey;
+	const char* 				_publishInverseKey;
+	c44::Mat4d 					published_mtx, published_inv;
+	bool 						published_invertible;
+	MetaData::Bundle 			_metadata;
+
+	// engine_plan was built from this source matrix (the knob's or the
+	// metadata's); _validate reuses it while it stays the same.
+	float 						_planKey[16];
+	c44::ChannelMatrix 			_channelPlanKey;	// likewise, for channel_plan
+	unsigned 					_planFlags;
+	bool 						_planValid;
+
+	// Counters for the Diagnostics tab. Every Op of the node counts into
+	// the first one's, which is the one whose knobs the panel shows.
+	mutable c44::NodeStats 		_stats;
+	C44Matrix* 					_statsOp;
+	const char* 				_statsText;
+
+	// Metadata, expression and fan-out camera matrices worked out in
+	// _validate, shared by every Op of the node through the first one.
+	mutable c44::MatrixCache 	_matrixCache;
+
+	c44::NodeStats& stats() const { return static_cast<C44Matrix*>(firstOp())->_stats; }
+	void updateStatsKnob() { knob("stats")->set_text(_stats.report(cameraMatrixOptions).c_str()); }
 
 protected:
 	CameraOp* _cam;
@@ -47,15 +142,43 @@ public:
 
 	_matrixFrom(0),
 	_matrixOption(0),
+	_metadataLayout(1),
+	_metadataKey("exr/worldToCamera"),
+	_metadataMissing(false),
+	_expression(""),
+	compute_mask(15u),
 	_invert(false),
 	_transpose(false),
 	_w_divide(false),
-	_arrayKnob()
-	{}
+	_reproducible(false),
+	_channelMode(false),
+	_inChannels(Mask_RGBA),
+	_outChannels(Mask_RGBA),
+	_publish(false),
+	_publishKey("c44/matrix"),
+	_publishInverseKey("c44/matrixInverse"),
+	published_invertible(false),
+	_planFlags(0),
+	_planValid(false),
+	_statsOp(this),
+	_statsText(NULL)
+	{
+		for (int k = 0; k < kFanOutEntries; ++k) {
+			_fanOut[k].from = 0;
+			_fanOut[k].option = 0;
+			_fanOut[k].key = "exr/worldToNDC";
+			_fanOut[k].invert = false;
+			_fanOut[k].wDivide = false;
+		}
+	}
 
 	bool pass_transform() const { return true; }
-	virtual int minimum_inputs() const { return 1 + int(_matrixFrom == 1); }
-	virtual int maximum_inputs() const { return 1 + int(_matrixFrom == 1); }
+	virtual int minimum_inputs() const { return 1 + matrixInputs(); }
+	virtual int maximum_inputs() const { return 1 + matrixInputs(); }
+	int matrixInputs() const;
+	bool fanOutFromCamera() const;
+	void showSourceKnobs();
+	std::shared_ptr<const c44::MatrixExpr> compiledExpr(const char* text) const;
 	virtual void knobs(Knob_Callback);
 	int knob_changed(DD::Image::Knob* k);
 	static const Iop::Description d;
@@ -64,18 +187,33 @@ public:
 
 	// ArrayKnobI stuff
 	virtual std::vector<double> provideValues(const ArrayKnobI* arrayKnob, const DD::Image::OutputContext& oc) const;
+	Matrix4 resolveMatrix(Op* inputOp, int option) const;
+	Matrix4 metadataMatrix(const DD::Image::OutputContext& context) const;
+	bool readMetadataMatrix(const char* key, int layout, Matrix4& mtx) const;
+	bool findMatrix(uint64_t key, float m[16], c44::MatrixLookup kind) const;
+	uint64_t metadataKeyHash(Op* in, const char* key, int layout, const DD::Image::OutputContext& context) const;
+	Matrix4 fanOutMatrix(const FanOutEntry& e);
+	Matrix4 expressionMatrix(const DD::Image::OutputContext& context, bool resolve, std::string* error = NULL) const;
+	uint64_t matrixKey(Op* op, int option) const;
 	bool provideValuesEnabled(const DD::Image::ArrayKnobI* None, const DD::Image::OutputContext& oc) const {
-		return (knob("matrixFrom")->get_value()==1);}
+		return (knob("matrixFrom")->get_value()!=0);}
 
 	void _validate(bool);
+	bool _validateFanOut(ChannelSet& outchans);
+	void _validateChannels();
 	void _request(int x, int y, int r, int t, ChannelMask channels, int count);
+	const MetaData::Bundle& _fetchMetaData(const char* keyname);
 	void in_channels(int input, ChannelSet& mask) const {
 		if (input == 0) {
-			mask += Mask_RGBA;
+			if (_channelMode)
+				mask += _inChannels;
+			else
+				mask += Mask_RGBA;
 		}
 	}
 
 	void pixel_engine(const Row &in, int y, int x, int r, ChannelMask channels, Row &out);
+	void rgbaEngine(const Row &in, int y, int x, size_t width, ChannelMask channels, Row &out);
 
 	bool test_input(int n, Op *op)  const {   // Test input to accept 1 Iop input and CameraOp or AxisOp inputs
 
@@ -97,6 +235,13 @@ public:
 
 
 	const char* input_label(int input, char* buffer) const {
+		if (input >= 1 && _matrixFrom == 3) {
+			const std::shared_ptr<const c44::MatrixExpr> expr = compiledExpr(_expression);
+			if (size_t(input) > expr->inputs().size())
+				return NULL;
+			snprintf(buffer, 64, "%s", expr->inputs()[input - 1].c_str());
+			return buffer;
+		}
 		switch (input) {
 		case 0: return "img";
 		case 1: return "cam/axis";
@@ -106,102 +251,529 @@ public:
 
 std::vector<double>
 C44Matrix::provideValues(const ArrayKnobI* arrayKnob, const DD::Image::OutputContext& context) const {
+	c44::trace::Span span("provideValues");
+	stats().add(c44::Stat::Provides);
 	std::vector<double> values;
 	Matrix4 cam_mtx;
 	cam_mtx.makeIdentity();
 	if (knob("matrixFrom")->get_value_at(context.frame(), context.view())==1) {
 		Op* inputOp = Op::input(1);
-		CameraOp* _camOp = dynamic_cast<CameraOp*>(inputOp);
-		AxisOp* _axisOp = dynamic_cast<AxisOp*>(inputOp);
-		
-		if (_camOp != NULL) {
+		int option = knob("matrixType")->get_value_at(context.frame(), context.view());
+		cam_mtx = resolveMatrix(inputOp, option);
+	}
+	else if (knob("matrixFrom")->get_value_at(context.frame(), context.view())==2) {
+		cam_mtx = metadataMatrix(context);
+	}
+	else if (knob("matrixFrom")->get_value_at(context.frame(), context.view())==3) {
+		cam_mtx = expressionMatrix(context, false);
+	}
+
+	const float* mtx_vals = cam_mtx.array();
+	int i = 0;
+	while (i<16) {
+		values.push_back(mtx_vals[i++]);
+	}
+
+	return values;
+}
+
+// Validates the camera or axis 'inputOp' and reads matrix type 'option'
+// from it, timed into the stats.
+Matrix4
+C44Matrix::resolveMatrix(Op* inputOp, int option) const {
+	Matrix4 cam_mtx;
+	cam_mtx.makeIdentity();
+	CameraOp* _camOp = dynamic_cast<CameraOp*>(inputOp);
+	AxisOp* _axisOp = dynamic_cast<AxisOp*>(inputOp);
+
+	if (_camOp != NULL) {
+		const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		{
+			c44::trace::Span validateSpan("camera validate");
 			_camOp->validate();
-			int option = knob("matrixType")->get_value_at(context.frame(), context.view());
-			switch (option) {
-			case 0:
-				cam_mtx = _camOp->matrix();
-				break;
-			case 1:
-				cam_mtx = _camOp->matrix();
-				cam_mtx.translationOnly();
-				break;
-			case 2:
-				cam_mtx = _camOp->matrix();
-				cam_mtx.rotationOnly();
-				break;
-			case 3:
-				cam_mtx = _camOp->matrix();
-				cam_mtx.scaleOnly();
-				break;
-			case 4:
-				cam_mtx = _camOp->projection();
-				break;
-			case 5:
-				_camOp->to_format(cam_mtx, &input_format());
-				break;
+		}
+		const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		switch (option) {
+		case 0:
+			cam_mtx = _camOp->matrix();
+			break;
+		case 1:
+			cam_mtx = _camOp->matrix();
+			cam_mtx.translationOnly();
+			break;
+		case 2:
+			cam_mtx = _camOp->matrix();
+			cam_mtx.rotationOnly();
+			break;
+		case 3:
+			cam_mtx = _camOp->matrix();
+			cam_mtx.scaleOnly();
+			break;
+		case 4:
+			cam_mtx = _camOp->projection();
+			break;
+		case 5:
+			_camOp->to_format(cam_mtx, &input_format());
+			break;
 
-			}
 		}
-		else if (_axisOp != NULL) {
+		stats().addResolve(c44::MatrixSource::Camera, option, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()),
+			                   uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t1).count()));
+	}
+	else if (_axisOp != NULL) {
+		const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		{
+			c44::trace::Span validateSpan("axis validate");
 			_axisOp->validate();
-			int option = knob("matrixType")->get_value_at(context.frame(), context.view());
-			switch (option) {
-			case 0:
-				cam_mtx = _axisOp->matrix();
-				break;
-			case 1:
-				cam_mtx = _axisOp->matrix();
-				cam_mtx.translationOnly();
-				break;
-			case 2:
-				cam_mtx = _axisOp->matrix();
-				cam_mtx.rotationOnly();
-				break;
-			case 3:
-				cam_mtx = _axisOp->matrix();
-				cam_mtx.scaleOnly();
-				break;
-			case 4:
-				// Projection doesn't apply to Axis, use identity
-				cam_mtx.makeIdentity();
-				break;
-			case 5:
-				// Format doesn't apply to Axis, use identity
-				cam_mtx.makeIdentity();
-				break;
+		}
+		const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		switch (option) {
+		case 0:
+			cam_mtx = _axisOp->matrix();
+			break;
+		case 1:
+			cam_mtx = _axisOp->matrix();
+			cam_mtx.translationOnly();
+			break;
+		case 2:
+			cam_mtx = _axisOp->matrix();
+			cam_mtx.rotationOnly();
+			break;
+		case 3:
+			cam_mtx = _axisOp->matrix();
+			cam_mtx.scaleOnly();
+			break;
+		case 4:
+			// Projection doesn't apply to Axis, use identity
+			cam_mtx.makeIdentity();
+			break;
+		case 5:
+			// Format doesn't apply to Axis, use identity
+			cam_mtx.makeIdentity();
+			break;
 
-			}
 		}
+		stats().addResolve(c44::MatrixSource::Axis, option, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()),
+			                   uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t1).count()));
 	}
+	return cam_mtx;
+}
 
-	const float* mtx_vals = cam_mtx.array();
-	int i = 0;
-	while (i<16) {
-		values.push_back(mtx_vals[i++]);
+// The metadata matrix at 'context' as _validate read it at that frame, or
+// the identity for a frame the node has not been validated at. Value
+// providers are called on any thread and for any frame, so they don't
+// fetch metadata themselves.
+Matrix4
+C44Matrix::metadataMatrix(const DD::Image::OutputContext& context) const {
+	c44::trace::Span span("metadataMatrix");
+	Matrix4 mtx;
+	mtx.makeIdentity();
+	Op* in = node_input(0, Op::EXECUTABLE_INPUT, &context);
+	if (in == NULL)
+		return mtx;
+	int layout = knob("metadataLayout")->get_value_at(context.frame(), context.view());
+	float a[16];
+	if (findMatrix(metadataKeyHash(in, knob("metadataKey")->get_text(), layout, context), a, c44::MatrixLookup::Metadata))
+		mtx = Matrix4(a);
+	return mtx;
+}
+
+// Looks 'key' up in the first Op's _matrixCache, firing the matrix_hit or
+// matrix_miss probe for 'kind'.
+bool
+C44Matrix::findMatrix(uint64_t key, float m[16], c44::MatrixLookup kind) const {
+	const C44Matrix* first = static_cast<C44Matrix*>(firstOp());
+	if (first->_matrixCache.find(key, m)) {
+		C44_PROBE2(matrix_hit, first, int(kind));
+		return true;
+	}
+	C44_PROBE2(matrix_miss, first, int(kind));
+	return false;
+}
+
+// Key of matrix 'key' of the metadata of input 'in' at 'context' in
+// _matrixCache. Metadata can change from frame to frame while the input's
+// hash stays the same, so the frame is part of it.
+uint64_t
+C44Matrix::metadataKeyHash(Op* in, const char* key, int layout, const DD::Image::OutputContext& context) const {
+	Hash h = in->hash();
+	h.append("metadata");
+	h.append(key);
+	h.append(layout);
+	h.append(context.frame());
+	h.append(context.view());
+	return h.value();
+}
+
+// Reads matrix 'key' from the input's metadata into 'mtx': 16 numbers (4x4)
+// or 12 (3x4, with 0 0 0 1 as the last row), row by row as it applies to
+// (r, g, b, a) or column by column, which is how EXR files store
+// worldToCamera and worldToNDC. Without the key, 'mtx' is the identity and
+// the result false. Called from _validate, for this Op's context. It is
+// parsed once per input hash, key, layout and frame, and then comes from
+// _matrixCache.
+bool
+C44Matrix::readMetadataMatrix(const char* key, int layout, Matrix4& mtx) const {
+	mtx.makeIdentity();
+	Iop* in = dynamic_cast<Iop*>(Op::input(0));
+	if (in == NULL)
+		return true;
+
+	const uint64_t cacheKey = metadataKeyHash(in, key, layout, outputContext());
+	const C44Matrix* first = static_cast<C44Matrix*>(firstOp());
+	float a[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };	// column-major
+	if (findMatrix(cacheKey, a, c44::MatrixLookup::Metadata)) {
+		mtx = Matrix4(a);
+		return true;
 	}
 
-	return values;
+	in->validate(true);
+	const MetaData::Property& prop = in->fetchMetaData(NULL).getData(key ? key : "");
+	const int rows = layout >= 2 ? 3 : 4;
+	const bool columnMajor = (layout & 1) != 0;
+	if (MetaData::propertySize(prop) != size_t(rows * 4))
+		return false;
+	for (int r = 0; r < rows; ++r)
+		for (int c = 0; c < 4; ++c)
+			a[c * 4 + r] = float(MetaData::propertyDouble(prop, size_t(columnMajor ? c * rows + r : r * 4 + c)));
+	first->_matrixCache.insert(cacheKey, a);
+	mtx = Matrix4(a);
+	return true;
+}
+
+// The matrix of fan-out entry 'e' for this frame, before its invert. The
+// camera/axis one goes through _matrixCache, so that a camera shared by
+// several entries or frames is validated once.
+Matrix4
+C44Matrix::fanOutMatrix(const FanOutEntry& e) {
+	Matrix4 mtx;
+	mtx.makeIdentity();
+	if (e.from == 0)
+		return Matrix4(e.matrix.array);
+
+	if (e.from == 2) {
+		if (!readMetadataMatrix(e.key, _metadataLayout, mtx)) {
+			_fanOutMissing += _fanOutMissing.empty() ? "'" : ", '";
+			_fanOutMissing += std::string(e.key) + "'";
+		}
+		return mtx;
+	}
+
+	Op* inputOp = Op::input(1);
+	if (dynamic_cast<AxisOp*>(inputOp) == NULL)
+		return mtx;
+	const C44Matrix* first = static_cast<C44Matrix*>(firstOp());
+	const uint64_t key = matrixKey(inputOp, e.option);
+	float cached[16];
+	if (findMatrix(key, cached, c44::MatrixLookup::FanOut))
+		return Matrix4(cached);
+	mtx = resolveMatrix(inputOp, e.option);
+	first->_matrixCache.insert(key, mtx.array());
+	return mtx;
+}
+
+// The expression knob compiled, from the first Op's copy.
+std::shared_ptr<const c44::MatrixExpr>
+C44Matrix::compiledExpr(const char* text) const {
+	const C44Matrix* first = static_cast<C44Matrix*>(firstOp());
+	const std::string source = text ? text : "";
+	std::lock_guard<std::mutex> lock(first->_exprLock);
+	if (!first->_expr || first->_expr->text() != source) {
+		std::shared_ptr<c44::MatrixExpr> e = std::make_shared<c44::MatrixExpr>();
+		e->compile(source);
+		first->_expr = e;
+	}
+	return first->_expr;
+}
+
+// Camera/axis inputs after the image: one, or one per name in the expression.
+int
+C44Matrix::matrixInputs() const {
+	if (_matrixFrom == 1)
+		return 1;
+	if (_matrixFrom == 3)
+		return int(compiledExpr(_expression)->inputs().size());
+	return fanOutFromCamera() ? 1 : 0;
+}
+
+// A fan-out entry that is on reads the camera/axis input, the first one
+// with an expression.
+bool
+C44Matrix::fanOutFromCamera() const {
+	if (_channelMode)
+		return false;
+	for (int k = 0; k < kFanOutEntries; ++k)
+		if (!_fanOut[k].layer.empty() && _fanOut[k].from == 1)
+			return true;
+	return false;
 }
 
+// Evaluates the expression at 'context', with the inputs it names at that
+// context. The result is cached under the expression and the hashes of
+// those inputs, so a frame already seen costs a hash probe. Only _validate
+// passes 'resolve', which validates the inputs on a miss; provideValues
+// gets the identity for a frame not yet evaluated, as for metadata. A
+// compile or evaluation error goes to 'error' if set, and leaves the
+// identity.
+Matrix4
+C44Matrix::expressionMatrix(const DD::Image::OutputContext& context, bool resolve, std::string* error) const {
+	c44::trace::Span span("expressionMatrix");
+	Matrix4 mtx;
+	mtx.makeIdentity();
+
+	const std::shared_ptr<const c44::MatrixExpr> expr = compiledExpr(knob("expression")->get_text());
+	if (!expr->error().empty()) {
+		if (error != NULL)
+			*error = expr->error();
+		return mtx;
+	}
+
+	std::vector<Op*> ops(expr->inputs().size());
+	Hash h;
+	h.append("expression");
+	h.append(expr->text().c_str());
+	h.append(input_format().width());
+	h.append(input_format().height());
+	for (size_t i = 0; i < ops.size(); ++i) {
+		ops[i] = node_input(int(i) + 1, Op::EXECUTABLE_INPUT, &context);
+		if (dynamic_cast<AxisOp*>(ops[i]) == NULL)
+			return mtx;
+		h.append(ops[i]->hash());
+	}
+	const C44Matrix* first = static_cast<C44Matrix*>(firstOp());
+	float a[16];
+	if (findMatrix(h.value(), a, c44::MatrixLookup::Expression))
+		return Matrix4(a);
+	if (!resolve)
+		return mtx;
+
+	std::vector<c44::Mat4d> values;
+	for (size_t i = 0; i < expr->refs().size(); ++i) {
+		const c44::MatrixExpr::Ref& ref = expr->refs()[i];
+		values.push_back(c44::Mat4d::fromFloat(c44::Mat4f::fromArray(
+			resolveMatrix(ops[ref.input], ref.member).array())));
+	}
+	c44::Mat4d result;
+	if (!expr->evaluate(values.data(), result, error))
+		return mtx;
+	for (int i = 0; i < 16; ++i)
+		a[i] = float(result.m[i]);
+	first->_matrixCache.insert(h.value(), a);
+	return Matrix4(a);
+}
+
+// Key of matrix type 'option' of 'op' in _matrixCache. The op's hash covers
+// its knobs at its own frame and every op above it; the format matrix also
+// depends on the input format.
+uint64_t
+C44Matrix::matrixKey(Op* op, int option) const {
+	Hash h = op->hash();
+	h.append(option);
+	if (option == 5) {
+		h.append(input_format().width());
+		h.append(input_format().height());
+	}
+	return h.value();
+}
 
 void C44Matrix::_validate(bool for_real)
 {
+	c44::trace::Span span("_validate");
 	copy_info();
-	array_mtx = Matrix4(_arrayKnob.array);
+	_fanOutMissing.clear();
+
+	// The expression is evaluated here once for this Op's context, for its
+	// error and as the matrix to apply; provideValues only shows it.
+	Matrix4 expr_mtx;
+	_expressionError.clear();
+	if (_matrixFrom == 3) {
+		expr_mtx = expressionMatrix(outputContext(), true, &_expressionError);
+		if (!_expressionError.empty()) {
+			error("expression: %s", _expressionError.c_str());
+			return;
+		}
+	}
+	_statsOp = static_cast<C44Matrix*>(firstOp());
+	_statsOp->_stats.add(c44::Stat::Validates);
+	if (_channelMode) {
+		_validateChannels();
+		return;
+	}
 
-	if (_transpose)
-		array_mtx.transpose();
-	if (_invert)
-		array_mtx = array_mtx.inverse();
+	// The matrix before transpose and invert: the knob's, the expression's
+	// or the input's metadata at this frame, read here for this Op's
+	// context.
+	float source[16];
+	memcpy(source, _matrixFrom == 3 ? expr_mtx.array() : _arrayKnob.array, sizeof source);
+	_metadataMissing = false;
+	if (_matrixFrom == 2) {
+		Matrix4 mtx;
+		_metadataMissing = !readMetadataMatrix(_metadataKey, _metadataLayout, mtx);
+		if (_metadataMissing)
+			warning("no %s matrix in metadata key '%s'", metadataLayoutOptions[_metadataLayout], _metadataKey);
+		memcpy(source, mtx.array(), sizeof source);
+	}
+
+	const unsigned flags = (_transpose ? 1u : 0u) | (_invert ? 2u : 0u) |
+	                       (_w_divide ? 4u : 0u) | (_reproducible ? 8u : 0u);
+	if (_planValid && flags == _planFlags &&
+	    memcmp(_planKey, source, sizeof _planKey) == 0) {
+		_statsOp->_stats.add(c44::Stat::PlanHits);
+		C44_PROBE1(plan_hit, _statsOp);
+	}
+	else {
+		array_mtx = Matrix4(source);
+
+		if (_transpose)
+			array_mtx.transpose();
+		if (_invert) {
+			array_mtx = array_mtx.inverse();
+			_statsOp->_stats.add(c44::Stat::Inversions);
+		}
+		// Kernels specialised for this matrix class and w_divide, picked once here
+		engine_plan = c44::planPlanar(c44::Mat4f::fromArray(array_mtx.array()), _w_divide, _reproducible);
+
+		// Channels the matrix maps onto themselves are left out of the output
+		// set, so PixelIop passes them through without touching the pixels.
+		// What is left of a channel shuffle is then only plane copies.
+		compute_mask = 15u;
+		if (!_w_divide)
+			compute_mask &= ~c44::passthroughMask(engine_plan.rows);
+
+		published_mtx = c44::Mat4d::fromFloat(c44::Mat4f::fromArray(array_mtx.array()));
+		published_invertible = c44::invert(published_mtx, published_inv);
+
+		memcpy(_planKey, source, sizeof _planKey);
+		_planFlags = flags;
+		_planValid = true;
+		C44_PROBE2(plan_miss, _statsOp, int(engine_plan.cls));
+	}
+	C44_PROBE4(validate, _statsOp, int(engine_plan.cls), int(_w_divide), int(engine_plan.sparse));
 
 	ChannelSet outchans = channels;
 	outchans += Mask_RGBA;
-	set_out_channels(outchans);
+	if (!_validateFanOut(outchans))
+		return;
 	info_.turn_on(outchans);
+
+	static const Channel rgba[4] = { Chan_Red, Chan_Green, Chan_Blue, Chan_Alpha };
+	for (int c = 0; c < 4; ++c)
+		if (!(compute_mask & (1u << c)))
+			outchans -= rgba[c];
+	set_out_channels(outchans);
 	info_.black_outside(true);
 
 }
 
+// Fan-out: the main matrix and the entries that are on, in one plan, their
+// layers added to 'outchans'. Layers may not share channels with RGBA or
+// each other, or two matrices would write the same channel. The entries'
+// matrices can change every frame, so unlike engine_plan the plan is built
+// at each validate; resolving them goes through the matrix cache.
+bool C44Matrix::_validateFanOut(ChannelSet& outchans)
+{
+	fanout_plan = c44::FanOutPlan();
+	c44::Mat4f mtx[c44::kMaxFanOut];
+	mtx[0] = engine_plan.mtx;
+	unsigned wDivide = _w_divide ? 1u : 0u;
+	int count = 1;
+
+	ChannelSet used = Mask_RGBA;
+	for (int k = 0; k < kFanOutEntries; ++k) {
+		const FanOutEntry& e = _fanOut[k];
+		if (e.layer.empty())
+			continue;
+
+		ChannelSet layer;
+		int c = 0;
+		foreach (z, e.layer)
+			if (c < 4) {
+				fanout_out[count][c++] = z;
+				layer += z;
+			}
+		for (; c < 4; ++c)
+			fanout_out[count][c] = Chan_Black;
+		if (!(layer & used).empty()) {
+			error("fan-out %d: layer overlaps rgba or another fan-out layer", k + 1);
+			return false;
+		}
+		used += layer;
+
+		Matrix4 m = fanOutMatrix(e);
+		if (e.invert)
+			m = m.inverse();
+		mtx[count] = c44::Mat4f::fromArray(m.array());
+		if (e.wDivide)
+			wDivide |= 1u << count;
+		++count;
+	}
+	if (!_fanOutMissing.empty())
+		warning("fan-out: no %s matrix in metadata key %s", metadataLayoutOptions[_metadataLayout], _fanOutMissing.c_str());
+	if (count == 1)
+		return true;
+
+	fanout_plan = c44::planFanOut(mtx, count, wDivide, _reproducible);
+	outchans += used;
+	return true;
+}
+
+// Channel matrix mode: the channel lists, the matrix taken from the top
+// left of the channel matrix knob, and the kernel compiled for its size.
+void C44Matrix::_validateChannels()
+{
+	if (_inChannels.size() > unsigned(c44::kMaxChannels) || _outChannels.size() > unsigned(c44::kMaxChannels)) {
+		error("channel matrix: at most %d in and %d out channels", c44::kMaxChannels, c44::kMaxChannels);
+		return;
+	}
+	int inputs = 0, outputs = 0;
+	foreach (z, _inChannels)
+		channel_in[inputs++] = z;
+	foreach (z, _outChannels)
+		channel_out[outputs++] = z;
+
+	// With transpose, column r of the knob gives output r.
+	c44::ChannelMatrix key;
+	key.inputs = _transpose ? outputs : inputs;
+	key.outputs = _transpose ? inputs : outputs;
+	for (int r = 0; r < key.outputs; ++r)
+		for (int c = 0; c < key.inputs; ++c)
+			key(r, c) = _channelArray.array[r * c44::kMaxChannels + c];
+
+	const unsigned flags = 16u | (_transpose ? 1u : 0u) | (_invert ? 2u : 0u) | (_reproducible ? 8u : 0u);
+	if (_planValid && flags == _planFlags && memcmp(&_channelPlanKey, &key, sizeof key) == 0) {
+		_statsOp->_stats.add(c44::Stat::PlanHits);
+		C44_PROBE1(plan_hit, _statsOp);
+	}
+	else {
+		_planValid = false;
+		c44::ChannelMatrix mtx = _transpose ? c44::transpose(key) : key;
+		if (_invert) {
+			if (!c44::invert(mtx, mtx)) {
+				error("channel matrix: %s", inputs == outputs ? "cannot invert a singular matrix"
+				                                              : "only a square matrix can be inverted");
+				return;
+			}
+			_statsOp->_stats.add(c44::Stat::Inversions);
+		}
+		channel_plan = c44::planChannels(mtx, _reproducible);
+
+		_channelPlanKey = key;
+		_planFlags = flags;
+		_planValid = true;
+		C44_PROBE2(plan_miss, _statsOp, int(c44::MatrixClass::General));
+	}
+
+	// Without both lists there is nothing to compute, and every channel
+	// passes through.
+	if (channel_plan.kernel == NULL) {
+		set_out_channels(Mask_None);
+		return;
+	}
+	info_.turn_on(_outChannels);
+	set_out_channels(_outChannels);
+	info_.black_outside(true);
+}
+
 
 void C44Matrix::_request(int x, int y, int r, int t, ChannelMask
 		channels, int count)
@@ -209,48 +781,106 @@ void C44Matrix::_request(int x, int y, int r, int t, ChannelMask
 
 	ChannelSet requestChans;
 	requestChans += channels;
-	//if (channels.contains(Mask_RGBA)) {
-	requestChans += Mask_RGBA;
-	//}
+	in_channels(0, requestChans);
 	input0().request(x, y, r, t, requestChans, count);
 }
 
 
-void C44Matrix::pixel_engine(const Row &in, int y, int x, int r, ChannelMask channels, Row &out)
+// Bit 0 = red ... bit 3 = alpha, as c44::PlanarPlan expects.
+static unsigned rgbaMask(ChannelMask channels)
 {
+	return (channels.contains(Chan_Red)   ? 1u : 0u) |
+	       (channels.contains(Chan_Green) ? 2u : 0u) |
+	       (channels.contains(Chan_Blue)  ? 4u : 0u) |
+	       (channels.contains(Chan_Alpha) ? 8u : 0u);
+}
 
-	if (aborted())
-		return;
 
+// Input metadata plus, with publish on, the matrix and its inverse as 16
+// doubles, column by column as EXR stores matrices, so that a downstream
+// C44Matrix reading metadata with its default layout gets them back. A
+// singular matrix has no inverse key.
+const MetaData::Bundle& C44Matrix::_fetchMetaData(const char* keyname)
+{
+	_metadata = input0().fetchMetaData(keyname);
+	if (!_publish || _channelMode)
+		return _metadata;
+
+	validate(true);
+	if (_publishKey && *_publishKey)
+		_metadata.setData(_publishKey, std::vector<double>(published_mtx.m, published_mtx.m + 16));
+	if (_publishInverseKey && *_publishInverseKey && published_invertible)
+		_metadata.setData(_publishInverseKey, std::vector<double>(published_inv.m, published_inv.m + 16));
+	return _metadata;
+}
 
-	const float* R = in[Chan_Red];
-	const float* G = in[Chan_Green];
-	const float* B = in[Chan_Blue];
-	const float* A = in[Chan_Alpha];
+void C44Matrix::pixel_engine(const Row &in, int y, int x, int r, ChannelMask channels, Row &out)
+{
 
+	if (aborted())
+		return;
 
-	float* outX = out.writable(Chan_Red) ;
-	float* outY = out.writable(Chan_Green) ;
-	float* outZ = out.writable(Chan_Blue);
-	float* outW = out.writable(Chan_Alpha);
+	const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	const size_t width = size_t(r - x);
 
-	float* END = outX + (r - x);
+	if (_channelMode) {
+		const float* src[c44::kMaxChannels];
+		float* dst[c44::kMaxChannels];
+		for (int c = 0; c < channel_plan.mtx.inputs; ++c)
+			src[c] = in[channel_in[c]] + x;
+		for (int c = 0; c < channel_plan.mtx.outputs; ++c)
+			dst[c] = channels.contains(channel_out[c]) ? out.writable(channel_out[c]) + x : NULL;
 
-	for (int X = x; X < r; X++) {
-		Vector4 pw;
+		C44_PROBE4(row_entry, _statsOp, y, width, channel_plan.kernel);
+		channel_plan.run(src, dst, width);
+		C44_PROBE4(row_exit, _statsOp, y, width, channel_plan.kernel);
+	}
+	else {
+		rgbaEngine(in, y, x, width, channels, out);
+	}
 
-		Vector4 sc(R[X] , G[X], B[X], A[X]);
-		pw =  array_mtx.transform(sc);
-		if (_w_divide)
-			pw /= pw.w;
+	const std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+	c44::NodeStats& counters = _statsOp->_stats;
+	counters.add(c44::Stat::Rows);
+	counters.add(c44::Stat::Pixels, uint64_t(width));
+	counters.add(c44::Stat::EngineNs, uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count()));
+	c44::trace::row(_statsOp, t0, t1);
 
-		outX[X] = pw.x;
-		outY[X] = pw.y;
-		outZ[X] = pw.z;
-		outW[X] = pw.w;
+}
 
+// The 4x4 matrix on RGBA.
+void C44Matrix::rgbaEngine(const Row &in, int y, int x, size_t width, ChannelMask channels, Row &out)
+{
+	const float* const src[4] = { in[Chan_Red] + x, in[Chan_Green] + x,
+	                              in[Chan_Blue] + x, in[Chan_Alpha] + x };
+
+	// Only requested RGBA channels that aren't passed through are written;
+	// for a channel shuffle these are plane copies in the sparse kernel.
+	const unsigned mask = rgbaMask(channels) & compute_mask;
+	float* const dst[4] = { (mask & 1) ? out.writable(Chan_Red) + x : nullptr,
+	                        (mask & 2) ? out.writable(Chan_Green) + x : nullptr,
+	                        (mask & 4) ? out.writable(Chan_Blue) + x : nullptr,
+	                        (mask & 8) ? out.writable(Chan_Alpha) + x : nullptr };
+
+	if (fanout_plan.count) {
+		// The fan-out layers after RGBA, four planes per matrix.
+		float* planes[4 * c44::kMaxFanOut] = { dst[0], dst[1], dst[2], dst[3] };
+		for (int k = 1; k < fanout_plan.count; ++k)
+			for (int c = 0; c < 4; ++c) {
+				const Channel z = fanout_out[k][c];
+				planes[4 * k + c] = z && channels.contains(z) ? out.writable(z) + x : nullptr;
+			}
+		const c44::FanOutKernel kernel = fanout_plan.rowKernel(width);
+		C44_PROBE4(row_entry, _statsOp, y, width, kernel);
+		kernel(fanout_plan.mtx[0].m, src, planes, width);
+		C44_PROBE4(row_exit, _statsOp, y, width, kernel);
+		return;
 	}
 
+	const void* kernel = engine_plan.entry(mask, width);
+	C44_PROBE4(row_entry, _statsOp, y, width, kernel);
+	engine_plan.run(mask, src, dst, width);
+	C44_PROBE4(row_exit, _statsOp, y, width, kernel);
 }
 
 
@@ -260,7 +890,12 @@ void C44Matrix::pixel_engine(const Row &in, int y, int x, int r, ChannelMask cha
 void C44Matrix::knobs(Knob_Callback f)
 {
 	Enumeration_knob(f, &_matrixFrom, matrixFromOptions, "matrixFrom", "matrix input");
-	Tooltip(f, "Choose to enter a 4x4 matrix manually, or take it from a camera or axis input");
+	Tooltip(f, "Where the 4x4 matrix comes from\n"
+			"manual input: typed into the matrix knob\n"
+			"from camera/axis input: the matrix type of the camera or axis on input 1\n"
+			"from input metadata: the metadata key of the image input, stored as layout says\n"
+			"from expression: the expression below; each name in it becomes a numbered "
+			"camera/axis input, 1 to 4, labelled with the name");
 
 	Enumeration_knob(f, &_matrixOption, cameraMatrixOptions, "matrixType", "matrix type");
 	Tooltip(f, "Choose the kind of matrix to get from the input camera/axis\n"
@@ -272,32 +907,167 @@ void C44Matrix::knobs(Knob_Callback f)
 			"format: camera format matrix (camera only)\n"
 			"");
 
+	Multiline_String_knob(f, &_expression, "expression", "expression", 3);
+	Tooltip(f, "Matrix composed from camera/axis inputs, for example\n"
+			"    inverse(cam.transform) * axis.transform * scale(2)\n"
+			"Each name becomes an input of the node, in order of appearance (up to 4); "
+			".transform (the default), .translation, .rotation, .scale, .projection or .format "
+			"picks the matrix as in matrix type. Functions: inverse(m), transpose(m), identity(), "
+			"translate(x, y, z), scale(s) or scale(x, y, z), rotateX/Y/Z(degrees) and "
+			"rotate(x, y, z). In A * B, B applies first. Evaluated in double precision once per "
+			"frame and view.");
+
+	String_knob(f, &_metadataKey, "metadataKey", "metadata key");
+	Tooltip(f, "Metadata key of the input holding the matrix, such as exr/worldToCamera "
+			"or exr/worldToNDC as Arnold, RenderMan and V-Ray write them. It is read when "
+			"the node validates, for that frame; the matrix knob shows the identity at "
+			"frames the node has not been validated at yet");
+	Enumeration_knob(f, &_metadataLayout, metadataLayoutOptions, "metadataLayout", "layout");
+	Tooltip(f, "How the matrix is stored in the metadata\n"
+			"4x4: 16 numbers; 3x4: 12 numbers, the last row being 0 0 0 1\n"
+			"row-major: row by row, as the matrix applies to (r, g, b, a)\n"
+			"column-major: column by column, as EXR files store matrices");
+
 	Array_knob(f, &_arrayKnob, 4, 4, "matrix");
 	SetValueProvider(f, this);
 
 	Divider(f);
 
+	Bool_knob(f, &_channelMode, "channelMode", "channel matrix");
+	SetFlags(f, Knob::STARTLINE);
+	Tooltip(f, "Apply the channel matrix below from the in channels to the out channels, "
+			"up to 8 of each, instead of the 4x4 matrix to RGBA: for spectral data, AOV "
+			"recombination or camera RGB plus extra channels to XYZ. Row r gives the r-th "
+			"out channel, column c weights the c-th in channel, both in channel order. "
+			"transpose swaps rows and columns; invert needs as many in as out channels. "
+			"w_divide and publish matrix do not apply.");
+	Input_ChannelSet_knob(f, &_inChannels, 0, "inChannels", "in");
+	ChannelSet_knob(f, &_outChannels, "outChannels", "out");
+	Array_knob(f, &_channelArray, c44::kMaxChannels, c44::kMaxChannels, "channelMatrix", "");
+
+	Divider(f);
+
 	Bool_knob(f, &_invert, "invert");
 	SetFlags(f, Knob::STARTLINE);
 	Bool_knob(f, &_transpose, "transpose");
 	Bool_knob(f, &_w_divide, "w_divide");
 	Tooltip(f, "Divide the resulting vector by its w component.\n"
 			"The result will be red/alpha, green/alpha, blue/alpha, 1.0");
+	Bool_knob(f, &_reproducible, "reproducible");
+	Tooltip(f, "Give bit-identical results on every CPU.\n"
+			"The faster vector units fuse multiplies and adds, which can change "
+			"the last bit of a result between workstations and farm machines. "
+			"The C44_REPRODUCIBLE environment variable turns this on for every node.");
+
+	for (int k = 0; k < kFanOutEntries; ++k) {
+		FanOutEntry& e = _fanOut[k];
+		const FanOutKnobNames& n = fanOutKnobs[k];
+		Divider(f);
+		ChannelSet_knob(f, &e.layer, n.layer, "fan-out layer");
+		Tooltip(f, "Also apply this entry's matrix to the input RGBA and write x y z w to the "
+				"first four channels of this layer, in the same pass as the matrix above, so "
+				"that one P pass gives camera, NDC and other spaces without a node for each. "
+				"The layer may not share channels with rgba or another fan-out layer. "
+				"none turns the entry off. Does not apply in channel matrix mode.");
+		Enumeration_knob(f, &e.from, fanOutFromOptions, n.from, "matrix input");
+		Tooltip(f, "Enter this entry's matrix manually, or take it from the camera/axis input "
+				"(the first one with an expression) or from the input's metadata with the "
+				"layout above");
+		Enumeration_knob(f, &e.option, cameraMatrixOptions, n.type, "matrix type");
+		String_knob(f, &e.key, n.key, "metadata key");
+		Array_knob(f, &e.matrix, 4, 4, n.matrix, "");
+		Bool_knob(f, &e.invert, n.invert, "invert");
+		SetFlags(f, Knob::STARTLINE);
+		Tooltip(f, "Invert this entry's matrix, to get world to camera from a camera transform");
+		Bool_knob(f, &e.wDivide, n.wDivide, "w_divide");
+		Tooltip(f, "Divide this entry's result by its w component, as for NDC or pixel space");
+	}
 
+	Divider(f);
+
+	Bool_knob(f, &_publish, "publish", "publish matrix");
+	SetFlags(f, Knob::STARTLINE);
+	Tooltip(f, "Write the matrix as applied (after transpose and invert) and its inverse "
+			"to the output metadata, as 16 numbers column by column, for nodes downstream. "
+			"Another C44Matrix reads them back with matrix input set to metadata.");
+	String_knob(f, &_publishKey, "publishKey", "matrix key");
+	Tooltip(f, "Metadata key for the matrix; empty to leave it out");
+	String_knob(f, &_publishInverseKey, "publishInverseKey", "inverse key");
+	Tooltip(f, "Metadata key for the inverse of the matrix, computed in double precision; "
+			"empty to leave it out. Not written when the matrix is singular.");
+
+	Tab_knob(f, "Diagnostics");
+	Multiline_String_knob(f, &_statsText, "stats", "counters", 8);
+	SetFlags(f, Knob::READ_ONLY | Knob::DO_NOT_WRITE | Knob::NO_ANIMATION);
+	Tooltip(f, "Work done by all instances of this node since it was created or reset, "
+			"across all render threads. Refreshed when the panel opens or on Update; "
+			"from Python: n['update_stats'].execute(); n['stats'].value()");
+	Button(f, "update_stats", "Update");
+	Button(f, "reset_stats", "Reset");
+	Button(f, "dump_trace", "Write trace");
+	Tooltip(f, "Write the spans recorded so far to the Chrome trace file named by "
+			"the C44_TRACE environment variable. Without it, nothing is recorded.");
+}
+
+// Shows the knobs of the matrix sources in use.
+void C44Matrix::showSourceKnobs()
+{
+	knob("matrixType")->visible(_matrixFrom==1);
+	knob("metadataKey")->visible(_matrixFrom==2);
+	knob("expression")->visible(_matrixFrom==3);
+	knob("inChannels")->visible(_channelMode);
+	knob("outChannels")->visible(_channelMode);
+	knob("channelMatrix")->visible(_channelMode);
+
+	bool metadata = _matrixFrom==2;
+	for (int k = 0; k < kFanOutEntries; ++k) {
+		const FanOutEntry& e = _fanOut[k];
+		knob(fanOutKnobs[k].type)->visible(e.from==1);
+		knob(fanOutKnobs[k].key)->visible(e.from==2);
+		knob(fanOutKnobs[k].matrix)->visible(e.from==0);
+		metadata = metadata || (!e.layer.empty() && e.from==2);
+	}
+	knob("metadataLayout")->visible(metadata);
 }
 
 int C44Matrix::knob_changed(DD::Image::Knob* k)
 {
 	if(k == &DD::Image::Knob::showPanel) {
-		knob("matrixType")->visible(_matrixFrom==1);
+		showSourceKnobs();
+		updateStatsKnob();
+		return 1;
+	}
+
+	if(k->is("update_stats")) {
+		updateStatsKnob();
+		return 1;
+	}
+
+	if(k->is("reset_stats")) {
+		_stats.reset();
+		updateStatsKnob();
+		return 1;
+	}
+
+	if(k->is("dump_trace")) {
+		c44::trace::dump();
 		return 1;
 	}
 
-	if(k->is("matrixFrom")) {
-		knob("matrixType")->visible(_matrixFrom==1);
+	if(k->is("matrixFrom") || k->is("channelMode")) {
+		showSourceKnobs();
 		return 1;
 	}
 
+	for (int i = 0; i < kFanOutEntries; ++i)
+		if(k->is(fanOutKnobs[i].from) || k->is(fanOutKnobs[i].layer)) {
+			showSourceKnobs();
+			return 1;
+		}
+
+	if(k->is("expression"))
+		return 1;
+
 	return PixelIop::knob_changed(k);
 }
 
@@ -0,0 +1,110 @@
+// C44ChannelKernels.h
+//
+// Planar float kernels for channel matrices (see C44Transform.h), one per
+// input and output count from 1 to kMaxChannels, so every size has its
+// loops unrolled and its coefficients broadcast once per row. Each ISA
+// translation unit instantiates the table with its own vector type.
+// Internal to src/core.
+
+#pragma once
+
+#include "C44Simd.h"
+#include "C44Transform.h"
+
+#include <cstddef>
+#include <utility>
+
+namespace c44 {
+namespace detail {
+
+// Indexed [inputs - 1][outputs - 1].
+struct ChannelTable
+{
+	ChannelKernel k[kMaxChannels][kMaxChannels];
+};
+
+// One per ISA translation unit; null where the ISA wasn't compiled in.
+// As with the planar tables, the reproducible ones are bit-identical to
+// the baseline one.
+const ChannelTable* baselineChannelTable();
+const ChannelTable* avx2ChannelTable(bool reproducible);
+const ChannelTable* avx512ChannelTable(bool reproducible);
+
+
+inline namespace C44_ISA_NAMESPACE {
+
+// The N x M coefficients the kernel reads, broadcast, output by output.
+template <class V, int N, int M>
+struct ChannelLanes
+{
+	V m[M][N];
+
+	explicit ChannelLanes(const float* src)
+	{
+		for (int r = 0; r < M; ++r)
+			for (int c = 0; c < N; ++c)
+				m[r][c] = V::set1(src[r * kMaxChannels + c]);
+	}
+};
+
+
+// V::width pixels starting at i. Every input is loaded before any output
+// is stored, so an output plane may be an input plane.
+template <class V, int N, int M>
+inline void channelSpan(const ChannelLanes<V, N, M>& l, const float* const* in,
+                        float* const* out, size_t i)
+{
+	V x[N];
+	for (int c = 0; c < N; ++c)
+		x[c] = V::load(in[c] + i);
+
+	V y[M];
+	for (int r = 0; r < M; ++r) {
+		// ((m0 x0 + m1 x1) + m2 x2) + ...: input order, as the planar kernels.
+		V acc = l.m[r][0] * x[0];
+		for (int c = 1; c < N; ++c)
+			acc = madd(acc, l.m[r][c], x[c]);
+		y[r] = acc;
+	}
+
+	for (int r = 0; r < M; ++r)
+		if (out[r])
+			y[r].store(out[r] + i);
+}
+
+
+// V for the body, S (a one-lane type with the same fusing) for the tail.
+template <class V, class S, int N, int M>
+void channelSpecialised(const float* m, const float* const* in, float* const* out, size_t n)
+{
+	const ChannelLanes<V, N, M> lanes(m);
+	size_t i = 0;
+	for (; i + V::width <= n; i += V::width)
+		channelSpan<V, N, M>(lanes, in, out, i);
+
+	if (i < n) {
+		const ChannelLanes<S, N, M> one(m);
+		for (; i < n; ++i)
+			channelSpan<S, N, M>(one, in, out, i);
+	}
+}
+
+
+template <class V, class S, size_t... I>
+void fillChannels(ChannelTable& t, std::index_sequence<I...>)
+{
+	((t.k[I / kMaxChannels][I % kMaxChannels] =
+		channelSpecialised<V, S, int(I / kMaxChannels) + 1, int(I % kMaxChannels) + 1>), ...);
+}
+
+template <class V, class S>
+ChannelTable makeChannelTable()
+{
+	ChannelTable t;
+	fillChannels<V, S>(t, std::make_index_sequence<kMaxChannels * kMaxChannels>());
+	return t;
+}
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace detail
+} // namespace c44
@@ -0,0 +1,61 @@
+// C44Cpu.cpp
+
+#include "C44Cpu.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace c44 {
+
+static CpuFeatures detect()
+{
+	CpuFeatures f;
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+	__builtin_cpu_init();
+	f.f16c    = __builtin_cpu_supports("f16c");
+	f.avx2    = __builtin_cpu_supports("avx2");
+	f.fma     = __builtin_cpu_supports("fma");
+	f.avx512f = __builtin_cpu_supports("avx512f");
+
+	unsigned brand[12] = {};
+	if (__get_cpuid_max(0x80000000u, nullptr) >= 0x80000004u)
+		for (unsigned i = 0; i < 3; ++i)
+			__get_cpuid(0x80000002u + i, &brand[i * 4], &brand[i * 4 + 1], &brand[i * 4 + 2], &brand[i * 4 + 3]);
+	std::memcpy(f.name, brand, 48);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	int r[4];
+	__cpuid(r, 1);
+	const bool osxsave = (r[2] & (1 << 27)) != 0;
+	const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+	const bool ymm = (xcr0 & 0x6) == 0x6;
+	const bool zmm = (xcr0 & 0xe6) == 0xe6;
+	f.f16c = ymm && (r[2] & (1 << 29)) != 0;
+	f.fma  = ymm && (r[2] & (1 << 12)) != 0;
+	__cpuidex(r, 7, 0);
+	f.avx2    = ymm && (r[1] & (1 << 5)) != 0;
+	f.avx512f = zmm && (r[1] & (1 << 16)) != 0;
+
+	__cpuid(r, 0x80000000);
+	if (unsigned(r[0]) >= 0x80000004u)
+		for (int i = 0; i < 3; ++i) {
+			__cpuid(r, 0x80000002 + i);
+			std::memcpy(f.name + i * 16, r, 16);
+		}
+#endif
+	return f;
+}
+
+
+const CpuFeatures& cpuFeatures()
+{
+	static const CpuFeatures features = detect();
+	return features;
+}
+
+} // namespace c44
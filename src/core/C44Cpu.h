@@ -0,0 +1,21 @@
+// C44Cpu.h
+//
+// Runtime CPU feature detection for picking kernel variants.
+
+#pragma once
+
+namespace c44 {
+
+struct CpuFeatures
+{
+	bool f16c    = false;
+	bool avx2    = false;
+	bool fma     = false;
+	bool avx512f = false;
+	char name[49] = {};   // CPU brand string, where the CPU reports one
+};
+
+// Detected once; includes the OS check for saved AVX state.
+const CpuFeatures& cpuFeatures();
+
+} // namespace c44
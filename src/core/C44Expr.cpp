@@ -0,0 +1,316 @@
+// C44Expr.cpp
+
+#include "C44Expr.h"
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+namespace c44 {
+
+namespace {
+
+const char* const kMemberNames[MatrixExpr::kMembers] = {
+	"transform", "translation", "rotation", "scale", "projection", "format"
+};
+
+Mat4d multiply(const Mat4d& a, const Mat4d& b)
+{
+	Mat4d r;
+	for (int row = 0; row < 4; ++row)
+		for (int col = 0; col < 4; ++col) {
+			double s = 0.0;
+			for (int k = 0; k < 4; ++k)
+				s += a(row, k) * b(k, col);
+			r(row, col) = s;
+		}
+	return r;
+}
+
+Mat4d rotation(int axis, double degrees)
+{
+	const double a = degrees * 3.14159265358979323846 / 180.0;
+	const double c = std::cos(a), s = std::sin(a);
+	const int i = (axis + 1) % 3, j = (axis + 2) % 3;
+	Mat4d r = Mat4d::identity();
+	r(i, i) = c;
+	r(i, j) = -s;
+	r(j, i) = s;
+	r(j, j) = c;
+	return r;
+}
+
+} // namespace
+
+
+// Recursive descent over the grammar in C44Expr.h, emitting the program as
+// it goes. Constant parts are folded as soon as they are complete.
+class ExprParser
+{
+	MatrixExpr& _e;
+	const char* _begin;
+	const char* _p;
+	int         _depth = 0;
+
+	bool fail(const std::string& what)
+	{
+		if (_e._error.empty())
+			_e._error = what + " at column " + std::to_string(int(_p - _begin) + 1);
+		return false;
+	}
+
+	void skip()
+	{
+		while (std::isspace((unsigned char)*_p))
+			++_p;
+	}
+
+	bool accept(char c)
+	{
+		skip();
+		if (*_p != c)
+			return false;
+		++_p;
+		return true;
+	}
+
+	bool expect(char c)
+	{
+		return accept(c) || fail(std::string("expected '") + c + "'");
+	}
+
+	std::string identifier()
+	{
+		skip();
+		const char* start = _p;
+		if (std::isalpha((unsigned char)*_p) || *_p == '_')
+			while (std::isalnum((unsigned char)*_p) || *_p == '_')
+				++_p;
+		return std::string(start, _p);
+	}
+
+	void emit(MatrixExpr::Code code, int arg = 0)
+	{
+		_e._code.push_back({ code, arg });
+		_depth += code == MatrixExpr::PushRef || code == MatrixExpr::PushConst ? 1 :
+		          code == MatrixExpr::Multiply ? -1 : 0;
+		if (_depth > _e._depth)
+			_e._depth = _depth;
+	}
+
+	void pushConst(const Mat4d& m)
+	{
+		_e._consts.push_back(m);
+		emit(MatrixExpr::PushConst, int(_e._consts.size()) - 1);
+	}
+
+	bool lastIsConst(size_t back = 1) const
+	{
+		return _e._code.size() >= back && _e._code[_e._code.size() - back].code == MatrixExpr::PushConst;
+	}
+
+	// Applies a unary code, in place when its operand is a constant.
+	bool unary(MatrixExpr::Code code)
+	{
+		if (!lastIsConst()) {
+			emit(code);
+			return true;
+		}
+		Mat4d& m = _e._consts[size_t(_e._code.back().arg)];
+		if (code == MatrixExpr::Transpose)
+			m = transpose(m);
+		else if (!invert(m, m))
+			return fail("inverse() of a singular matrix");
+		return true;
+	}
+
+	void multiply()
+	{
+		if (lastIsConst(1) && lastIsConst(2)) {
+			const Mat4d b = _e._consts[size_t(_e._code.back().arg)];
+			_e._code.pop_back();
+			_e._consts.pop_back();
+			--_depth;
+			Mat4d& a = _e._consts[size_t(_e._code.back().arg)];
+			a = c44::multiply(a, b);
+		}
+		else
+			emit(MatrixExpr::Multiply);
+	}
+
+	bool numbers(std::vector<double>& args)
+	{
+		if (accept(')'))
+			return true;
+		do {
+			skip();
+			char* end = nullptr;
+			const double v = std::strtod(_p, &end);
+			if (end == _p)
+				return fail("expected a number");
+			_p = end;
+			args.push_back(v);
+		} while (accept(','));
+		return expect(')');
+	}
+
+	bool input(const std::string& name)
+	{
+		int index = 0;
+		while (index < int(_e._inputs.size()) && _e._inputs[size_t(index)] != name)
+			++index;
+		if (index == int(_e._inputs.size())) {
+			if (index == MatrixExpr::kMaxInputs)
+				return fail("more than " + std::to_string(MatrixExpr::kMaxInputs) + " inputs");
+			_e._inputs.push_back(name);
+		}
+
+		int member = 0;
+		if (accept('.')) {
+			const std::string m = identifier();
+			while (member < MatrixExpr::kMembers && m != kMemberNames[member])
+				++member;
+			if (member == MatrixExpr::kMembers)
+				return fail("unknown matrix '" + m + "'");
+		}
+
+		int ref = 0;
+		while (ref < int(_e._refs.size()) &&
+		       (_e._refs[size_t(ref)].input != index || _e._refs[size_t(ref)].member != member))
+			++ref;
+		if (ref == int(_e._refs.size()))
+			_e._refs.push_back({ index, member });
+		emit(MatrixExpr::PushRef, ref);
+		return true;
+	}
+
+	bool function(const std::string& name)
+	{
+		if (name == "inverse" || name == "transpose")
+			return expr() && expect(')') &&
+			       unary(name == "inverse" ? MatrixExpr::Inverse : MatrixExpr::Transpose);
+
+		std::vector<double> a;
+		if (!numbers(a))
+			return false;
+		Mat4d m = Mat4d::identity();
+		if (name == "identity" && a.empty()) {}
+		else if (name == "translate" && a.size() == 3) {
+			m(0, 3) = a[0];
+			m(1, 3) = a[1];
+			m(2, 3) = a[2];
+		}
+		else if (name == "scale" && (a.size() == 1 || a.size() == 3)) {
+			m(0, 0) = a[0];
+			m(1, 1) = a[a.size() == 3 ? 1 : 0];
+			m(2, 2) = a[a.size() == 3 ? 2 : 0];
+		}
+		else if (name == "rotateX" && a.size() == 1) m = rotation(0, a[0]);
+		else if (name == "rotateY" && a.size() == 1) m = rotation(1, a[0]);
+		else if (name == "rotateZ" && a.size() == 1) m = rotation(2, a[0]);
+		else if (name == "rotate" && a.size() == 3)
+			m = c44::multiply(rotation(2, a[2]), c44::multiply(rotation(1, a[1]), rotation(0, a[0])));
+		else
+			return fail("no function " + name + "() taking " + std::to_string(a.size()) + " numbers");
+		pushConst(m);
+		return true;
+	}
+
+	bool primary()
+	{
+		if (accept('('))
+			return expr() && expect(')');
+		const std::string name = identifier();
+		if (name.empty())
+			return fail("expected a name or '('");
+		return accept('(') ? function(name) : input(name);
+	}
+
+public:
+	ExprParser(MatrixExpr& e) : _e(e), _begin(e._text.c_str()), _p(_begin) {}
+
+	bool expr()
+	{
+		if (!primary())
+			return false;
+		while (accept('*')) {
+			if (!primary())
+				return false;
+			multiply();
+		}
+		return true;
+	}
+
+	bool parse()
+	{
+		skip();
+		if (!*_p) {
+			pushConst(Mat4d::identity());
+			return true;
+		}
+		if (!expr())
+			return false;
+		skip();
+		return !*_p || fail(std::string("unexpected '") + *_p + "'");
+	}
+};
+
+
+bool MatrixExpr::compile(const std::string& text)
+{
+	_text = text;
+	_error.clear();
+	_inputs.clear();
+	_refs.clear();
+	_code.clear();
+	_consts.clear();
+	_depth = 0;
+	if (ExprParser(*this).parse())
+		return true;
+	_refs.clear();
+	_code.clear();
+	_consts.clear();
+	return false;
+}
+
+
+bool MatrixExpr::evaluate(const Mat4d* values, Mat4d& out, std::string* why) const
+{
+	if (_code.empty()) {
+		out = Mat4d::identity();
+		return _error.empty();
+	}
+
+	std::vector<Mat4d> stack;
+	stack.reserve(size_t(_depth));
+	for (const Instr& in : _code)
+		switch (in.code) {
+		case PushRef:
+			stack.push_back(values[in.arg]);
+			break;
+		case PushConst:
+			stack.push_back(_consts[size_t(in.arg)]);
+			break;
+		case Inverse:
+			if (!invert(stack.back(), stack.back())) {
+				if (why)
+					*why = "inverse() of a singular matrix";
+				return false;
+			}
+			break;
+		case Transpose:
+			stack.back() = transpose(stack.back());
+			break;
+		case Multiply: {
+			const Mat4d b = stack.back();
+			stack.pop_back();
+			stack.back() = multiply(stack.back(), b);
+			break;
+		}
+		}
+	out = stack.back();
+	return true;
+}
+
+} // namespace c44
@@ -0,0 +1,85 @@
+// C44Expr.h
+//
+// A small language for composing 4x4 matrices, so that a chain such as
+//
+//     inverse(cam.transform) * axis.translation * scale(2)
+//
+// is one text knob instead of several nodes or sixteen knob expressions.
+// Matrices apply to column vectors, so in A * B, B applies first.
+//
+//     expr    := primary ('*' primary)*
+//     primary := name ['.' member]
+//              | function '(' [number (',' number)*] ')'
+//              | function '(' expr ')'              (inverse, transpose)
+//              | '(' expr ')'
+//
+// A name is a camera or axis input of the node; inputs are numbered in the
+// order their names first appear, up to kMaxInputs. The members are the
+// node's matrix types: transform (the default), translation, rotation,
+// scale, projection and format. The functions are
+//
+//     inverse(m)  transpose(m)  identity()
+//     translate(x, y, z)  scale(s)  scale(x, y, z)
+//     rotateX(deg)  rotateY(deg)  rotateZ(deg)
+//     rotate(x, y, z)       about x first, then y, then z
+//
+// compile() turns the text into a short stack program once, folding the
+// parts that do not depend on an input into constants; evaluate() runs it
+// in double precision on the input matrices of one frame.
+
+#pragma once
+
+#include "C44Transform.h"
+
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+class MatrixExpr
+{
+public:
+	static const int kMaxInputs = 4;
+	static const int kMembers = 6;
+
+	// A matrix the program reads: member 'member' of input 'input' (0 is
+	// the first name).
+	struct Ref
+	{
+		int input, member;
+	};
+
+	// False on a syntax error, with error() giving the reason and position;
+	// inputs() then still lists the names read before it, so a node keeps
+	// its inputs while the text is being edited. An empty text compiles to
+	// the identity.
+	bool compile(const std::string& text);
+
+	const std::string&              text()   const { return _text; }
+	const std::string&              error()  const { return _error; }
+	const std::vector<std::string>& inputs() const { return _inputs; }
+	const std::vector<Ref>&         refs()   const { return _refs; }
+
+	// 'values' holds the matrix of each of refs(). False if inverse() meets
+	// a singular matrix, with 'why' saying so.
+	bool evaluate(const Mat4d* values, Mat4d& out, std::string* why = nullptr) const;
+
+private:
+	enum Code { PushRef, PushConst, Inverse, Transpose, Multiply };
+	struct Instr
+	{
+		Code code;
+		int  arg;
+	};
+
+	friend class ExprParser;
+
+	std::string              _text, _error;
+	std::vector<std::string> _inputs;
+	std::vector<Ref>         _refs;
+	std::vector<Instr>       _code;
+	std::vector<Mat4d>       _consts;
+	int                      _depth = 0;   // largest stack the program needs
+};
+
+} // namespace c44
@@ -0,0 +1,218 @@
+// C44FanOutKernels.h
+//
+// Planar float kernels applying up to kMaxFanOut 4x4 matrices to the same
+// RGBA rows (see FanOutPlan in C44Transform.h), one per matrix count and
+// set of w-divided matrices, so the row is read from memory once for all
+// of them. Each ISA translation unit instantiates the table with its own
+// vector type. Internal to src/core.
+
+#pragma once
+
+#include "C44PlanarKernels.h"
+#include "C44Simd.h"
+#include "C44Transform.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace c44 {
+namespace detail {
+
+// Indexed [count - 1][w_divide bits]; null where a bit is set past count.
+struct FanOutTable
+{
+	FanOutKernel k[kMaxFanOut][1 << kMaxFanOut];
+	FanOutKernel stream[kMaxFanOut][1 << kMaxFanOut];
+};
+
+// One per ISA translation unit; null where the ISA wasn't compiled in.
+// As with the planar tables, the reproducible ones are bit-identical to
+// the baseline one.
+const FanOutTable* baselineFanOutTable();
+const FanOutTable* avx2FanOutTable(bool reproducible);
+const FanOutTable* avx512FanOutTable(bool reproducible);
+
+
+inline namespace C44_ISA_NAMESPACE {
+
+// V::width pixels starting at i through one matrix, whose outputs go to the
+// non-null planes of out[0..3]. This is the general case of transformSpan
+// in C44PlanarKernels.h, operation for operation, so it gives the bits of
+// the dense planar kernel.
+template <class V, bool WDiv, bool Stream>
+inline void fanOutSpan(const Lanes<V>& l, const float* const in[4],
+                       float* const* out, size_t i)
+{
+	const V r = V::load(in[0] + i);
+	const V g = V::load(in[1] + i);
+	const V b = V::load(in[2] + i);
+	const V a = V::load(in[3] + i);
+
+	V x = madd(madd(madd(l.m[0] * r, l.m[4], g), l.m[8],  b), l.m[12], a);
+	V y = madd(madd(madd(l.m[1] * r, l.m[5], g), l.m[9],  b), l.m[13], a);
+	V z = madd(madd(madd(l.m[2] * r, l.m[6], g), l.m[10], b), l.m[14], a);
+	V w = madd(madd(madd(l.m[3] * r, l.m[7], g), l.m[11], b), l.m[15], a);
+
+	if (WDiv) {
+		const V iw = V::set1(1.0f) / w;
+		x = x * iw;
+		y = y * iw;
+		z = z * iw;
+		w = w * iw;
+	}
+
+	if (out[0]) put<Stream>(x, out[0] + i);
+	if (out[1]) put<Stream>(y, out[1] + i);
+	if (out[2]) put<Stream>(z, out[2] + i);
+	if (out[3]) put<Stream>(w, out[3] + i);
+}
+
+
+// Matrix k of the plan and the ones after it over n pixels, V for the body
+// and S (a one-lane type with the same fusing) for the tail. Streaming, the
+// first matrix prefetches the inputs ahead, once per input per cache line.
+template <class V, class S, int K, unsigned WDiv, bool Stream, int k = 0>
+inline void fanOutMatrices(const float* m, const float* const in[4], float* const* out, size_t n)
+{
+	constexpr bool wDiv = (WDiv >> k) & 1u;
+	const Lanes<V> lanes(m + 16 * k);
+	size_t i = 0;
+	for (; i + V::width <= n; i += V::width) {
+		if (Stream && k == 0 && i % 16 == 0)
+			for (int j = 0; j < 4; ++j)
+				simd::prefetch(in[j] + i + kPrefetchAhead);
+		fanOutSpan<V, wDiv, Stream>(lanes, in, out + 4 * k, i);
+	}
+
+	if (i < n) {
+		const Lanes<S> one(m + 16 * k);
+		for (; i < n; ++i)
+			fanOutSpan<S, wDiv, false>(one, in, out + 4 * k, i);
+	}
+
+	if constexpr (k + 1 < K)
+		fanOutMatrices<V, S, K, WDiv, Stream, k + 1>(m, in, out, n);
+}
+
+
+// The row goes through in chunks small enough for the inputs to stay in
+// L1, and each chunk through the matrices one after the other, so the
+// inputs come from memory once. One matrix at a time is what keeps its 16
+// coefficients and the four inputs in registers: two matrices take 36
+// vectors, more than even AVX-512 has, and computing several from one
+// register load of the inputs spills the coefficients, which costs more
+// than reloading the inputs from L1.
+const size_t kFanOutChunk = 512;
+
+template <class V, class S, int K, unsigned WDiv, bool Stream>
+void fanOutSpecialised(const float* m, const float* const in[4], float* const* out, size_t n)
+{
+	if (n == 0)
+		return;
+
+	// Streaming stores need every written plane aligned to the vector size
+	// from the same pixel on, as in planarStreaming; the first chunk runs
+	// up to that pixel with regular stores. Rows whose planes are aligned
+	// differently don't stream at all.
+	size_t head = 0;
+	if (Stream) {
+		const uintptr_t align = V::width * sizeof(float);
+		uintptr_t offset = 0;
+		bool first = true, aligned = true;
+		for (int c = 0; c < 4 * K; ++c) {
+			if (!out[c])
+				continue;
+			const uintptr_t o = uintptr_t(out[c]) % align;
+			aligned = aligned && (first || o == offset) && o % sizeof(float) == 0;
+			offset = o;
+			first = false;
+		}
+		if (!aligned) {
+			fanOutSpecialised<V, S, K, WDiv, false>(m, in, out, n);
+			return;
+		}
+		head = std::min(n, size_t(offset ? (align - offset) / sizeof(float) : 0));
+	}
+
+	// An output that is exactly an input plane would change it under the
+	// later matrices, so each chunk of that input is saved first; with one
+	// matrix, each pixel is read before it is written. Partly overlapping
+	// planes would clobber the next chunk, so those inputs are copied
+	// whole, as in sparsePlanar.
+	bool save[4] = {};
+	std::vector<float> whole[4];
+	const float* source[4] = { in[0], in[1], in[2], in[3] };
+	for (int j = 0; j < 4; ++j) {
+		for (int c = 0; c < 4 * K; ++c) {
+			if (!out[c] || !overlaps(out[c], in[j], n))
+				continue;
+			if (out[c] != in[j]) {
+				whole[j].assign(in[j], in[j] + n);
+				source[j] = whole[j].data();
+				save[j] = false;
+				break;
+			}
+			save[j] = K > 1;
+		}
+	}
+
+	float saved[4][kFanOutChunk];
+	float* chunkOut[4 * K];
+	for (size_t base = 0, len = 0; base < n; base += len) {
+		len = std::min(base < head ? head : kFanOutChunk, n - base);
+
+		const float* plane[4];
+		for (int j = 0; j < 4; ++j) {
+			plane[j] = source[j] + base;
+			if (save[j]) {
+				std::memcpy(saved[j], plane[j], len * sizeof(float));
+				plane[j] = saved[j];
+			}
+		}
+		for (int c = 0; c < 4 * K; ++c)
+			chunkOut[c] = out[c] ? out[c] + base : nullptr;
+
+		if (base < head)
+			fanOutMatrices<V, S, K, WDiv, false>(m, plane, chunkOut, len);
+		else
+			fanOutMatrices<V, S, K, WDiv, Stream>(m, plane, chunkOut, len);
+	}
+	if (Stream)
+		simd::streamFence();
+}
+
+
+template <class V, class S, bool Stream, size_t I>
+constexpr FanOutKernel fanOutEntry()
+{
+	constexpr int K = int(I >> kMaxFanOut) + 1;
+	constexpr unsigned WDiv = unsigned(I) & ((1u << kMaxFanOut) - 1);
+	if constexpr (WDiv >> K)
+		return nullptr;
+	else
+		return fanOutSpecialised<V, S, K, WDiv, Stream>;
+}
+
+template <class V, class S, bool Stream, size_t... I>
+void fillFanOut(FanOutKernel (*dst)[1 << kMaxFanOut], std::index_sequence<I...>)
+{
+	((dst[I >> kMaxFanOut][I & ((1u << kMaxFanOut) - 1)] = fanOutEntry<V, S, Stream, I>()), ...);
+}
+
+template <class V, class S>
+FanOutTable makeFanOutTable()
+{
+	FanOutTable t;
+	const std::make_index_sequence<(kMaxFanOut << kMaxFanOut)> entries;
+	fillFanOut<V, S, false>(t.k, entries);
+	fillFanOut<V, S, true>(t.stream, entries);
+	return t;
+}
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace detail
+} // namespace c44
@@ -0,0 +1,73 @@
+// C44Half.h
+//
+// IEEE 754 binary16 <-> float conversion. Round-to-nearest-even, overflow to
+// infinity, NaNs quieted with their payload kept: bit-for-bit what F16C's
+// vcvtps2ph/vcvtph2ps produce, so the scalar and vector paths agree.
+
+#pragma once
+
+#include "C44Isa.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace c44 {
+inline namespace C44_ISA_NAMESPACE {
+
+inline float halfToFloat(uint16_t h)
+{
+	const uint32_t sign = uint32_t(h & 0x8000) << 16;
+	const uint32_t exp  = (h >> 10) & 0x1f;
+	const uint32_t mant = h & 0x3ff;
+
+	uint32_t bits;
+	if (exp == 0) {
+		// Zero or subnormal: mant * 2^-24 is exact in float.
+		float f = float(mant) * 5.9604644775390625e-8f;
+		std::memcpy(&bits, &f, 4);
+		bits |= sign;
+	}
+	else if (exp == 31)
+		bits = sign | 0x7f800000u | (mant << 13) | (mant ? 0x400000u : 0u);
+	else
+		bits = sign | ((exp + 112) << 23) | (mant << 13);
+
+	float f;
+	std::memcpy(&f, &bits, 4);
+	return f;
+}
+
+
+inline uint16_t floatToHalf(float f)
+{
+	uint32_t x;
+	std::memcpy(&x, &f, 4);
+	const uint32_t sign = (x >> 16) & 0x8000;
+	x &= 0x7fffffffu;
+
+	uint32_t h;
+	if (x >= 0x47800000u) {
+		// >= 65536, Inf or NaN. Values just below round up in the normal path.
+		h = (x > 0x7f800000u) ? (0x7e00u | ((x >> 13) & 0x3ffu)) : 0x7c00u;
+	}
+	else if (x < 0x38800000u) {
+		// Below the smallest normal half: let a float add do the rounding.
+		const uint32_t magicBits = 0x3f000000u;   // 0.5f, ulp 2^-24
+		float magic, v;
+		std::memcpy(&magic, &magicBits, 4);
+		std::memcpy(&v, &x, 4);
+		v += magic;
+		uint32_t r;
+		std::memcpy(&r, &v, 4);
+		h = r - magicBits;
+	}
+	else {
+		const uint32_t odd = (x >> 13) & 1;
+		x += 0xc8000fffu + odd;   // rebias exponent (-112 << 23) and round
+		h = x >> 13;
+	}
+	return uint16_t(h | sign);
+}
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace c44
@@ -0,0 +1,20 @@
+// C44Isa.h
+//
+// Parts of the core are compiled more than once with different ISA flags
+// (see the CMake files). Inline helpers and kernel templates are declared
+// inside an inline namespace named after the flags of the translation unit,
+// so each build keeps its own copy; otherwise the linker is free to keep,
+// say, the AVX-512 instantiation of a shared helper for the baseline path
+// too. Internal to src/core.
+
+#pragma once
+
+#if defined(__AVX512F__)
+#define C44_ISA_NAMESPACE isa_avx512
+#elif defined(__AVX2__)
+#define C44_ISA_NAMESPACE isa_avx2
+#elif defined(__AVX__) || defined(__F16C__)
+#define C44_ISA_NAMESPACE isa_avx
+#else
+#define C44_ISA_NAMESPACE isa_base
+#endif
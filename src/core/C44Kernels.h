@@ -0,0 +1,171 @@
+// C44Kernels.h
+//
+// Sample conversion templates shared by the translation units that make up
+// the core. Each TU instantiates them with the half conversion it can use
+// (scalar, or F16C when compiled with -mf16c) and exports the result as a
+// KernelSet. The matrix math itself is in the ISA-dispatched planar tables
+// (C44PlanarKernels.h). Internal to src/core.
+
+#pragma once
+
+#include "C44Half.h"
+#include "C44Simd.h"
+#include "C44Transform.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace c44 {
+namespace detail {
+
+// Conversions between the layouts transformStrided() takes and the planar
+// float blocks the matrix kernels run on, indexed by SampleType. Planar
+// float needs none, so widen and narrow only exist for half.
+struct KernelSet
+{
+	typedef void (*Unpack)(const void* in, float* const out[4], size_t n);
+	typedef void (*Pack)(const float* const in[4], void* out, size_t n);
+	typedef void (*Widen)(const void* in, float* out, size_t n);
+	typedef void (*Narrow)(const float* in, void* out, size_t n);
+
+	Unpack unpack[2];   // packed RGBA to four planes
+	Pack   pack[2];     // and back
+	Widen  widen;       // one half plane to float
+	Narrow narrow;
+};
+
+// Defined in C44Transform.cpp / C44TransformF16C.cpp. The F16C set is only
+// valid when cpuFeatures().f16c; it returns false where it was not built.
+const KernelSet& baselineKernels();
+bool f16cKernels(KernelSet& out);
+
+
+inline namespace C44_ISA_NAMESPACE {
+
+// ---------------------------------------------------------------------------
+// Sample conversion
+//
+// A conversion policy provides load4/store4 for half samples; floats are
+// handled here directly.
+// ---------------------------------------------------------------------------
+
+struct ScalarHalf
+{
+	static simd::F4 load4(const uint16_t* p)
+	{
+		const float f[4] = { halfToFloat(p[0]), halfToFloat(p[1]),
+		                     halfToFloat(p[2]), halfToFloat(p[3]) };
+		return simd::F4::load(f);
+	}
+
+	static void store4(uint16_t* p, simd::F4 v)
+	{
+		float f[4];
+		v.store(f);
+		for (int i = 0; i < 4; ++i)
+			p[i] = floatToHalf(f[i]);
+	}
+};
+
+template <class Cvt> inline simd::F4 load4(const float* p)    { return simd::F4::load(p); }
+template <class Cvt> inline simd::F4 load4(const uint16_t* p) { return Cvt::load4(p); }
+template <class Cvt> inline void store4(float* p, simd::F4 v)    { v.store(p); }
+template <class Cvt> inline void store4(uint16_t* p, simd::F4 v) { Cvt::store4(p, v); }
+
+inline float    toFloat(float v)     { return v; }
+inline float    toFloat(uint16_t v)  { return halfToFloat(v); }
+inline void     fromFloat(float& d, float v)    { d = v; }
+inline void     fromFloat(uint16_t& d, float v) { d = floatToHalf(v); }
+
+
+// ---------------------------------------------------------------------------
+// Conversions
+// ---------------------------------------------------------------------------
+
+// Packed RGBA: four pixels are transposed into planar registers.
+template <typename T, class Cvt>
+void unpackKernel(const void* inPtr, float* const out[4], size_t n)
+{
+	const T* in = static_cast<const T*>(inPtr);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		simd::F4 r = load4<Cvt>(in + i * 4);
+		simd::F4 g = load4<Cvt>(in + i * 4 + 4);
+		simd::F4 b = load4<Cvt>(in + i * 4 + 8);
+		simd::F4 a = load4<Cvt>(in + i * 4 + 12);
+		simd::transpose4(r, g, b, a);
+		r.store(out[0] + i);
+		g.store(out[1] + i);
+		b.store(out[2] + i);
+		a.store(out[3] + i);
+	}
+
+	for (; i < n; ++i)
+		for (int c = 0; c < 4; ++c)
+			out[c][i] = toFloat(in[i * 4 + c]);
+}
+
+
+template <typename T, class Cvt>
+void packKernel(const float* const in[4], void* outPtr, size_t n)
+{
+	T* out = static_cast<T*>(outPtr);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4) {
+		simd::F4 x = simd::F4::load(in[0] + i);
+		simd::F4 y = simd::F4::load(in[1] + i);
+		simd::F4 z = simd::F4::load(in[2] + i);
+		simd::F4 w = simd::F4::load(in[3] + i);
+		simd::transpose4(x, y, z, w);
+		store4<Cvt>(out + i * 4, x);
+		store4<Cvt>(out + i * 4 + 4, y);
+		store4<Cvt>(out + i * 4 + 8, z);
+		store4<Cvt>(out + i * 4 + 12, w);
+	}
+
+	for (; i < n; ++i)
+		for (int c = 0; c < 4; ++c)
+			fromFloat(out[i * 4 + c], in[c][i]);
+}
+
+
+template <class Cvt>
+void widenKernel(const void* inPtr, float* out, size_t n)
+{
+	const uint16_t* in = static_cast<const uint16_t*>(inPtr);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		load4<Cvt>(in + i).store(out + i);
+	for (; i < n; ++i)
+		out[i] = halfToFloat(in[i]);
+}
+
+
+template <class Cvt>
+void narrowKernel(const float* in, void* outPtr, size_t n)
+{
+	uint16_t* out = static_cast<uint16_t*>(outPtr);
+	size_t i = 0;
+	for (; i + 4 <= n; i += 4)
+		store4<Cvt>(out + i, simd::F4::load(in + i));
+	for (; i < n; ++i)
+		out[i] = floatToHalf(in[i]);
+}
+
+
+template <class Cvt>
+KernelSet makeKernelSet()
+{
+	KernelSet k;
+	k.unpack[0] = unpackKernel<float, Cvt>;
+	k.unpack[1] = unpackKernel<uint16_t, Cvt>;
+	k.pack[0] = packKernel<float, Cvt>;
+	k.pack[1] = packKernel<uint16_t, Cvt>;
+	k.widen = widenKernel<Cvt>;
+	k.narrow = narrowKernel<Cvt>;
+	return k;
+}
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace detail
+} // namespace c44
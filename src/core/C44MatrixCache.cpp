@@ -0,0 +1,51 @@
+// C44MatrixCache.cpp
+
+#include "C44MatrixCache.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace c44 {
+
+bool MatrixCache::find(uint64_t key, float m[16])
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	for (Entry& e : _entries)
+		if (e.key == key) {
+			e.used = ++_clock;
+			std::memcpy(m, e.m, sizeof e.m);
+			return true;
+		}
+	return false;
+}
+
+void MatrixCache::insert(uint64_t key, const float m[16])
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	Entry* slot = nullptr;
+	for (Entry& e : _entries)
+		if (e.key == key) {
+			slot = &e;
+			break;
+		}
+	if (!slot) {
+		if (_entries.size() < _capacity) {
+			_entries.push_back(Entry());
+			slot = &_entries.back();
+		}
+		else
+			slot = &*std::min_element(_entries.begin(), _entries.end(),
+			                          [](const Entry& a, const Entry& b) { return a.used < b.used; });
+	}
+	slot->key = key;
+	slot->used = ++_clock;
+	std::memcpy(slot->m, m, sizeof slot->m);
+}
+
+void MatrixCache::clear()
+{
+	std::lock_guard<std::mutex> lock(_mutex);
+	_entries.clear();
+}
+
+} // namespace c44
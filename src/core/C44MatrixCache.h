@@ -0,0 +1,48 @@
+// C44MatrixCache.h
+//
+// Matrices the node has already worked out, so that they are not worked
+// out again: metadata parsed for a frame, an expression evaluated over its
+// inputs, a camera shared by several fan-out entries. Each is resolved in
+// the node's _validate, on a thread Nuke drives, and shared by every Op of
+// the node.
+//
+// The cache knows nothing about Nuke: entries are keyed by a 64-bit hash
+// that the node builds from whatever the matrix depends on (the input op's
+// hash at that frame, the matrix type, the format), so a stale entry is
+// simply never asked for again and ages out.
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace c44 {
+
+// A small least-recently-used map from key to 4x4 matrix, safe to use from
+// several threads.
+class MatrixCache
+{
+public:
+	explicit MatrixCache(size_t capacity = 256) : _capacity(capacity) {}
+
+	// Copies the matrix stored under 'key' into m; false if there is none.
+	bool find(uint64_t key, float m[16]);
+	void insert(uint64_t key, const float m[16]);
+	void clear();
+
+private:
+	struct Entry
+	{
+		uint64_t key;
+		uint64_t used;
+		float    m[16];
+	};
+
+	mutable std::mutex _mutex;
+	std::vector<Entry> _entries;
+	size_t             _capacity;
+	uint64_t           _clock = 0;
+};
+
+} // namespace c44
@@ -0,0 +1,384 @@
+// C44PlanarKernels.h
+//
+// Planar float kernels specialised at compile time for the matrix class,
+// w_divide and the set of output channels, so the inner loop has no flags
+// left to test and zero/one coefficients of the identity and affine classes
+// fold away. Each ISA translation unit instantiates the full table with its
+// own vector type. Internal to src/core.
+//
+// The sparse kernels reduce the matrix to its non-zero terms per output and
+// produce each output row with its own loop: a copy, a scale or a short sum.
+// They work in chunks small enough for every plane of a chunk to stay in L1
+// across the output passes.
+//
+// The streaming variants of the dense kernels are for rows too wide to stay
+// in cache: outputs go out with non-temporal stores, so they don't evict
+// the inputs and upstream rows, and inputs are prefetched ahead.
+
+#pragma once
+
+#include "C44Simd.h"
+#include "C44Transform.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace c44 {
+namespace detail {
+
+// Dense kernels indexed [unroll][class][wDivide][channel mask], with the
+// unroll factors below, and streaming ones by [class][wDivide][mask];
+// sparse ones, for any class without w_divide, by channel mask.
+const int kUnrollFactors[3] = { 1, 2, 4 };
+
+struct PlanarTable
+{
+	PlanarKernel k[3][3][2][16];
+	PlanarKernel stream[3][2][16];
+	SparseKernel sparse[16];
+};
+
+// One per ISA translation unit; null where the ISA wasn't compiled in.
+// The reproducible tables use unfused multiply-adds, which makes them
+// bit-identical to the baseline one.
+const PlanarTable* baselinePlanarTable();
+const PlanarTable* avx2PlanarTable(bool reproducible);
+const PlanarTable* avx512PlanarTable(bool reproducible);
+
+
+inline namespace C44_ISA_NAMESPACE {
+
+template <class V>
+struct Lanes
+{
+	V m[16];
+
+	explicit Lanes(const float* src)
+	{
+		for (int i = 0; i < 16; ++i)
+			m[i] = V::set1(src[i]);
+	}
+};
+
+
+template <bool Stream, class V>
+inline void put(const V& v, float* p)
+{
+	if (Stream)
+		v.stream(p);
+	else
+		v.store(p);
+}
+
+
+// V::width pixels starting at i. Inputs the specialisation doesn't need are
+// loaded but dead, and dropped by the compiler.
+template <class V, MatrixClass C, bool WDiv, unsigned Mask, bool Stream = false>
+inline void transformSpan(const Lanes<V>& l, const float* const in[4],
+                          float* const out[4], size_t i)
+{
+	const V r = V::load(in[0] + i);
+	const V g = V::load(in[1] + i);
+	const V b = V::load(in[2] + i);
+	const V a = V::load(in[3] + i);
+
+	V x, y, z, w;
+	if (C == MatrixClass::Identity) {
+		x = r; y = g; z = b; w = a;
+	}
+	else {
+		// ((m0 r + m4 g) + m8 b) + m12 a: the scalar reference's order.
+		x = madd(madd(madd(l.m[0] * r, l.m[4], g), l.m[8],  b), l.m[12], a);
+		y = madd(madd(madd(l.m[1] * r, l.m[5], g), l.m[9],  b), l.m[13], a);
+		z = madd(madd(madd(l.m[2] * r, l.m[6], g), l.m[10], b), l.m[14], a);
+		w = (C == MatrixClass::Affine)
+		    ? a : madd(madd(madd(l.m[3] * r, l.m[7], g), l.m[11], b), l.m[15], a);
+	}
+
+	if (WDiv) {
+		const V iw = V::set1(1.0f) / w;
+		x = x * iw;
+		y = y * iw;
+		z = z * iw;
+		w = w * iw;
+	}
+
+	if (Mask & 1) put<Stream>(x, out[0] + i);
+	if (Mask & 2) put<Stream>(y, out[1] + i);
+	if (Mask & 4) put<Stream>(z, out[2] + i);
+	if (Mask & 8) put<Stream>(w, out[3] + i);
+}
+
+
+// V for the body, S (a one-lane type with the same fusing) for the tail.
+// Unroll spans are issued per iteration of the main loop.
+template <class V, class S, int Unroll, MatrixClass C, bool WDiv, unsigned Mask>
+void planarSpecialised(const float* m, const float* const in[4],
+                       float* const out[4], size_t n)
+{
+	if (Mask == 0)
+		return;
+
+	const Lanes<V> lanes(m);
+	size_t i = 0;
+	for (; i + Unroll * V::width <= n; i += Unroll * V::width)
+		for (int u = 0; u < Unroll; ++u)
+			transformSpan<V, C, WDiv, Mask>(lanes, in, out, i + u * V::width);
+	for (; i + V::width <= n; i += V::width)
+		transformSpan<V, C, WDiv, Mask>(lanes, in, out, i);
+
+	if (i < n) {
+		const Lanes<S> one(m);
+		for (; i < n; ++i)
+			transformSpan<S, C, WDiv, Mask>(one, in, out, i);
+	}
+}
+
+
+// Floats ahead of the current pixel to prefetch each input at: 1 KiB, far
+// enough to cover memory latency at these kernels' throughput.
+const size_t kPrefetchAhead = 256;
+
+// Streaming stores need every output address aligned to the vector size.
+// The row is done with S up to the first aligned pixel, which aligns all
+// written planes only if they share the same misalignment; rows where they
+// don't use the regular kernel.
+template <class V, class S, MatrixClass C, bool WDiv, unsigned Mask>
+void planarStreaming(const float* m, const float* const in[4],
+                     float* const out[4], size_t n)
+{
+	if (Mask == 0 || n == 0)
+		return;
+
+	const uintptr_t align = V::width * sizeof(float);
+	uintptr_t offset = 0;
+	bool first = true, aligned = true;
+	for (int c = 0; c < 4; ++c) {
+		if (!(Mask & (1u << c)))
+			continue;
+		const uintptr_t o = uintptr_t(out[c]) % align;
+		aligned = aligned && (first || o == offset) && o % sizeof(float) == 0;
+		offset = o;
+		first = false;
+	}
+	if (!aligned) {
+		planarSpecialised<V, S, 1, C, WDiv, Mask>(m, in, out, n);
+		return;
+	}
+
+	const Lanes<S> one(m);
+	const size_t head = std::min(n, size_t(offset ? (align - offset) / sizeof(float) : 0));
+	size_t i = 0;
+	for (; i < head; ++i)
+		transformSpan<S, C, WDiv, Mask>(one, in, out, i);
+
+	// One prefetch per input per cache line.
+	const Lanes<V> lanes(m);
+	const size_t line = V::width < 16 ? 16 : V::width;
+	for (; i + line <= n; i += line) {
+		const size_t ahead = std::min(i + kPrefetchAhead, n - 1);
+		for (int j = 0; j < 4; ++j)
+			simd::prefetch(in[j] + ahead);
+		for (size_t u = 0; u < line; u += V::width)
+			transformSpan<V, C, WDiv, Mask, true>(lanes, in, out, i + u);
+	}
+	for (; i + V::width <= n; i += V::width)
+		transformSpan<V, C, WDiv, Mask, true>(lanes, in, out, i);
+	simd::streamFence();
+
+	for (; i < n; ++i)
+		transformSpan<S, C, WDiv, Mask>(one, in, out, i);
+}
+
+
+// ---------------------------------------------------------------------------
+// Sparse kernels
+// ---------------------------------------------------------------------------
+
+const size_t kSparseChunk = 1024;
+
+inline bool overlaps(const float* a, const float* b, size_t n)
+{
+	const uintptr_t pa = uintptr_t(a), pb = uintptr_t(b), bytes = n * sizeof(float);
+	return pa < pb + bytes && pb < pa + bytes;
+}
+
+
+// dst = sum of coeff[t] * src[t], in term order, as the dense kernels would
+// compute it with the zero terms removed.
+template <class V, int Terms>
+inline void sumTermsSpan(const float* const src[4], const float coeff[4], float* dst, size_t i)
+{
+	V acc = V::set1(coeff[0]) * V::load(src[0] + i);
+	for (int t = 1; t < Terms; ++t)
+		acc = madd(acc, V::set1(coeff[t]), V::load(src[t] + i));
+	acc.store(dst + i);
+}
+
+template <class V, class S, int Terms>
+void sumTerms(const float* const src[4], const float coeff[4], float* dst, size_t n)
+{
+	size_t i = 0;
+	for (; i + V::width <= n; i += V::width)
+		sumTermsSpan<V, Terms>(src, coeff, dst, i);
+	for (; i < n; ++i)
+		sumTermsSpan<S, Terms>(src, coeff, dst, i);
+}
+
+template <class V, class S>
+void outputPlane(int count, const float* const src[4], const float coeff[4],
+                 float* dst, size_t n)
+{
+	switch (count) {
+	case 0:
+		std::fill(dst, dst + n, 0.0f);
+		break;
+	case 1:
+		if (coeff[0] == 1.0f) {
+			if (dst != src[0])
+				std::memmove(dst, src[0], n * sizeof(float));
+		}
+		else
+			sumTerms<V, S, 1>(src, coeff, dst, n);
+		break;
+	case 2: sumTerms<V, S, 2>(src, coeff, dst, n); break;
+	case 3: sumTerms<V, S, 3>(src, coeff, dst, n); break;
+	case 4: sumTerms<V, S, 4>(src, coeff, dst, n); break;
+	}
+}
+
+
+// A copy of input j for the row, in a buffer kept per thread so that rows
+// after the first don't allocate.
+inline const float* wholeInput(int j, const float* src, size_t n)
+{
+	thread_local std::vector<float> whole[4];
+	whole[j].assign(src, src + n);
+	return whole[j].data();
+}
+
+template <class V, class S, unsigned Mask>
+void sparsePlanar(const SparseRows& s, const float* const in[4], float* const out[4], size_t n)
+{
+	if (Mask == 0 || n == 0)
+		return;
+
+	// Outputs are written one plane at a time, so an input has to be saved
+	// first if an output overwrites it while a later output still reads it.
+	// An output that is exactly its own input plane is safe by itself, as
+	// each pixel is read before it is written. Partly overlapping planes
+	// would clobber the next chunk, so those inputs are copied whole.
+	bool reads[4][4] = {}, used[4] = {};
+	for (int c = 0; c < 4; ++c) {
+		if (!(Mask & (1u << c)))
+			continue;
+		for (int t = 0; t < s.count[c]; ++t)
+			reads[c][s.index[c][t]] = used[s.index[c][t]] = true;
+	}
+
+	bool save[4] = {};
+	const float* source[4] = { in[0], in[1], in[2], in[3] };
+	for (int j = 0; j < 4; ++j) {
+		for (int c = 0; c < 4 && used[j]; ++c) {
+			if (!(Mask & (1u << c)) || !overlaps(out[c], in[j], n))
+				continue;
+			if (out[c] != in[j]) {
+				source[j] = wholeInput(j, in[j], n);
+				save[j] = false;
+				break;
+			}
+			for (int d = c + 1; d < 4; ++d)
+				save[j] = save[j] || reads[d][j];
+		}
+	}
+
+	float saved[4][kSparseChunk];
+	for (size_t base = 0; base < n; base += kSparseChunk) {
+		const size_t len = std::min(kSparseChunk, n - base);
+
+		const float* plane[4];
+		for (int j = 0; j < 4; ++j) {
+			plane[j] = source[j] ? source[j] + base : nullptr;
+			if (save[j]) {
+				std::memcpy(saved[j], plane[j], len * sizeof(float));
+				plane[j] = saved[j];
+			}
+		}
+
+		for (int c = 0; c < 4; ++c) {
+			if (!(Mask & (1u << c)))
+				continue;
+			const float* src[4];
+			for (int t = 0; t < s.count[c]; ++t)
+				src[t] = plane[s.index[c][t]];
+			outputPlane<V, S>(s.count[c], src, s.coeff[c], out[c] + base, len);
+		}
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+// Tables
+// ---------------------------------------------------------------------------
+
+template <class V, class S, int Unroll, MatrixClass C, bool WDiv, size_t... M>
+void fillMasks(PlanarKernel* dst, std::index_sequence<M...>)
+{
+	((dst[M] = planarSpecialised<V, S, Unroll, C, WDiv, unsigned(M)>), ...);
+}
+
+template <class V, class S, int Unroll>
+void fillClasses(PlanarKernel (*dst)[2][16])
+{
+	const std::make_index_sequence<16> masks;
+	fillMasks<V, S, Unroll, MatrixClass::Identity, false>(dst[0][0], masks);
+	fillMasks<V, S, Unroll, MatrixClass::Identity, true >(dst[0][1], masks);
+	fillMasks<V, S, Unroll, MatrixClass::Affine,   false>(dst[1][0], masks);
+	fillMasks<V, S, Unroll, MatrixClass::Affine,   true >(dst[1][1], masks);
+	fillMasks<V, S, Unroll, MatrixClass::General,  false>(dst[2][0], masks);
+	fillMasks<V, S, Unroll, MatrixClass::General,  true >(dst[2][1], masks);
+}
+
+template <class V, class S, MatrixClass C, bool WDiv, size_t... M>
+void fillStreamMasks(PlanarKernel* dst, std::index_sequence<M...>)
+{
+	((dst[M] = planarStreaming<V, S, C, WDiv, unsigned(M)>), ...);
+}
+
+template <class V, class S>
+void fillStream(PlanarKernel (*dst)[16])
+{
+	const std::make_index_sequence<16> masks;
+	fillStreamMasks<V, S, MatrixClass::Identity, false>(dst[0], masks);
+	fillStreamMasks<V, S, MatrixClass::Identity, true >(dst[1], masks);
+	fillStreamMasks<V, S, MatrixClass::Affine,   false>(dst[2], masks);
+	fillStreamMasks<V, S, MatrixClass::Affine,   true >(dst[3], masks);
+	fillStreamMasks<V, S, MatrixClass::General,  false>(dst[4], masks);
+	fillStreamMasks<V, S, MatrixClass::General,  true >(dst[5], masks);
+}
+
+template <class V, class S, size_t... M>
+void fillSparse(SparseKernel* dst, std::index_sequence<M...>)
+{
+	((dst[M] = sparsePlanar<V, S, unsigned(M)>), ...);
+}
+
+template <class V, class S>
+PlanarTable makePlanarTable()
+{
+	PlanarTable t;
+	fillClasses<V, S, 1>(t.k[0]);
+	fillClasses<V, S, 2>(t.k[1]);
+	fillClasses<V, S, 4>(t.k[2]);
+	fillStream<V, S>(&t.stream[0][0]);
+	fillSparse<V, S>(t.sparse, std::make_index_sequence<16>());
+	return t;
+}
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace detail
+} // namespace c44
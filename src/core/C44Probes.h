@@ -0,0 +1,56 @@
+// C44Probes.h
+//
+// USDT (SystemTap-style static) probes for perf, bpftrace and SystemTap.
+// When <sys/sdt.h> is available on Linux (systemtap-sdt-dev or
+// systemtap-sdt-devel), each probe compiles to a single nop plus a note in
+// the binary describing where its arguments live; nothing runs unless a
+// tracer attaches. Elsewhere, or with C44_NO_USDT defined, a probe only
+// evaluates its arguments, plain values that the optimiser then drops.
+//
+// Probes of provider "c44":
+//
+//   row_entry(node, y, width, kernel)    pixel_engine, before the kernel
+//   row_exit(node, y, width, kernel)     pixel_engine, after the kernel
+//   validate(node, class, w_divide, sparse)
+//                                        end of _validate; class is
+//                                        c44::MatrixClass (0 identity,
+//                                        1 affine, 2 general)
+//   plan_hit(node)                       _validate reused the kernel plan
+//   plan_miss(node, class)               _validate built a new plan
+//   matrix_hit(node, kind)               a matrix found in the node's
+//   matrix_miss(node, kind)              matrix cache, or not; kind is
+//                                        c44::MatrixLookup (0 metadata,
+//                                        1 expression, 2 fan-out entry)
+//
+// 'node' is the address of the node's first Op and 'kernel' the address of the kernel
+// function, which bpftrace's usym() turns into its name, ISA included:
+//
+//   bpftrace -e 'usdt:/path/C44Matrix.so:c44:row_entry { @[usym(arg3)] = count(); }'
+//   perf buildid-cache --add /path/C44Matrix.so && perf list sdt_c44:*
+
+#pragma once
+
+#if defined(__linux__) && defined(__has_include) && !defined(C44_NO_USDT)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define C44_USDT 1
+#endif
+#endif
+
+#ifdef C44_USDT
+#define C44_PROBE1(name, a)             STAP_PROBE1(c44, name, a)
+#define C44_PROBE2(name, a, b)          STAP_PROBE2(c44, name, a, b)
+#define C44_PROBE4(name, a, b, c, d)    STAP_PROBE4(c44, name, a, b, c, d)
+#else
+// Arguments only a probe uses must not warn as unused.
+#define C44_PROBE1(name, a)             ((void)(a))
+#define C44_PROBE2(name, a, b)          ((void)(a), (void)(b))
+#define C44_PROBE4(name, a, b, c, d)    ((void)(a), (void)(b), (void)(c), (void)(d))
+#endif
+
+namespace c44 {
+
+// What a matrix_hit / matrix_miss lookup was for.
+enum class MatrixLookup { Metadata, Expression, FanOut };
+
+} // namespace c44
@@ -0,0 +1,231 @@
+// C44Simd.h
+//
+// Thin float vectors used by the core kernels. F4 is SSE2 on x86-64 (always
+// available there), NEON on arm64 and a plain scalar fallback elsewhere; it
+// does lane-wise mul/add/div only, in the same order as the scalar code, so
+// it produces the same bits as the scalar reference on x86. F8 (AVX2) and
+// F16 (AVX-512) exist only in translation units built for those ISAs, and
+// their madd() is fused; Unfused<F8> and Unfused<F16> round the product
+// and the sum separately, like F4, for reproducible results. Internal to
+// src/core; the plugin and tools use C44Transform.h.
+//
+// Compilers must not contract a * b + c into FMA on their own for any of
+// this to hold: the build passes -ffp-contract=off to the kernel files.
+//
+// stream() is a non-temporal store that bypasses the caches where the ISA
+// has one, and needs an address aligned to the vector size; elsewhere it is
+// a plain store. Call streamFence() after the last one.
+
+#pragma once
+
+#include "C44Isa.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define C44_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define C44_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// MSVC has no __FMA__; /arch:AVX2 implies FMA3 there.
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define C44_SIMD_AVX2 1
+#endif
+#if defined(__AVX512F__)
+#define C44_SIMD_AVX512 1
+#endif
+#if defined(C44_SIMD_AVX2) || defined(C44_SIMD_AVX512)
+#include <immintrin.h>
+#endif
+
+#include <cmath>
+
+namespace c44 {
+namespace simd {
+inline namespace C44_ISA_NAMESPACE {
+
+#if defined(C44_SIMD_SSE2)
+
+struct F4
+{
+	static const int width = 4;
+	__m128 v;
+
+	static F4 set1(float x)          { return { _mm_set1_ps(x) }; }
+	static F4 load(const float* p)   { return { _mm_loadu_ps(p) }; }
+	void store(float* p) const       { _mm_storeu_ps(p, v); }
+	void stream(float* p) const      { _mm_stream_ps(p, v); }
+
+	friend F4 operator+(F4 a, F4 b) { return { _mm_add_ps(a.v, b.v) }; }
+	friend F4 operator*(F4 a, F4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+	friend F4 operator/(F4 a, F4 b) { return { _mm_div_ps(a.v, b.v) }; }
+};
+
+inline void transpose4(F4& a, F4& b, F4& c, F4& d)
+{
+	_MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v);
+}
+
+#elif defined(C44_SIMD_NEON)
+
+struct F4
+{
+	static const int width = 4;
+	float32x4_t v;
+
+	static F4 set1(float x)          { return { vdupq_n_f32(x) }; }
+	static F4 load(const float* p)   { return { vld1q_f32(p) }; }
+	void store(float* p) const       { vst1q_f32(p, v); }
+	void stream(float* p) const      { vst1q_f32(p, v); }
+
+	friend F4 operator+(F4 a, F4 b) { return { vaddq_f32(a.v, b.v) }; }
+	friend F4 operator*(F4 a, F4 b) { return { vmulq_f32(a.v, b.v) }; }
+	friend F4 operator/(F4 a, F4 b) { return { vdivq_f32(a.v, b.v) }; }
+};
+
+inline void transpose4(F4& a, F4& b, F4& c, F4& d)
+{
+	const float32x4x2_t ab = vtrnq_f32(a.v, b.v);
+	const float32x4x2_t cd = vtrnq_f32(c.v, d.v);
+	a.v = vcombine_f32(vget_low_f32(ab.val[0]),  vget_low_f32(cd.val[0]));
+	b.v = vcombine_f32(vget_low_f32(ab.val[1]),  vget_low_f32(cd.val[1]));
+	c.v = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d.v = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#else
+
+struct F4
+{
+	static const int width = 4;
+	float v[4];
+
+	static F4 set1(float x)          { return { { x, x, x, x } }; }
+	static F4 load(const float* p)   { return { { p[0], p[1], p[2], p[3] } }; }
+	void store(float* p) const       { p[0] = v[0]; p[1] = v[1]; p[2] = v[2]; p[3] = v[3]; }
+	void stream(float* p) const      { store(p); }
+
+	friend F4 operator+(F4 a, F4 b) { for (int i = 0; i < 4; ++i) a.v[i] += b.v[i]; return a; }
+	friend F4 operator*(F4 a, F4 b) { for (int i = 0; i < 4; ++i) a.v[i] *= b.v[i]; return a; }
+	friend F4 operator/(F4 a, F4 b) { for (int i = 0; i < 4; ++i) a.v[i] /= b.v[i]; return a; }
+};
+
+inline void transpose4(F4& a, F4& b, F4& c, F4& d)
+{
+	F4 t[4] = { a, b, c, d };
+	for (int i = 0; i < 4; ++i) {
+		a.v[i] = t[i].v[0];
+		b.v[i] = t[i].v[1];
+		c.v[i] = t[i].v[2];
+		d.v[i] = t[i].v[3];
+	}
+}
+
+#endif
+
+// acc + a * b, rounded twice like the scalar reference.
+inline F4 madd(F4 acc, F4 a, F4 b) { return acc + a * b; }
+
+// Hint that the cache line at p will be read soon. Never faults.
+inline void prefetch(const float* p)
+{
+#if defined(C44_SIMD_SSE2)
+	_mm_prefetch(reinterpret_cast<const char*>(p), _MM_HINT_T0);
+#elif defined(__GNUC__)
+	__builtin_prefetch(p);
+#else
+	(void)p;
+#endif
+}
+
+// Orders earlier stream() stores before any later store.
+inline void streamFence()
+{
+#if defined(C44_SIMD_SSE2)
+	_mm_sfence();
+#endif
+}
+
+
+// One lane, for loop tails. Fused selects std::fma so a tail matches the
+// vector body of an FMA kernel.
+template <bool Fused>
+struct F1
+{
+	static const int width = 1;
+	float v;
+
+	static F1 set1(float x)          { return { x }; }
+	static F1 load(const float* p)   { return { *p }; }
+	void store(float* p) const       { *p = v; }
+	void stream(float* p) const      { *p = v; }
+
+	friend F1 operator+(F1 a, F1 b) { return { a.v + b.v }; }
+	friend F1 operator*(F1 a, F1 b) { return { a.v * b.v }; }
+	friend F1 operator/(F1 a, F1 b) { return { a.v / b.v }; }
+	friend F1 madd(F1 acc, F1 a, F1 b) { return { Fused ? std::fma(a.v, b.v, acc.v) : acc.v + a.v * b.v }; }
+};
+
+
+#if defined(C44_SIMD_AVX2)
+
+struct F8
+{
+	static const int width = 8;
+	__m256 v;
+
+	static F8 set1(float x)          { return { _mm256_set1_ps(x) }; }
+	static F8 load(const float* p)   { return { _mm256_loadu_ps(p) }; }
+	void store(float* p) const       { _mm256_storeu_ps(p, v); }
+	void stream(float* p) const      { _mm256_stream_ps(p, v); }
+
+	friend F8 operator+(F8 a, F8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+	friend F8 operator*(F8 a, F8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	friend F8 operator/(F8 a, F8 b) { return { _mm256_div_ps(a.v, b.v) }; }
+	friend F8 madd(F8 acc, F8 a, F8 b) { return { _mm256_fmadd_ps(a.v, b.v, acc.v) }; }
+};
+
+#endif
+
+#if defined(C44_SIMD_AVX512)
+
+struct F16
+{
+	static const int width = 16;
+	__m512 v;
+
+	static F16 set1(float x)          { return { _mm512_set1_ps(x) }; }
+	static F16 load(const float* p)   { return { _mm512_loadu_ps(p) }; }
+	void store(float* p) const        { _mm512_storeu_ps(p, v); }
+	void stream(float* p) const       { _mm512_stream_ps(p, v); }
+
+	friend F16 operator+(F16 a, F16 b) { return { _mm512_add_ps(a.v, b.v) }; }
+	friend F16 operator*(F16 a, F16 b) { return { _mm512_mul_ps(a.v, b.v) }; }
+	friend F16 operator/(F16 a, F16 b) { return { _mm512_div_ps(a.v, b.v) }; }
+	friend F16 madd(F16 acc, F16 a, F16 b) { return { _mm512_fmadd_ps(a.v, b.v, acc.v) }; }
+};
+
+#endif
+
+// V with madd() as a rounded multiply followed by a rounded add.
+template <class V>
+struct Unfused
+{
+	static const int width = V::width;
+	V v;
+
+	static Unfused set1(float x)          { return { V::set1(x) }; }
+	static Unfused load(const float* p)   { return { V::load(p) }; }
+	void store(float* p) const            { v.store(p); }
+	void stream(float* p) const           { v.stream(p); }
+
+	friend Unfused operator+(Unfused a, Unfused b) { return { a.v + b.v }; }
+	friend Unfused operator*(Unfused a, Unfused b) { return { a.v * b.v }; }
+	friend Unfused operator/(Unfused a, Unfused b) { return { a.v / b.v }; }
+	friend Unfused madd(Unfused acc, Unfused a, Unfused b) { return { acc.v + a.v * b.v }; }
+};
+
+} // namespace C44_ISA_NAMESPACE
+} // namespace simd
+} // namespace c44
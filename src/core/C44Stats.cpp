@@ -0,0 +1,96 @@
+// C44Stats.cpp
+
+#include "C44Stats.h"
+
+#include <cstdio>
+
+namespace c44 {
+
+const char* statName(Stat s)
+{
+	switch (s) {
+	case Stat::Rows:       return "rows";
+	case Stat::Pixels:     return "pixels";
+	case Stat::EngineNs:   return "engine_ns";
+	case Stat::Validates:  return "validates";
+	case Stat::Inversions: return "inversions";
+	case Stat::Provides:   return "provide_values";
+	case Stat::PlanHits:   return "plan_cache_hits";
+	case Stat::Count:      break;
+	}
+	return "?";
+}
+
+
+void NodeStats::addResolve(MatrixSource source, int type, uint64_t validateNs, uint64_t extractNs)
+{
+	if (type < 0 || type >= kMatrixTypes)
+		return;
+	ResolveCell& c = _resolve[int(source)][type];
+	c.calls.fetch_add(1, std::memory_order_relaxed);
+	c.validateNs.fetch_add(validateNs, std::memory_order_relaxed);
+	c.extractNs.fetch_add(extractNs, std::memory_order_relaxed);
+	const uint64_t ns = validateNs + extractNs;
+	uint64_t prev = c.maxNs.load(std::memory_order_relaxed);
+	while (ns > prev && !c.maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {}
+}
+
+
+uint64_t NodeStats::total(Stat s) const
+{
+	uint64_t sum = 0;
+	for (const Slot& slot : _slots)
+		sum += slot.v[int(s)].load(std::memory_order_relaxed);
+	return sum;
+}
+
+
+void NodeStats::reset()
+{
+	for (Slot& slot : _slots)
+		for (std::atomic<uint64_t>& c : slot.v)
+			c.store(0, std::memory_order_relaxed);
+	for (auto& row : _resolve)
+		for (ResolveCell& c : row) {
+			c.calls.store(0, std::memory_order_relaxed);
+			c.validateNs.store(0, std::memory_order_relaxed);
+			c.extractNs.store(0, std::memory_order_relaxed);
+			c.maxNs.store(0, std::memory_order_relaxed);
+		}
+}
+
+
+std::string NodeStats::report(const char* const* typeNames) const
+{
+	std::string text;
+	char line[160];
+	for (int s = 0; s < int(Stat::Count); ++s) {
+		std::snprintf(line, sizeof line, "%s: %llu\n", statName(Stat(s)),
+		              (unsigned long long)total(Stat(s)));
+		text += line;
+	}
+	const uint64_t pixels = total(Stat::Pixels);
+	std::snprintf(line, sizeof line, "ns_per_pixel: %.3f",
+	              pixels ? double(total(Stat::EngineNs)) / double(pixels) : 0.0);
+	text += line;
+
+	// Per call: us in the input's validate(), us reading the matrix, and
+	// the slowest whole lookup.
+	static const char* const sources[] = { "camera", "axis" };
+	for (int src = 0; src < int(MatrixSource::Count); ++src)
+		for (int t = 0; t < kMatrixTypes; ++t) {
+			const ResolveCell& c = _resolve[src][t];
+			const uint64_t calls = c.calls.load(std::memory_order_relaxed);
+			if (!calls)
+				continue;
+			std::snprintf(line, sizeof line, "\nresolve %s/%s: %llu calls, validate %.1f us, matrix %.1f us, max %.1f us",
+			              sources[src], typeNames[t], (unsigned long long)calls,
+			              double(c.validateNs.load(std::memory_order_relaxed)) * 1e-3 / double(calls),
+			              double(c.extractNs.load(std::memory_order_relaxed)) * 1e-3 / double(calls),
+			              double(c.maxNs.load(std::memory_order_relaxed)) * 1e-3);
+			text += line;
+		}
+	return text;
+}
+
+} // namespace c44
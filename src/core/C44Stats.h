@@ -0,0 +1,87 @@
+// C44Stats.h
+//
+// Per-node performance counters. Render threads call pixel_engine on many
+// rows at once, so the counters must not make them share anything: each
+// thread gets its own cache line of counters (a slot, picked once per
+// thread) and bumps it with relaxed loads and stores, which compile to
+// plain moves. Reading the totals sums every slot. Past kSlots threads,
+// threads share slots and the odd increment can be lost; reset() while
+// rendering can also leave a few counts behind. Both only make the
+// numbers approximate.
+//
+// Input matrix lookups (camera/axis validate and matrix extraction) run
+// once per frame rather than per row, so they are kept apart in a small
+// shared table with atomic adds, per input kind and matrix type.
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace c44 {
+
+enum class Stat
+{
+	Rows,         // pixel_engine calls
+	Pixels,
+	EngineNs,     // time inside pixel_engine
+	Validates,
+	Inversions,
+	Provides,     // provideValues calls
+	PlanHits,     // _validate calls that reused the kernel plan
+	Count
+};
+
+const char* statName(Stat s);
+
+enum class MatrixSource { Camera, Axis, Count };
+
+class NodeStats
+{
+public:
+	static const int kSlots = 128;
+
+	void add(Stat s, uint64_t n = 1)
+	{
+		std::atomic<uint64_t>& c = _slots[threadSlot()].v[int(s)];
+		c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	static const int kMatrixTypes = 6;
+
+	// One lookup of the input matrix: the time in the input's validate()
+	// and in reading the matrix type 'type' from it.
+	void addResolve(MatrixSource source, int type, uint64_t validateNs, uint64_t extractNs);
+
+	uint64_t total(Stat s) const;
+	void reset();
+
+	// One "name: value" line per counter, plus ns per pixel, then one line
+	// per input kind and matrix type that has been looked up, named from
+	// 'typeNames' (kMatrixTypes entries).
+	std::string report(const char* const* typeNames) const;
+
+private:
+	struct alignas(64) Slot
+	{
+		std::atomic<uint64_t> v[int(Stat::Count)] = {};
+	};
+
+	static int threadSlot()
+	{
+		static std::atomic<int> next{ 0 };
+		thread_local const int slot = next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+		return slot;
+	}
+
+	struct ResolveCell
+	{
+		std::atomic<uint64_t> calls{ 0 }, validateNs{ 0 }, extractNs{ 0 }, maxNs{ 0 };
+	};
+
+	Slot        _slots[kSlots];
+	ResolveCell _resolve[int(MatrixSource::Count)][kMatrixTypes];
+};
+
+} // namespace c44
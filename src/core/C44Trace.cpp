@@ -0,0 +1,191 @@
+// C44Trace.cpp
+
+#include "C44Trace.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#include <process.h>
+#define c44_getpid _getpid
+#else
+#include <unistd.h>
+#define c44_getpid getpid
+#endif
+
+namespace c44 {
+namespace trace {
+
+namespace {
+
+struct Event
+{
+	const char* name;
+	const char* argName;
+	int64_t     begin;   // ns on Clock
+	int64_t     dur;
+	uint64_t    arg;
+};
+
+const uint64_t kRing = uint64_t(1) << 16;
+
+// Events a dump skips at the old end of a ring that has wrapped, where a
+// thread still recording may be overwriting them.
+const uint64_t kTornMargin = 1024;
+
+const int64_t kRowGapNs = 20000;
+
+struct Buffer
+{
+	uint32_t              tid;
+	std::atomic<uint64_t> head{ 0 };
+	Event                 events[kRing];
+};
+
+struct RowBatch
+{
+	const void* node = nullptr;
+	int64_t     begin = 0, end = 0;
+	uint64_t    rows = 0;
+};
+
+// Buffers live until the process exits, so a dump at exit still sees the
+// threads that have finished.
+std::mutex           registryMutex;
+std::vector<Buffer*> registry;
+std::string          tracePath;
+
+thread_local Buffer*  threadBuffer = nullptr;
+thread_local RowBatch threadBatch;
+
+int64_t toNs(Clock::time_point t)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+}
+
+Buffer* buffer()
+{
+	if (!threadBuffer) {
+		Buffer* b = new Buffer;
+		std::lock_guard<std::mutex> lock(registryMutex);
+		b->tid = uint32_t(registry.size() + 1);
+		registry.push_back(b);
+		threadBuffer = b;
+	}
+	return threadBuffer;
+}
+
+void push(const Event& e)
+{
+	Buffer* b = buffer();
+	const uint64_t h = b->head.load(std::memory_order_relaxed);
+	b->events[h & (kRing - 1)] = e;
+	b->head.store(h + 1, std::memory_order_release);
+}
+
+void flushBatch()
+{
+	RowBatch& batch = threadBatch;
+	if (batch.rows)
+		push({ "pixel_engine", "rows", batch.begin, batch.end - batch.begin, batch.rows });
+	batch = RowBatch();
+}
+
+bool init()
+{
+	const char* path = std::getenv("C44_TRACE");
+	if (!path || !*path)
+		return false;
+	tracePath = path;
+	std::atexit([] { dump(); });
+	return true;
+}
+
+} // namespace
+
+
+namespace detail { bool enabled = init(); }
+
+
+void record(const char* name, Clock::time_point begin, Clock::time_point end,
+            const char* argName, uint64_t arg)
+{
+	if (!enabled())
+		return;
+	flushBatch();
+	push({ name, argName, toNs(begin), toNs(end) - toNs(begin), arg });
+}
+
+
+void row(const void* node, Clock::time_point begin, Clock::time_point end)
+{
+	if (!enabled())
+		return;
+	RowBatch& batch = threadBatch;
+	const int64_t b = toNs(begin), e = toNs(end);
+	if (batch.rows && (batch.node != node || b - batch.end > kRowGapNs))
+		flushBatch();
+	if (!batch.rows) {
+		batch.node = node;
+		batch.begin = b;
+	}
+	batch.end = e;
+	++batch.rows;
+}
+
+
+bool dump()
+{
+	return enabled() && dump(tracePath);
+}
+
+
+bool dump(const std::string& path)
+{
+	if (!enabled())
+		return false;
+	flushBatch();
+
+	std::vector<Event> events;
+	std::vector<uint32_t> tids;
+	{
+		std::lock_guard<std::mutex> lock(registryMutex);
+		for (Buffer* b : registry) {
+			const uint64_t head = b->head.load(std::memory_order_acquire);
+			const uint64_t first = head > kRing ? head - kRing + kTornMargin : 0;
+			for (uint64_t i = first; i < head; ++i) {
+				events.push_back(b->events[i & (kRing - 1)]);
+				tids.push_back(b->tid);
+			}
+		}
+	}
+
+	int64_t origin = 0;
+	for (size_t i = 0; i < events.size(); ++i)
+		if (i == 0 || events[i].begin < origin)
+			origin = events[i].begin;
+
+	FILE* f = std::fopen(path.c_str(), "w");
+	if (!f)
+		return false;
+	const int pid = int(c44_getpid());
+	std::fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	std::fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"C44Matrix\"}}", pid);
+	for (size_t i = 0; i < events.size(); ++i) {
+		const Event& e = events[i];
+		std::fprintf(f, ",\n{\"name\":\"%s\",\"cat\":\"c44\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+		             "\"ts\":%.3f,\"dur\":%.3f",
+		             e.name, pid, tids[i], double(e.begin - origin) * 1e-3, double(e.dur) * 1e-3);
+		if (e.argName)
+			std::fprintf(f, ",\"args\":{\"%s\":%llu}", e.argName, (unsigned long long)e.arg);
+		std::fputs("}", f);
+	}
+	std::fputs("\n]}\n", f);
+	return std::fclose(f) == 0;
+}
+
+} // namespace trace
+} // namespace c44
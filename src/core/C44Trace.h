@@ -0,0 +1,68 @@
+// C44Trace.h
+//
+// Optional span tracing in Chrome's trace-event format, for seeing where a
+// render spends its time across threads. Set C44_TRACE to a file path to
+// turn it on; spans then go into a fixed ring buffer per thread (the last
+// 65536 per thread are kept) and are written to that file at exit and on
+// every dump(). Open the file in chrome://tracing or ui.perfetto.dev.
+//
+// Recording is lock-free: a thread only ever writes its own buffer, and
+// the registry of buffers is locked once per thread and by dump(). A dump
+// taken while other threads are still recording may show a few torn
+// events at the old end of a full ring. With C44_TRACE unset a span costs
+// a load and a branch.
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace c44 {
+namespace trace {
+
+typedef std::chrono::steady_clock Clock;
+
+namespace detail { extern bool enabled; }
+
+inline bool enabled() { return detail::enabled; }
+
+// 'name' and 'argName' must be string literals: only the pointers are kept.
+void record(const char* name, Clock::time_point begin, Clock::time_point end,
+            const char* argName = nullptr, uint64_t arg = 0);
+
+// One row of pixel_engine for 'node'. Consecutive rows of the same node on
+// a thread, less than 20 us apart, are merged into one "pixel_engine" span
+// with a row count, so a trace of a long render stays readable. A thread's
+// last open batch is only written once it records something else, or by
+// a dump() from that thread.
+void row(const void* node, Clock::time_point begin, Clock::time_point end);
+
+// Writes every buffer to $C44_TRACE, or to 'path'. False if tracing is off
+// or the file cannot be written.
+bool dump();
+bool dump(const std::string& path);
+
+// Records its own lifetime as a span named 'name'.
+class Span
+{
+	const char*       _name;
+	Clock::time_point _begin;
+
+public:
+	explicit Span(const char* name) : _name(enabled() ? name : nullptr)
+	{
+		if (_name)
+			_begin = Clock::now();
+	}
+	~Span()
+	{
+		if (_name)
+			record(_name, _begin, Clock::now());
+	}
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+};
+
+} // namespace trace
+} // namespace c44
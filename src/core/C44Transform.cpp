@@ -0,0 +1,803 @@
+// C44Transform.cpp
+//
+// Portable implementation of the shared C44 transform math.
+
+#include "C44Transform.h"
+#include "C44Cpu.h"
+#include "C44ChannelKernels.h"
+#include "C44FanOutKernels.h"
+#include "C44Kernels.h"
+#include "C44PlanarKernels.h"
+#include "C44Tune.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace c44 {
+
+// ---------------------------------------------------------------------------
+// Mat4f
+// ---------------------------------------------------------------------------
+
+Mat4f Mat4f::identity()
+{
+	Mat4f r;
+	for (int i = 0; i < 16; ++i)
+		r.m[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	return r;
+}
+
+Mat4f Mat4f::fromArray(const float* src)
+{
+	Mat4f r;
+	std::memcpy(r.m, src, sizeof(r.m));
+	return r;
+}
+
+Mat4f transpose(const Mat4f& a)
+{
+	Mat4f r;
+	for (int row = 0; row < 4; ++row)
+		for (int col = 0; col < 4; ++col)
+			r(row, col) = a(col, row);
+	return r;
+}
+
+Mat4d Mat4d::identity()
+{
+	Mat4d r;
+	for (int i = 0; i < 16; ++i)
+		r.m[i] = (i % 5 == 0) ? 1.0 : 0.0;
+	return r;
+}
+
+Mat4d Mat4d::fromFloat(const Mat4f& a)
+{
+	Mat4d r;
+	for (int i = 0; i < 16; ++i)
+		r.m[i] = a.m[i];
+	return r;
+}
+
+Mat4d transpose(const Mat4d& a)
+{
+	Mat4d r;
+	for (int row = 0; row < 4; ++row)
+		for (int col = 0; col < 4; ++col)
+			r(row, col) = a(col, row);
+	return r;
+}
+
+
+// Cofactor expansion in double; the result is rounded to T once.
+template <typename T>
+static bool invertImpl(const T* a, T* out)
+{
+	double s[16];
+	for (int i = 0; i < 16; ++i)
+		s[i] = a[i];
+
+	double inv[16];
+	inv[0]  =  s[5]*s[10]*s[15] - s[5]*s[11]*s[14] - s[9]*s[6]*s[15] + s[9]*s[7]*s[14] + s[13]*s[6]*s[11] - s[13]*s[7]*s[10];
+	inv[4]  = -s[4]*s[10]*s[15] + s[4]*s[11]*s[14] + s[8]*s[6]*s[15] - s[8]*s[7]*s[14] - s[12]*s[6]*s[11] + s[12]*s[7]*s[10];
+	inv[8]  =  s[4]*s[9]*s[15]  - s[4]*s[11]*s[13] - s[8]*s[5]*s[15] + s[8]*s[7]*s[13] + s[12]*s[5]*s[11] - s[12]*s[7]*s[9];
+	inv[12] = -s[4]*s[9]*s[14]  + s[4]*s[10]*s[13] + s[8]*s[5]*s[14] - s[8]*s[6]*s[13] - s[12]*s[5]*s[10] + s[12]*s[6]*s[9];
+	inv[1]  = -s[1]*s[10]*s[15] + s[1]*s[11]*s[14] + s[9]*s[2]*s[15] - s[9]*s[3]*s[14] - s[13]*s[2]*s[11] + s[13]*s[3]*s[10];
+	inv[5]  =  s[0]*s[10]*s[15] - s[0]*s[11]*s[14] - s[8]*s[2]*s[15] + s[8]*s[3]*s[14] + s[12]*s[2]*s[11] - s[12]*s[3]*s[10];
+	inv[9]  = -s[0]*s[9]*s[15]  + s[0]*s[11]*s[13] + s[8]*s[1]*s[15] - s[8]*s[3]*s[13] - s[12]*s[1]*s[11] + s[12]*s[3]*s[9];
+	inv[13] =  s[0]*s[9]*s[14]  - s[0]*s[10]*s[13] - s[8]*s[1]*s[14] + s[8]*s[2]*s[13] + s[12]*s[1]*s[10] - s[12]*s[2]*s[9];
+	inv[2]  =  s[1]*s[6]*s[15]  - s[1]*s[7]*s[14]  - s[5]*s[2]*s[15] + s[5]*s[3]*s[14] + s[13]*s[2]*s[7]  - s[13]*s[3]*s[6];
+	inv[6]  = -s[0]*s[6]*s[15]  + s[0]*s[7]*s[14]  + s[4]*s[2]*s[15] - s[4]*s[3]*s[14] - s[12]*s[2]*s[7]  + s[12]*s[3]*s[6];
+	inv[10] =  s[0]*s[5]*s[15]  - s[0]*s[7]*s[13]  - s[4]*s[1]*s[15] + s[4]*s[3]*s[13] + s[12]*s[1]*s[7]  - s[12]*s[3]*s[5];
+	inv[14] = -s[0]*s[5]*s[14]  + s[0]*s[6]*s[13]  + s[4]*s[1]*s[14] - s[4]*s[2]*s[13] - s[12]*s[1]*s[6]  + s[12]*s[2]*s[5];
+	inv[3]  = -s[1]*s[6]*s[11]  + s[1]*s[7]*s[10]  + s[5]*s[2]*s[11] - s[5]*s[3]*s[10] - s[9]*s[2]*s[7]   + s[9]*s[3]*s[6];
+	inv[7]  =  s[0]*s[6]*s[11]  - s[0]*s[7]*s[10]  - s[4]*s[2]*s[11] + s[4]*s[3]*s[10] + s[8]*s[2]*s[7]   - s[8]*s[3]*s[6];
+	inv[11] = -s[0]*s[5]*s[11]  + s[0]*s[7]*s[9]   + s[4]*s[1]*s[11] - s[4]*s[3]*s[9]  - s[8]*s[1]*s[7]   + s[8]*s[3]*s[5];
+	inv[15] =  s[0]*s[5]*s[10]  - s[0]*s[6]*s[9]   - s[4]*s[1]*s[10] + s[4]*s[2]*s[9]  + s[8]*s[1]*s[6]   - s[8]*s[2]*s[5];
+
+	const double det = s[0]*inv[0] + s[1]*inv[4] + s[2]*inv[8] + s[3]*inv[12];
+	if (det == 0.0 || !std::isfinite(det))
+		return false;
+
+	const double invDet = 1.0 / det;
+	for (int i = 0; i < 16; ++i)
+		out[i] = static_cast<T>(inv[i] * invDet);
+	return true;
+}
+
+bool invert(const Mat4f& a, Mat4f& out)
+{
+	return invertImpl(a.m, out.m);
+}
+
+bool invert(const Mat4d& a, Mat4d& out)
+{
+	return invertImpl(a.m, out.m);
+}
+
+
+template <typename T>
+static MatrixClass classifyImpl(const T* m)
+{
+	// Bottom row is m[3], m[7], m[11], m[15] in column-major order.
+	if (m[3] != 0 || m[7] != 0 || m[11] != 0 || m[15] != 1)
+		return MatrixClass::General;
+	for (int i = 0; i < 16; ++i)
+		if (m[i] != ((i % 5 == 0) ? 1 : 0))
+			return MatrixClass::Affine;
+	return MatrixClass::Identity;
+}
+
+MatrixClass classify(const Mat4f& a)
+{
+	return classifyImpl(a.m);
+}
+
+MatrixClass classify(const Mat4d& a)
+{
+	return classifyImpl(a.m);
+}
+
+const char* matrixClassName(MatrixClass c)
+{
+	switch (c) {
+	case MatrixClass::Identity: return "identity";
+	case MatrixClass::Affine:   return "affine";
+	case MatrixClass::General:  return "general";
+	}
+	return "unknown";
+}
+
+
+// ---------------------------------------------------------------------------
+// Sparse structure
+// ---------------------------------------------------------------------------
+
+SparseRows sparseRows(const Mat4f& mtx)
+{
+	SparseRows s;
+	for (int c = 0; c < 4; ++c) {
+		int n = 0;
+		for (int k = 0; k < 4; ++k) {
+			const float v = mtx.m[k * 4 + c];
+			if (v != 0.0f) {
+				s.index[c][n] = k;
+				s.coeff[c][n] = v;
+				++n;
+			}
+		}
+		s.count[c] = n;
+	}
+	return s;
+}
+
+bool isSwizzle(const SparseRows& s)
+{
+	for (int c = 0; c < 4; ++c)
+		if (s.count[c] > 1 || (s.count[c] == 1 && s.coeff[c][0] != 1.0f && s.coeff[c][0] != -1.0f))
+			return false;
+	return true;
+}
+
+unsigned passthroughMask(const SparseRows& s)
+{
+	unsigned mask = 0;
+	for (int c = 0; c < 4; ++c)
+		if (s.count[c] == 1 && s.index[c][0] == c && s.coeff[c][0] == 1.0f)
+			mask |= 1u << c;
+	return mask;
+}
+
+
+
+
+// ---------------------------------------------------------------------------
+// Kernels
+// ---------------------------------------------------------------------------
+
+namespace detail {
+
+#if defined(C44_SIMD_NEON)
+// AArch64 converts half in hardware; no runtime check needed.
+struct NeonHalf
+{
+	static simd::F4 load4(const uint16_t* p)
+	{
+		return { vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(p))) };
+	}
+
+	static void store4(uint16_t* p, simd::F4 v)
+	{
+		vst1_u16(p, vreinterpret_u16_f16(vcvt_f16_f32(v.v)));
+	}
+};
+typedef NeonHalf BaselineHalf;
+#else
+typedef ScalarHalf BaselineHalf;
+#endif
+
+const KernelSet& baselineKernels()
+{
+	static const KernelSet kernels = makeKernelSet<BaselineHalf>();
+	return kernels;
+}
+
+const PlanarTable* baselinePlanarTable()
+{
+	static const PlanarTable table = makePlanarTable<simd::F4, simd::F1<false>>();
+	return &table;
+}
+
+const ChannelTable* baselineChannelTable()
+{
+	static const ChannelTable table = makeChannelTable<simd::F4, simd::F1<false>>();
+	return &table;
+}
+
+const FanOutTable* baselineFanOutTable()
+{
+	static const FanOutTable table = makeFanOutTable<simd::F4, simd::F1<false>>();
+	return &table;
+}
+
+} // namespace detail
+
+
+// The best kernel set for this CPU, chosen once.
+static const detail::KernelSet& kernels()
+{
+	static const detail::KernelSet set = [] {
+		detail::KernelSet k = detail::baselineKernels();
+		if (cpuFeatures().f16c)
+			detail::f16cKernels(k);
+		return k;
+	}();
+	return set;
+}
+
+
+// The plan of the last matrix this thread transformed with, so that calls
+// row by row or block by block with the same matrix plan once.
+static const PlanarPlan& threadPlan(const Mat4f& mtx, bool wDivide)
+{
+	thread_local PlanarPlan plan;
+	thread_local bool planned = false;
+	if (!planned || plan.wDivide != wDivide || std::memcmp(plan.mtx.m, mtx.m, sizeof mtx.m) != 0) {
+		plan = planPlanar(mtx, wDivide);
+		planned = true;
+	}
+	return plan;
+}
+
+void transformPlanar(const Mat4f& mtx, bool wDivide,
+                     const float* const in[4], float* const out[4], size_t n)
+{
+	threadPlan(mtx, wDivide).run(15u, in, out, n);
+}
+
+
+// ---------------------------------------------------------------------------
+// Planar plans
+// ---------------------------------------------------------------------------
+
+const char* isaName(Isa isa)
+{
+	switch (isa) {
+	case Isa::Baseline: return "baseline";
+	case Isa::Avx2:     return "avx2";
+	case Isa::Avx512:   return "avx512";
+	}
+	return "unknown";
+}
+
+static const detail::PlanarTable* planarTable(Isa isa, bool reproducible = false)
+{
+	switch (isa) {
+	case Isa::Baseline: return detail::baselinePlanarTable();
+	case Isa::Avx2:     return detail::avx2PlanarTable(reproducible);
+	case Isa::Avx512:   return detail::avx512PlanarTable(reproducible);
+	}
+	return nullptr;
+}
+
+bool isaSupported(Isa isa)
+{
+	const CpuFeatures& cpu = cpuFeatures();
+	switch (isa) {
+	case Isa::Baseline: return true;
+	case Isa::Avx2:     return cpu.avx2 && cpu.fma && planarTable(isa);
+	case Isa::Avx512:   return cpu.avx512f && planarTable(isa);
+	}
+	return false;
+}
+
+Isa bestIsa()
+{
+	static const Isa best = isaSupported(Isa::Avx512) ? Isa::Avx512
+	                      : isaSupported(Isa::Avx2)   ? Isa::Avx2
+	                      :                             Isa::Baseline;
+	return best;
+}
+
+static const int kMaxSparseTerms = 8;
+
+PlanarPlan planPlanar(const Mat4f& mtx, bool wDivide, KernelVariant variant)
+{
+	if (!isaSupported(variant.isa))
+		variant.isa = bestIsa();
+	int unroll = 0;
+	while (unroll < 2 && detail::kUnrollFactors[unroll] != variant.unroll)
+		++unroll;
+	if (detail::kUnrollFactors[unroll] != variant.unroll)
+		unroll = 0;
+	variant.unroll = detail::kUnrollFactors[unroll];
+
+	PlanarPlan p;
+	p.mtx = mtx;
+	p.cls = classify(mtx);
+	p.wDivide = wDivide;
+	p.variant = variant;
+	const detail::PlanarTable* table = planarTable(variant.isa, variant.reproducible);
+	p.kernels = table->k[unroll][int(p.cls)][wDivide ? 1 : 0];
+	p.streamKernels = table->stream[int(p.cls)][wDivide ? 1 : 0];
+
+	// Swizzles, scales and other matrices with at most two terms per output
+	// on average are cheaper term by term than as a dense product.
+	p.rows = sparseRows(mtx);
+	if (!wDivide && p.rows.terms() <= kMaxSparseTerms) {
+		p.sparse = true;
+		p.sparseKernels = table->sparse;
+		p.variant.streamWidth = 0;
+	}
+	return p;
+}
+
+PlanarPlan planPlanar(const Mat4f& mtx, bool wDivide, bool reproducible)
+{
+	KernelVariant variant = tunedVariant(classify(mtx), wDivide);
+	variant.reproducible = variant.reproducible || reproducible;
+	return planPlanar(mtx, wDivide, variant);
+}
+
+
+// ---------------------------------------------------------------------------
+// Channel matrices
+// ---------------------------------------------------------------------------
+
+ChannelMatrix ChannelMatrix::identity(int channels)
+{
+	ChannelMatrix r;
+	r.inputs = r.outputs = channels;
+	for (int i = 0; i < kMaxChannels; ++i)
+		r(i, i) = 1.0f;
+	return r;
+}
+
+ChannelMatrix ChannelMatrix::fromMat4(const Mat4f& a)
+{
+	ChannelMatrix r;
+	r.inputs = r.outputs = 4;
+	for (int row = 0; row < 4; ++row)
+		for (int col = 0; col < 4; ++col)
+			r(row, col) = a(row, col);
+	return r;
+}
+
+ChannelMatrix transpose(const ChannelMatrix& a)
+{
+	ChannelMatrix r;
+	r.inputs = a.outputs;
+	r.outputs = a.inputs;
+	for (int row = 0; row < kMaxChannels; ++row)
+		for (int col = 0; col < kMaxChannels; ++col)
+			r(row, col) = a(col, row);
+	return r;
+}
+
+bool invert(const ChannelMatrix& a, ChannelMatrix& out)
+{
+	const int n = a.inputs;
+	if (n != a.outputs || n < 1 || n > kMaxChannels)
+		return false;
+
+	double s[kMaxChannels][2 * kMaxChannels];
+	for (int row = 0; row < n; ++row)
+		for (int col = 0; col < n; ++col) {
+			s[row][col] = a(row, col);
+			s[row][n + col] = row == col ? 1.0 : 0.0;
+		}
+
+	for (int col = 0; col < n; ++col) {
+		int pivot = col;
+		for (int row = col + 1; row < n; ++row)
+			if (std::fabs(s[row][col]) > std::fabs(s[pivot][col]))
+				pivot = row;
+		if (s[pivot][col] == 0.0 || !std::isfinite(s[pivot][col]))
+			return false;
+		if (pivot != col)
+			for (int k = 0; k < 2 * n; ++k)
+				std::swap(s[pivot][k], s[col][k]);
+
+		const double inv = 1.0 / s[col][col];
+		for (int k = 0; k < 2 * n; ++k)
+			s[col][k] *= inv;
+		for (int row = 0; row < n; ++row) {
+			const double f = s[row][col];
+			if (row == col || f == 0.0)
+				continue;
+			for (int k = 0; k < 2 * n; ++k)
+				s[row][k] -= f * s[col][k];
+		}
+	}
+
+	ChannelMatrix r;
+	r.inputs = r.outputs = n;
+	for (int row = 0; row < n; ++row)
+		for (int col = 0; col < n; ++col) {
+			if (!std::isfinite(s[row][n + col]))
+				return false;
+			r(row, col) = float(s[row][n + col]);
+		}
+	out = r;
+	return true;
+}
+
+static const detail::ChannelTable* channelTable(Isa isa, bool reproducible)
+{
+	switch (isa) {
+	case Isa::Baseline: return detail::baselineChannelTable();
+	case Isa::Avx2:     return detail::avx2ChannelTable(reproducible);
+	case Isa::Avx512:   return detail::avx512ChannelTable(reproducible);
+	}
+	return nullptr;
+}
+
+ChannelPlan planChannels(const ChannelMatrix& mtx, bool reproducible, Isa isa)
+{
+	ChannelPlan p;
+	p.mtx = mtx;
+	p.isa = isaSupported(isa) ? isa : bestIsa();
+	p.reproducible = reproducible;
+	if (mtx.inputs >= 1 && mtx.inputs <= kMaxChannels &&
+	    mtx.outputs >= 1 && mtx.outputs <= kMaxChannels)
+		p.kernel = channelTable(p.isa, reproducible)->k[mtx.inputs - 1][mtx.outputs - 1];
+	return p;
+}
+
+// The ISA tuned for general matrices, whose kernels are the closest kin.
+ChannelPlan planChannels(const ChannelMatrix& mtx, bool reproducible)
+{
+	const KernelVariant tuned = tunedVariant(MatrixClass::General, false);
+	return planChannels(mtx, reproducible || tuned.reproducible, tuned.isa);
+}
+
+
+// ---------------------------------------------------------------------------
+// Fan-out
+// ---------------------------------------------------------------------------
+
+static const detail::FanOutTable* fanOutTable(Isa isa, bool reproducible)
+{
+	switch (isa) {
+	case Isa::Baseline: return detail::baselineFanOutTable();
+	case Isa::Avx2:     return detail::avx2FanOutTable(reproducible);
+	case Isa::Avx512:   return detail::avx512FanOutTable(reproducible);
+	}
+	return nullptr;
+}
+
+FanOutPlan planFanOut(const Mat4f* mtx, int count, unsigned wDivide, KernelVariant variant)
+{
+	if (!isaSupported(variant.isa))
+		variant.isa = bestIsa();
+
+	FanOutPlan p;
+	p.variant = variant;
+	if (count < 1 || count > kMaxFanOut)
+		return p;
+	p.count = count;
+	p.wDivide = wDivide & ((1u << count) - 1);
+	for (int k = 0; k < count; ++k)
+		p.mtx[k] = mtx[k];
+	const detail::FanOutTable* table = fanOutTable(variant.isa, variant.reproducible);
+	p.kernel = table->k[count - 1][p.wDivide];
+	p.streamKernel = table->stream[count - 1][p.wDivide];
+	return p;
+}
+
+FanOutPlan planFanOut(const Mat4f* mtx, int count, unsigned wDivide, bool reproducible)
+{
+	KernelVariant variant = tunedVariant(MatrixClass::General, wDivide != 0);
+	variant.reproducible = variant.reproducible || reproducible;
+	return planFanOut(mtx, count, wDivide, variant);
+}
+
+
+// ---------------------------------------------------------------------------
+// Strided points
+// ---------------------------------------------------------------------------
+
+template <typename T, typename P>
+static P makePlanar(T* const planes[4], SampleType type)
+{
+	P p;
+	for (int c = 0; c < 4; ++c) {
+		p.ptr[c] = planes[c];
+		p.stride[c] = ptrdiff_t(sizeof(T));
+	}
+	p.type = type;
+	return p;
+}
+
+template <typename T, typename P>
+static P makePacked(T* rgba, SampleType type)
+{
+	P p;
+	for (int c = 0; c < 4; ++c) {
+		p.ptr[c] = rgba + c;
+		p.stride[c] = ptrdiff_t(4 * sizeof(T));
+	}
+	p.type = type;
+	return p;
+}
+
+ConstStridedPoints planarPoints(const float* const in[4])    { return makePlanar<const float, ConstStridedPoints>(in, SampleType::Float); }
+StridedPoints      planarPoints(float* const out[4])         { return makePlanar<float, StridedPoints>(out, SampleType::Float); }
+ConstStridedPoints packedPoints(const float* rgba)           { return makePacked<const float, ConstStridedPoints>(rgba, SampleType::Float); }
+StridedPoints      packedPoints(float* rgba)                 { return makePacked<float, StridedPoints>(rgba, SampleType::Float); }
+ConstStridedPoints planarPoints(const uint16_t* const in[4]) { return makePlanar<const uint16_t, ConstStridedPoints>(in, SampleType::Half); }
+StridedPoints      planarPoints(uint16_t* const out[4])      { return makePlanar<uint16_t, StridedPoints>(out, SampleType::Half); }
+ConstStridedPoints packedPoints(const uint16_t* rgba)        { return makePacked<const uint16_t, ConstStridedPoints>(rgba, SampleType::Half); }
+StridedPoints      packedPoints(uint16_t* rgba)              { return makePacked<uint16_t, StridedPoints>(rgba, SampleType::Half); }
+
+
+template <typename P>
+static PointLayout layoutOfImpl(const P& p)
+{
+	const ptrdiff_t size = ptrdiff_t(sampleBytes(p.type));
+	const char* base = static_cast<const char*>(p.ptr[0]);
+
+	bool planar = true, packed = true;
+	for (int c = 0; c < 4; ++c) {
+		if (!p.ptr[c])
+			return PointLayout::Strided;
+		planar = planar && p.stride[c] == size;
+		packed = packed && p.stride[c] == 4 * size &&
+		         static_cast<const char*>(p.ptr[c]) == base + c * size;
+	}
+	return planar ? PointLayout::Planar : packed ? PointLayout::Packed : PointLayout::Strided;
+}
+
+PointLayout layoutOf(const ConstStridedPoints& p) { return layoutOfImpl(p); }
+PointLayout layoutOf(const StridedPoints& p)      { return layoutOfImpl(p); }
+
+
+static inline float loadSample(const void* p, SampleType t)
+{
+	return t == SampleType::Half ? halfToFloat(*static_cast<const uint16_t*>(p))
+	                             : *static_cast<const float*>(p);
+}
+
+static inline void storeSample(void* p, SampleType t, float v)
+{
+	if (t == SampleType::Half)
+		*static_cast<uint16_t*>(p) = floatToHalf(v);
+	else
+		*static_cast<float*>(p) = v;
+}
+
+
+void transformStrided(const Mat4f& mtx, bool wDivide,
+                      const ConstStridedPoints& in, const StridedPoints& out, size_t n)
+{
+	transformStrided(threadPlan(mtx, wDivide), in, out, n);
+}
+
+void transformStrided(const PlanarPlan& plan,
+                      const ConstStridedPoints& in, const StridedPoints& out, size_t n)
+{
+	const PointLayout inLayout = layoutOf(in);
+	const PointLayout outLayout = layoutOf(out);
+
+	if (inLayout != PointLayout::Strided && outLayout != PointLayout::Strided) {
+		const bool inPlanarFloat = inLayout == PointLayout::Planar && in.type == SampleType::Float;
+		const bool outPlanarFloat = outLayout == PointLayout::Planar && out.type == SampleType::Float;
+		const detail::KernelSet& k = kernels();
+		const int ti = int(in.type), to = int(out.type);
+
+		if (inPlanarFloat && outPlanarFloat) {
+			const float* const src[4] = { static_cast<const float*>(in.ptr[0]), static_cast<const float*>(in.ptr[1]),
+			                              static_cast<const float*>(in.ptr[2]), static_cast<const float*>(in.ptr[3]) };
+			float* const dst[4] = { static_cast<float*>(out.ptr[0]), static_cast<float*>(out.ptr[1]),
+			                        static_cast<float*>(out.ptr[2]), static_cast<float*>(out.ptr[3]) };
+			plan.run(15u, src, dst, n);
+			return;
+		}
+
+		// Other sample types and packed RGBA are converted a block at a time
+		// into planar float scratch that stays in L1; a planar float side is
+		// used in place.
+		const size_t kBlock = 512;
+		alignas(64) float block[4][kBlock];
+		float* const scratch[4] = { block[0], block[1], block[2], block[3] };
+		for (size_t base = 0; base < n; base += kBlock) {
+			const size_t count = std::min(kBlock, n - base);
+			const float* src[4];
+			float* dst[4];
+			for (int c = 0; c < 4; ++c) {
+				src[c] = inPlanarFloat ? static_cast<const float*>(in.ptr[c]) + base : block[c];
+				dst[c] = outPlanarFloat ? static_cast<float*>(out.ptr[c]) + base : block[c];
+			}
+
+			if (inLayout == PointLayout::Packed)
+				k.unpack[ti](static_cast<const char*>(in.ptr[0]) + base * 4 * sampleBytes(in.type), scratch, count);
+			else if (!inPlanarFloat)
+				for (int c = 0; c < 4; ++c)
+					k.widen(static_cast<const uint16_t*>(in.ptr[c]) + base, block[c], count);
+
+			plan.run(15u, src, dst, count);
+
+			if (outLayout == PointLayout::Packed)
+				k.pack[to](dst, static_cast<char*>(out.ptr[0]) + base * 4 * sampleBytes(out.type), count);
+			else if (!outPlanarFloat)
+				for (int c = 0; c < 4; ++c)
+					k.narrow(block[c], static_cast<uint16_t*>(out.ptr[c]) + base, count);
+		}
+		return;
+	}
+
+	// Anything else: gather a block into planar float scratch, run the
+	// plan on it and scatter the results.
+	const size_t kBlock = 256;
+	float block[4][kBlock];
+	const float* const src[4] = { block[0], block[1], block[2], block[3] };
+	float* const dst[4] = { block[0], block[1], block[2], block[3] };
+	static const float kMissing[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	const unsigned mask = (out.ptr[0] ? 1u : 0u) | (out.ptr[1] ? 2u : 0u) |
+	                      (out.ptr[2] ? 4u : 0u) | (out.ptr[3] ? 8u : 0u);
+
+	for (size_t base = 0; base < n; base += kBlock) {
+		const size_t count = std::min(kBlock, n - base);
+
+		for (int c = 0; c < 4; ++c) {
+			if (!in.ptr[c]) {
+				std::fill(block[c], block[c] + count, kMissing[c]);
+				continue;
+			}
+			const char* p = static_cast<const char*>(in.ptr[c]) + ptrdiff_t(base) * in.stride[c];
+			for (size_t i = 0; i < count; ++i, p += in.stride[c])
+				block[c][i] = loadSample(p, in.type);
+		}
+
+		plan.run(mask, src, dst, count);
+
+		for (int c = 0; c < 4; ++c) {
+			if (!out.ptr[c])
+				continue;
+			char* p = static_cast<char*>(out.ptr[c]) + ptrdiff_t(base) * out.stride[c];
+			for (size_t i = 0; i < count; ++i, p += out.stride[c])
+				storeSample(p, out.type, block[c][i]);
+		}
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+// Interleaved points
+//
+// Storage type S, arithmetic type A, matrix class and component count are
+// all template parameters so each combination compiles to a straight loop.
+// ---------------------------------------------------------------------------
+
+template <typename S, typename A, MatrixClass C, int N>
+static void pointsKernel(const A* m, bool wDivide,
+                         const S* in, size_t inStride, S* out, size_t outStride, size_t n)
+{
+	for (size_t i = 0; i < n; ++i, in += inStride, out += outStride) {
+		const A r = in[0], g = in[1], b = in[2];
+		const A a = (N == 4) ? A(in[3]) : A(1);
+
+		A x, y, z, w;
+		if (C == MatrixClass::Identity) {
+			x = r; y = g; z = b; w = a;
+		}
+		else {
+			x = m[0] * r + m[4] * g + m[8]  * b + m[12] * a;
+			y = m[1] * r + m[5] * g + m[9]  * b + m[13] * a;
+			z = m[2] * r + m[6] * g + m[10] * b + m[14] * a;
+			w = (C == MatrixClass::Affine) ? a
+			                               : m[3] * r + m[7] * g + m[11] * b + m[15] * a;
+		}
+
+		if (wDivide) {
+			const A iw = A(1) / w;
+			x *= iw;
+			y *= iw;
+			z *= iw;
+			w *= iw;
+		}
+
+		out[0] = S(x);
+		out[1] = S(y);
+		out[2] = S(z);
+		if (N == 4)
+			out[3] = S(w);
+	}
+}
+
+
+template <typename S, typename A, int N>
+static void pointsDispatch(const A* m, MatrixClass c, bool wDivide,
+                           const S* in, size_t inStride, S* out, size_t outStride, size_t n)
+{
+	switch (c) {
+	case MatrixClass::Identity:
+		// Three-component points have w == 1 so the divide is a no-op too.
+		if (in == out && inStride == outStride && (!wDivide || N == 3))
+			return;
+		pointsKernel<S, A, MatrixClass::Identity, N>(m, wDivide, in, inStride, out, outStride, n);
+		break;
+	case MatrixClass::Affine:
+		pointsKernel<S, A, MatrixClass::Affine, N>(m, wDivide && N == 4, in, inStride, out, outStride, n);
+		break;
+	case MatrixClass::General:
+		pointsKernel<S, A, MatrixClass::General, N>(m, wDivide, in, inStride, out, outStride, n);
+		break;
+	}
+}
+
+
+template <typename S, typename A>
+static void pointsEntry(const A* m, MatrixClass c, bool wDivide,
+                        const S* in, size_t inStride, S* out, size_t outStride,
+                        size_t n, int components)
+{
+	if (components == 3)
+		pointsDispatch<S, A, 3>(m, c, wDivide, in, inStride, out, outStride, n);
+	else
+		pointsDispatch<S, A, 4>(m, c, wDivide, in, inStride, out, outStride, n);
+}
+
+
+void transformPoints(const Mat4f& mtx, bool wDivide, bool useClass,
+                     const float* in, size_t inStride, float* out, size_t outStride,
+                     size_t n, int components)
+{
+	const MatrixClass c = useClass ? classify(mtx) : MatrixClass::General;
+	if (c != MatrixClass::General) {
+		pointsEntry<float, float>(mtx.m, c, wDivide, in, inStride, out, outStride, n, components);
+		return;
+	}
+
+	// The general case goes through the vectorised strided kernels.
+	ConstStridedPoints src;
+	StridedPoints dst;
+	src.type = dst.type = SampleType::Float;
+	for (int k = 0; k < 4; ++k) {
+		const bool present = k < components;
+		src.ptr[k] = present ? in + k : nullptr;
+		dst.ptr[k] = present ? out + k : nullptr;
+		src.stride[k] = ptrdiff_t(inStride * sizeof(float));
+		dst.stride[k] = ptrdiff_t(outStride * sizeof(float));
+	}
+	transformStrided(mtx, wDivide, src, dst, n);
+}
+
+void transformPoints(const Mat4d& mtx, bool wDivide, bool useClass,
+                     const float* in, size_t inStride, float* out, size_t outStride,
+                     size_t n, int components)
+{
+	const MatrixClass c = useClass ? classify(mtx) : MatrixClass::General;
+	pointsEntry<float, double>(mtx.m, c, wDivide, in, inStride, out, outStride, n, components);
+}
+
+void transformPoints(const Mat4d& mtx, bool wDivide, bool useClass,
+                     const double* in, size_t inStride, double* out, size_t outStride,
+                     size_t n, int components)
+{
+	const MatrixClass c = useClass ? classify(mtx) : MatrixClass::General;
+	pointsEntry<double, double>(mtx.m, c, wDivide, in, inStride, out, outStride, n, components);
+}
+
+} // namespace c44
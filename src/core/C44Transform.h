@@ -0,0 +1,388 @@
+// C44Transform.h
+//
+// Nuke-independent 4x4 transform math shared by the C44Matrix plugin and the
+// command-line tools. Nothing in here may include DDImage headers.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace c44 {
+
+// ---------------------------------------------------------------------------
+// 4x4 float matrix laid out exactly like DD::Image::Matrix4 (column-major,
+// m[col * 4 + row]), so Matrix4::array() can be copied straight in and the
+// values of the node's "matrix" knob mean the same thing everywhere.
+// ---------------------------------------------------------------------------
+
+struct Mat4f
+{
+	float m[16];
+
+	static Mat4f identity();
+	static Mat4f fromArray(const float* src);
+
+	float  operator()(int row, int col) const { return m[col * 4 + row]; }
+	float& operator()(int row, int col)       { return m[col * 4 + row]; }
+};
+
+// Double-precision counterpart, same layout.
+struct Mat4d
+{
+	double m[16];
+
+	static Mat4d identity();
+	static Mat4d fromFloat(const Mat4f& a);
+
+	double  operator()(int row, int col) const { return m[col * 4 + row]; }
+	double& operator()(int row, int col)       { return m[col * 4 + row]; }
+};
+
+Mat4f transpose(const Mat4f& a);
+
+// Returns false (and leaves 'out' untouched) if 'a' is singular.
+bool invert(const Mat4f& a, Mat4f& out);
+
+Mat4d transpose(const Mat4d& a);
+bool invert(const Mat4d& a, Mat4d& out);
+
+
+// ---------------------------------------------------------------------------
+// Matrix classes
+//
+// Kernels pick a cheaper path when the matrix has structure: identity is a
+// copy, and an affine matrix (bottom row 0 0 0 1) leaves w untouched.
+// ---------------------------------------------------------------------------
+
+enum class MatrixClass { Identity, Affine, General };
+
+MatrixClass classify(const Mat4f& a);
+MatrixClass classify(const Mat4d& a);
+const char* matrixClassName(MatrixClass c);
+
+
+// ---------------------------------------------------------------------------
+// Sparse structure
+//
+// Output c is the sum of count[c] terms coeff[c][k] * input[index[c][k]],
+// with the zero coefficients left out and the rest in input order. Channel
+// shuffles, swizzles and sign flips have at most one term per output, with
+// a coefficient of +1 or -1.
+// ---------------------------------------------------------------------------
+
+struct SparseRows
+{
+	int   count[4];
+	int   index[4][4];
+	float coeff[4][4];
+
+	int terms() const { return count[0] + count[1] + count[2] + count[3]; }
+};
+
+SparseRows sparseRows(const Mat4f& mtx);
+bool isSwizzle(const SparseRows& s);
+
+// Bit c is set when output c is exactly input c. Without a w divide those
+// channels can be passed through without touching the pixels.
+unsigned passthroughMask(const SparseRows& s);
+
+
+// ---------------------------------------------------------------------------
+// Kernels
+//
+// Apply 'mtx' to n pixels held in four planar float rows (R, G, B, A).
+// Same result as Matrix4::transform() followed by the optional w divide that
+// C44Matrix::pixel_engine performs, for finite inputs. Kernels that skip
+// zero coefficients (the sparse kernels of matrices with 8 or fewer
+// non-zero terms, and the w of the identity and affine classes) never
+// compute 0 * inf or 0 * NaN, so an infinite or NaN input only reaches the
+// outputs with a non-zero coefficient for it, where Matrix4::transform()
+// makes every output NaN. `c44bench accuracy` pins both. out[i] may alias
+// in[i]. Vectorised; the plan of the last matrix is kept per thread, so
+// calls row by row with the same matrix plan once.
+// ---------------------------------------------------------------------------
+
+void transformPlanar(const Mat4f& mtx, bool wDivide,
+                     const float* const in[4], float* const out[4], size_t n);
+
+
+// ---------------------------------------------------------------------------
+// Planar plans
+//
+// What pixel_engine needs, resolved once in _validate: the matrix plus one
+// kernel per subset of output channels (bit 0 = red ... bit 3 = alpha),
+// each compiled for the plan's matrix class, w_divide setting and ISA.
+// Channels outside the subset are neither computed nor written, and their
+// out[] pointer may be null. The AVX2 and AVX-512 kernels use FMA, so their
+// results can differ from the baseline ones in the last bit, unless the
+// plan is reproducible: then every ISA, unroll factor and store flavour
+// evaluates the same operations in the same order and gives the same bits
+// (except for which NaN a NaN result is, as compilers may swap operands).
+// Pixels never depend on their neighbours, so neither does the split of a
+// row or image across threads.
+//
+// Without w_divide, matrices with few enough non-zero coefficients take the
+// sparse kernels instead: only the non-zero terms are loaded and summed,
+// and single-term outputs become plane copies, negations or scales. Zero
+// coefficients are skipped rather than multiplied, so an infinite input no
+// longer turns unrelated outputs into NaN.
+// ---------------------------------------------------------------------------
+
+enum class Isa { Baseline, Avx2, Avx512 };
+
+const char* isaName(Isa isa);
+bool isaSupported(Isa isa);   // compiled in and reported by the CPU
+Isa bestIsa();
+
+// A compiled flavour of the dense kernels. Which one is fastest depends on
+// the machine; see C44Tune.h. Rows of at least streamWidth pixels use the
+// streaming kernels, which write outputs with non-temporal stores and
+// prefetch inputs, so very wide rows don't flush the cache.
+struct KernelVariant
+{
+	Isa    isa          = Isa::Baseline;
+	int    unroll       = 1;       // vectors per loop iteration: 1, 2 or 4
+	size_t streamWidth  = 0;       // 0: never stream
+	bool   reproducible = false;   // no FMA, see above
+};
+
+typedef void (*PlanarKernel)(const float* m, const float* const in[4],
+                             float* const out[4], size_t n);
+
+// The sparse kernels take the terms, worked out once by planPlanar, rather
+// than the matrix.
+typedef void (*SparseKernel)(const SparseRows& rows, const float* const in[4],
+                             float* const out[4], size_t n);
+
+struct PlanarPlan
+{
+	Mat4f               mtx     = Mat4f::identity();
+	MatrixClass         cls     = MatrixClass::Identity;
+	bool                wDivide = false;
+	KernelVariant       variant;
+	SparseRows          rows    = {};        // non-zero terms of mtx
+	bool                sparse  = false;     // sparse kernels, see above
+	const PlanarKernel* kernels = nullptr;   // [16], by channel mask
+	const PlanarKernel* streamKernels = nullptr;   // [16], for n >= variant.streamWidth
+	const SparseKernel* sparseKernels = nullptr;   // [16], by channel mask
+
+	// The dense kernel for a row of n pixels, which sparse plans have too.
+	PlanarKernel kernel(unsigned mask, size_t n) const
+	{
+		const bool stream = variant.streamWidth && n >= variant.streamWidth;
+		return (stream ? streamKernels : kernels)[mask & 15u];
+	}
+
+	// The function run() calls, for probes and profilers to name.
+	const void* entry(unsigned mask, size_t n) const
+	{
+		return sparse ? reinterpret_cast<const void*>(sparseKernels[mask & 15u])
+		              : reinterpret_cast<const void*>(kernel(mask, n));
+	}
+
+	void run(unsigned mask, const float* const in[4], float* const out[4], size_t n) const
+	{
+		if (sparse)
+			sparseKernels[mask & 15u](rows, in, out, n);
+		else
+			kernel(mask, n)(mtx.m, in, out, n);
+	}
+};
+
+// An unsupported ISA falls back to the best supported one, and an unknown
+// unroll factor to 1. Sparse plans never stream. Without a variant, the
+// tuned one for the matrix class is used (tunedVariant() in C44Tune.h),
+// made reproducible if asked to.
+PlanarPlan planPlanar(const Mat4f& mtx, bool wDivide, KernelVariant variant);
+PlanarPlan planPlanar(const Mat4f& mtx, bool wDivide, bool reproducible = false);
+
+
+// ---------------------------------------------------------------------------
+// Channel matrices
+//
+// For data with more or other channels than RGBA: spectral samples, AOVs
+// recombined into beauty, camera RGB plus extra sensor channels to XYZ.
+// 'inputs' planar float channels go to 'outputs' ones, each up to
+// kMaxChannels, output r being the sum of m(r, c) * input c in input
+// order. A 4x4 channel matrix gives the same bits as the dense planar
+// kernel of the same matrix without w_divide.
+// ---------------------------------------------------------------------------
+
+const int kMaxChannels = 8;
+
+// Row-major, one row per output: m[row * kMaxChannels + col], unlike Mat4f.
+// Entries outside inputs x outputs are ignored.
+struct ChannelMatrix
+{
+	int   inputs = 0, outputs = 0;
+	float m[kMaxChannels * kMaxChannels] = {};
+
+	static ChannelMatrix identity(int channels);
+	static ChannelMatrix fromMat4(const Mat4f& a);
+
+	float  operator()(int row, int col) const { return m[row * kMaxChannels + col]; }
+	float& operator()(int row, int col)       { return m[row * kMaxChannels + col]; }
+};
+
+// Swaps inputs and outputs along with the coefficients.
+ChannelMatrix transpose(const ChannelMatrix& a);
+
+// Gauss-Jordan elimination in double with partial pivoting. Returns false
+// (and leaves 'out' untouched) if 'a' is not square or is singular.
+bool invert(const ChannelMatrix& a, ChannelMatrix& out);
+
+typedef void (*ChannelKernel)(const float* m, const float* const* in,
+                              float* const* out, size_t n);
+
+// in[] holds 'inputs' planes and out[] 'outputs' ones; a null output is not
+// written. out[r] may alias in[c]; partial overlaps are not allowed. There
+// is a kernel for every size up to kMaxChannels x kMaxChannels, picked by
+// planChannels, with the loops over channels unrolled at compile time.
+struct ChannelPlan
+{
+	ChannelMatrix mtx;
+	Isa           isa          = Isa::Baseline;
+	bool          reproducible = false;
+	ChannelKernel kernel       = nullptr;   // null if the size is out of range
+
+	void run(const float* const* in, float* const* out, size_t n) const
+	{
+		kernel(mtx.m, in, out, n);
+	}
+};
+
+// An unsupported ISA falls back to the best supported one.
+ChannelPlan planChannels(const ChannelMatrix& mtx, bool reproducible = false);
+ChannelPlan planChannels(const ChannelMatrix& mtx, bool reproducible, Isa isa);
+
+
+// ---------------------------------------------------------------------------
+// Fan-out
+//
+// Several 4x4 matrices applied to the same four planar float rows in one
+// call, for one position pass wanted in several spaces at once, each
+// matrix with or without its own w divide. The row is taken in chunks that
+// stay in L1 and every matrix is applied to a chunk before the next is
+// read, so the inputs come from memory once. The outputs of matrix k are
+// those of the dense general planar kernel of that matrix on the same ISA,
+// so a matrix gives the same bits whatever it is fanned out with.
+// ---------------------------------------------------------------------------
+
+const int kMaxFanOut = 4;
+
+typedef void (*FanOutKernel)(const float* m, const float* const in[4],
+                             float* const* out, size_t n);
+
+// out[] holds four planes per matrix, x y z w of matrix k at out[4 k + c];
+// a null plane is not written. Output planes may alias input planes;
+// partial overlaps are not allowed. Rows of at least variant.streamWidth
+// pixels are written with non-temporal stores, as by the planar kernels.
+struct FanOutPlan
+{
+	Mat4f          mtx[kMaxFanOut] = {};
+	int            count        = 0;
+	unsigned       wDivide      = 0;         // bit k: divide matrix k's outputs by their w
+	KernelVariant  variant;                  // unroll is not used
+	FanOutKernel   kernel       = nullptr;   // null if count is out of range
+	FanOutKernel   streamKernel = nullptr;
+
+	// The kernel run() calls for a row of n pixels.
+	FanOutKernel rowKernel(size_t n) const
+	{
+		const bool stream = variant.streamWidth && n >= variant.streamWidth;
+		return stream ? streamKernel : kernel;
+	}
+
+	void run(const float* const in[4], float* const* out, size_t n) const
+	{
+		rowKernel(n)(mtx[0].m, in, out, n);
+	}
+};
+
+// An unsupported ISA falls back to the best supported one. Without a
+// variant, the one tuned for general matrices is used, as for planPlanar.
+FanOutPlan planFanOut(const Mat4f* mtx, int count, unsigned wDivide, KernelVariant variant);
+FanOutPlan planFanOut(const Mat4f* mtx, int count, unsigned wDivide, bool reproducible = false);
+
+
+// ---------------------------------------------------------------------------
+// Strided points
+//
+// Component c (R, G, B, A or x, y, z, w) of point i lives at
+// ptr[c] + i * stride[c], with strides in bytes. This describes planar rows
+// (stride 4), packed RGBA (ptr[c] = base + c, stride 16) and AoS vertex
+// structs with padding alike. A null input component reads as 0 (x, y, z)
+// or 1 (w); a null output component is not written.
+//
+// Samples are float32 or IEEE half (uint16_t bits, see C44Half.h). Half is
+// widened to float in registers and narrowed again on store, so callers can
+// keep half buffers end to end; the arithmetic is always float.
+// ---------------------------------------------------------------------------
+
+enum class SampleType : uint8_t { Float, Half };
+
+inline size_t sampleBytes(SampleType t) { return t == SampleType::Half ? 2 : 4; }
+
+struct ConstStridedPoints
+{
+	const void* ptr[4];
+	ptrdiff_t   stride[4];
+	SampleType  type;
+};
+
+struct StridedPoints
+{
+	void*      ptr[4];
+	ptrdiff_t  stride[4];
+	SampleType type;
+};
+
+enum class PointLayout { Planar, Packed, Strided };
+
+ConstStridedPoints planarPoints(const float* const in[4]);
+StridedPoints      planarPoints(float* const out[4]);
+ConstStridedPoints packedPoints(const float* rgba);
+StridedPoints      packedPoints(float* rgba);
+
+ConstStridedPoints planarPoints(const uint16_t* const in[4]);
+StridedPoints      planarPoints(uint16_t* const out[4]);
+ConstStridedPoints packedPoints(const uint16_t* rgba);
+StridedPoints      packedPoints(uint16_t* rgba);
+
+PointLayout layoutOf(const ConstStridedPoints& p);
+PointLayout layoutOf(const StridedPoints& p);
+
+// The math always runs on a planar plan, so every layout gets the ISA and
+// variant the tuner picked for transformPlanar. Planar float rows are
+// transformed in place. Packed RGBA and half samples (in and out alike, any
+// mix) are converted block by block into planar float scratch that stays
+// in L1, with F16C conversions where the CPU has them; anything else is
+// gathered and scattered through the same blocks. out may describe the
+// same memory as in when both have the same sample type; partial overlaps
+// are not allowed. The plan of the last matrix is kept per thread, as with
+// transformPlanar; callers that keep their own plan pass it instead.
+void transformStrided(const Mat4f& mtx, bool wDivide,
+                      const ConstStridedPoints& in, const StridedPoints& out, size_t n);
+void transformStrided(const PlanarPlan& plan,
+                      const ConstStridedPoints& in, const StridedPoints& out, size_t n);
+
+// Apply a matrix to n interleaved points of 'components' values (3 or 4),
+// point i starting at in[i * inStride] / out[i * outStride]. Three-component
+// points have an implicit w of 1 that is not written back. With 'useClass'
+// the matrix class picks a cheaper kernel; without it every point goes
+// through the general 16 multiply-add path. out may equal in.
+//
+// The double overload of the float data computes in double precision and
+// rounds once on store.
+void transformPoints(const Mat4f& mtx, bool wDivide, bool useClass,
+                     const float* in, size_t inStride, float* out, size_t outStride,
+                     size_t n, int components);
+void transformPoints(const Mat4d& mtx, bool wDivide, bool useClass,
+                     const float* in, size_t inStride, float* out, size_t outStride,
+                     size_t n, int components);
+void transformPoints(const Mat4d& mtx, bool wDivide, bool useClass,
+                     const double* in, size_t inStride, double* out, size_t outStride,
+                     size_t n, int components);
+
+} // namespace c44
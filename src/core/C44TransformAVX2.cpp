@@ -0,0 +1,57 @@
+// C44TransformAVX2.cpp
+//
+// Planar, channel-matrix and fan-out kernels for AVX2 + FMA, eight pixels per
+// iteration, plus an unfused set for reproducible mode. Built with -mavx2
+// -mfma (/arch:AVX2 on MSVC) and only selected when the CPU has both.
+
+#include "C44ChannelKernels.h"
+#include "C44FanOutKernels.h"
+#include "C44PlanarKernels.h"
+
+namespace c44 {
+namespace detail {
+
+#if defined(C44_SIMD_AVX2)
+
+const PlanarTable* avx2PlanarTable(bool reproducible)
+{
+	static const PlanarTable fused = makePlanarTable<simd::F8, simd::F1<true>>();
+	static const PlanarTable exact = makePlanarTable<simd::Unfused<simd::F8>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+const ChannelTable* avx2ChannelTable(bool reproducible)
+{
+	static const ChannelTable fused = makeChannelTable<simd::F8, simd::F1<true>>();
+	static const ChannelTable exact = makeChannelTable<simd::Unfused<simd::F8>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+const FanOutTable* avx2FanOutTable(bool reproducible)
+{
+	static const FanOutTable fused = makeFanOutTable<simd::F8, simd::F1<true>>();
+	static const FanOutTable exact = makeFanOutTable<simd::Unfused<simd::F8>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+#else
+
+const PlanarTable* avx2PlanarTable(bool)
+{
+	return nullptr;
+}
+
+const ChannelTable* avx2ChannelTable(bool)
+{
+	return nullptr;
+}
+
+const FanOutTable* avx2FanOutTable(bool)
+{
+	return nullptr;
+}
+
+#endif
+
+} // namespace detail
+} // namespace c44
@@ -0,0 +1,58 @@
+// C44TransformAVX512.cpp
+//
+// Planar, channel-matrix and fan-out kernels for AVX-512F, sixteen pixels per
+// iteration with FMA, plus an unfused set for reproducible mode. Built with
+// -mavx512f (/arch:AVX512 on MSVC) and only selected when the CPU and OS
+// support it.
+
+#include "C44ChannelKernels.h"
+#include "C44FanOutKernels.h"
+#include "C44PlanarKernels.h"
+
+namespace c44 {
+namespace detail {
+
+#if defined(C44_SIMD_AVX512)
+
+const PlanarTable* avx512PlanarTable(bool reproducible)
+{
+	static const PlanarTable fused = makePlanarTable<simd::F16, simd::F1<true>>();
+	static const PlanarTable exact = makePlanarTable<simd::Unfused<simd::F16>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+const ChannelTable* avx512ChannelTable(bool reproducible)
+{
+	static const ChannelTable fused = makeChannelTable<simd::F16, simd::F1<true>>();
+	static const ChannelTable exact = makeChannelTable<simd::Unfused<simd::F16>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+const FanOutTable* avx512FanOutTable(bool reproducible)
+{
+	static const FanOutTable fused = makeFanOutTable<simd::F16, simd::F1<true>>();
+	static const FanOutTable exact = makeFanOutTable<simd::Unfused<simd::F16>, simd::F1<false>>();
+	return reproducible ? &exact : &fused;
+}
+
+#else
+
+const PlanarTable* avx512PlanarTable(bool)
+{
+	return nullptr;
+}
+
+const ChannelTable* avx512ChannelTable(bool)
+{
+	return nullptr;
+}
+
+const FanOutTable* avx512FanOutTable(bool)
+{
+	return nullptr;
+}
+
+#endif
+
+} // namespace detail
+} // namespace c44
@@ -0,0 +1,51 @@
+// C44TransformF16C.cpp
+//
+// Half-float kernels using F16C conversions. Built with -mf16c (see the
+// CMake files) and only selected at runtime when the CPU reports F16C.
+
+#include "C44Kernels.h"
+
+#if defined(__F16C__) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+
+#include <immintrin.h>
+
+namespace c44 {
+namespace detail {
+
+struct F16CHalf
+{
+	static simd::F4 load4(const uint16_t* p)
+	{
+		return { _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))) };
+	}
+
+	static void store4(uint16_t* p, simd::F4 v)
+	{
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_cvtps_ph(v.v, _MM_FROUND_TO_NEAREST_INT));
+	}
+};
+
+bool f16cKernels(KernelSet& out)
+{
+	static const KernelSet kernels = makeKernelSet<F16CHalf>();
+	out = kernels;
+	return true;
+}
+
+} // namespace detail
+} // namespace c44
+
+#else
+
+namespace c44 {
+namespace detail {
+
+bool f16cKernels(KernelSet&)
+{
+	return false;
+}
+
+} // namespace detail
+} // namespace c44
+
+#endif
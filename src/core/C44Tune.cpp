@@ -0,0 +1,421 @@
+// C44Tune.cpp
+
+#include "C44Tune.h"
+#include "C44Cpu.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace c44 {
+
+static const int kTuneVersion = 2;
+
+// A candidate has to beat the current pick by this much to replace it, so
+// noise doesn't flip the table between runs.
+static const double kTuneMargin = 0.97;
+
+static const char* const kClassKeys[3] = { "identity", "affine", "general" };
+
+
+std::vector<KernelVariant> candidateVariants()
+{
+	std::vector<KernelVariant> v;
+	for (Isa isa : { Isa::Avx512, Isa::Avx2, Isa::Baseline }) {
+		if (!isaSupported(isa))
+			continue;
+		for (int unroll : { 1, 2, 4 }) {
+			KernelVariant k;
+			k.isa = isa;
+			k.unroll = unroll;
+			v.push_back(k);
+		}
+	}
+	return v;
+}
+
+
+// ---------------------------------------------------------------------------
+// Measurement
+// ---------------------------------------------------------------------------
+
+// Well-conditioned representatives of each class, dense enough to stay off
+// the sparse kernels.
+static Mat4f sampleMatrix(MatrixClass cls)
+{
+	static const float affine[16] = {  0.9f,  0.1f,  -0.2f,   0.0f,
+	                                   0.3f,  1.1f,   0.05f,  0.0f,
+	                                  -0.1f,  0.2f,   0.8f,   0.0f,
+	                                   0.5f, -0.25f,  0.125f, 1.0f };
+	if (cls == MatrixClass::Identity)
+		return Mat4f::identity();
+
+	Mat4f m = Mat4f::fromArray(affine);
+	if (cls == MatrixClass::General) {
+		m.m[3]  = 0.01f;
+		m.m[7]  = 0.02f;
+		m.m[11] = 0.03f;
+	}
+	return m;
+}
+
+
+double measurePlanar(const PlanarPlan& plan, size_t width)
+{
+	typedef std::chrono::steady_clock Clock;
+	const size_t n = width < 64 ? 64 : width;
+
+	std::vector<float> buf(8 * n);
+	for (size_t i = 0; i < buf.size(); ++i)
+		buf[i] = 0.5f + float(i % 97) / 97.0f;
+	const float* const in[4] = { &buf[0], &buf[n], &buf[2 * n], &buf[3 * n] };
+	float* const out[4] = { &buf[4 * n], &buf[5 * n], &buf[6 * n], &buf[7 * n] };
+
+	for (int i = 0; i < 4; ++i)
+		plan.run(15u, in, out, n);
+
+	// Enough rows per sample for about half a millisecond.
+	int reps = 1;
+	for (;;) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			plan.run(15u, in, out, n);
+		if (std::chrono::duration<double>(Clock::now() - t0).count() > 5e-4 || reps >= (1 << 20))
+			break;
+		reps *= 2;
+	}
+
+	double best = 1e30;
+	for (int sample = 0; sample < 5; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			plan.run(15u, in, out, n);
+		const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+		if (s < best)
+			best = s;
+	}
+	return best * 1e9 / (double(reps) * double(n));
+}
+
+
+std::vector<size_t> streamSweepWidths()
+{
+	std::vector<size_t> w;
+	for (size_t n = 4096; n <= 524288; n *= 2)
+		w.push_back(n);
+	return w;
+}
+
+
+// The narrowest sweep width from which streaming beats regular stores at
+// every wider one, for the general class; 0 if it never does.
+static size_t tuneStreamWidth(KernelVariant variant, void (*progress)(const char* line))
+{
+	const Mat4f m = sampleMatrix(MatrixClass::General);
+	const std::vector<size_t> widths = streamSweepWidths();
+	std::vector<bool> wins(widths.size());
+
+	for (size_t k = 0; k < widths.size(); ++k) {
+		variant.streamWidth = 0;
+		const double regular = measurePlanar(planPlanar(m, false, variant), widths[k]);
+		variant.streamWidth = 1;
+		const double stream = measurePlanar(planPlanar(m, false, variant), widths[k]);
+		wins[k] = stream < regular * kTuneMargin;
+		if (progress) {
+			char line[128];
+			std::snprintf(line, sizeof(line), "stream   width %-7zu  %7.3f ns/px regular  %7.3f ns/px streaming",
+			              widths[k], regular, stream);
+			progress(line);
+		}
+	}
+
+	size_t threshold = 0;
+	for (size_t k = widths.size(); k-- > 0 && wins[k];)
+		threshold = widths[k];
+	return threshold;
+}
+
+
+TuneTable autotune(int width, void (*progress)(const char* line))
+{
+	if (width < 64)
+		width = 64;
+
+	TuneTable table;
+	table.width = width;
+	table.cpu = cpuSignature();
+
+	const std::vector<KernelVariant> candidates = candidateVariants();
+	for (int c = 0; c < 3; ++c) {
+		const Mat4f m = sampleMatrix(MatrixClass(c));
+		for (int wd = 0; wd < 2; ++wd) {
+			double best = 0.0;
+			for (size_t k = 0; k < candidates.size(); ++k) {
+				const PlanarPlan plan = planPlanar(m, wd != 0, candidates[k]);
+				const double ns = measurePlanar(plan, size_t(width));
+				if (k == 0 || ns < best * kTuneMargin) {
+					best = ns;
+					table.choice[c][wd] = plan.variant;
+				}
+				if (progress) {
+					char line[128];
+					std::snprintf(line, sizeof(line), "%-8s w_divide=%d  %-8s x%d  %7.3f ns/px",
+					              kClassKeys[c], wd, isaName(plan.variant.isa),
+					              plan.variant.unroll, ns);
+					progress(line);
+				}
+			}
+		}
+	}
+
+	table.streamWidth = tuneStreamWidth(table.choice[int(MatrixClass::General)][0], progress);
+	for (int c = 0; c < 3; ++c)
+		for (int wd = 0; wd < 2; ++wd)
+			table.choice[c][wd].streamWidth = table.streamWidth;
+	return table;
+}
+
+
+// ---------------------------------------------------------------------------
+// Cache file
+// ---------------------------------------------------------------------------
+
+std::string cpuSignature()
+{
+	const CpuFeatures& cpu = cpuFeatures();
+	std::string name(cpu.name);
+	while (!name.empty() && (name.back() == ' ' || name.back() == '\0'))
+		name.pop_back();
+	const size_t first = name.find_first_not_of(' ');
+	name = first == std::string::npos ? std::string("unknown") : name.substr(first);
+
+	std::string s = name + " |";
+	if (cpu.f16c)    s += " f16c";
+	if (cpu.avx2)    s += " avx2";
+	if (cpu.fma)     s += " fma";
+	if (cpu.avx512f) s += " avx512f";
+	return s;
+}
+
+
+std::string defaultTuneCachePath()
+{
+	if (const char* env = std::getenv("C44_TUNE_CACHE"))
+		return env;
+
+	std::string base;
+	char host[256] = {};
+#if defined(_WIN32)
+	if (const char* local = std::getenv("LOCALAPPDATA"))
+		base = local;
+	if (const char* name = std::getenv("COMPUTERNAME"))
+		std::strncpy(host, name, sizeof(host) - 1);
+#else
+	if (const char* xdg = std::getenv("XDG_CACHE_HOME"))
+		base = xdg;
+	else if (const char* home = std::getenv("HOME"))
+		base = std::string(home) + "/.cache";
+	if (gethostname(host, sizeof(host) - 1) != 0)
+		host[0] = '\0';
+#endif
+	if (base.empty())
+		return std::string();
+	return base + "/c44/tune-" + (host[0] ? host : "localhost") + ".txt";
+}
+
+
+static Isa parseIsa(const std::string& s, bool& ok)
+{
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 })
+		if (s == isaName(isa))
+			return isa;
+	ok = false;
+	return Isa::Baseline;
+}
+
+
+bool loadTuneTable(const std::string& path, TuneTable& table)
+{
+	std::ifstream in(path.c_str());
+	if (!in)
+		return false;
+
+	TuneTable t;
+	int version = 0;
+	bool seen[3][2] = {};
+	std::string line;
+	while (std::getline(in, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		std::string key;
+		fields >> key;
+
+		if (key == "version")
+			fields >> version;
+		else if (key == "cpu") {
+			std::getline(fields >> std::ws, t.cpu);
+		}
+		else if (key == "width")
+			fields >> t.width;
+		else if (key == "stream")
+			fields >> t.streamWidth;
+		else {
+			int c = 0;
+			while (c < 3 && key != kClassKeys[c])
+				++c;
+			int wd = -1;
+			std::string isa;
+			KernelVariant v;
+			fields >> wd >> isa >> v.unroll;
+			bool ok = c < 3 && (wd == 0 || wd == 1) && !fields.fail();
+			if (ok)
+				v.isa = parseIsa(isa, ok);
+			if (!ok || !isaSupported(v.isa))
+				return false;
+			t.choice[c][wd] = v;
+			seen[c][wd] = true;
+		}
+	}
+
+	if (version != kTuneVersion || t.cpu != cpuSignature())
+		return false;
+	for (int c = 0; c < 3; ++c) {
+		if (!seen[c][0] || !seen[c][1])
+			return false;
+		for (int wd = 0; wd < 2; ++wd)
+			t.choice[c][wd].streamWidth = t.streamWidth;
+	}
+	table = t;
+	return true;
+}
+
+
+// Creates the parent directories of 'path', ignoring ones that exist.
+static void makeParentDirs(const std::string& path)
+{
+	for (size_t i = 1; i < path.size(); ++i) {
+		if (path[i] != '/' && path[i] != '\\')
+			continue;
+		const std::string dir = path.substr(0, i);
+#if defined(_WIN32)
+		_mkdir(dir.c_str());
+#else
+		mkdir(dir.c_str(), 0755);
+#endif
+	}
+}
+
+
+bool saveTuneTable(const std::string& path, const TuneTable& table)
+{
+	if (path.empty())
+		return false;
+	makeParentDirs(path);
+
+	// Write a private file and rename it over the cache, so concurrent
+	// processes on the same host never read a half-written table.
+#if defined(_WIN32)
+	const std::string tmp = path + ".tmp" + std::to_string(_getpid());
+#else
+	const std::string tmp = path + ".tmp" + std::to_string(getpid());
+#endif
+	{
+		std::ofstream out(tmp.c_str());
+		if (!out)
+			return false;
+		out << "# C44 kernel tuning table, regenerate with `c44bench autotune`\n"
+		    << "version " << kTuneVersion << "\n"
+		    << "cpu " << table.cpu << "\n"
+		    << "width " << table.width << "\n"
+		    << "stream " << table.streamWidth << "\n";
+		for (int c = 0; c < 3; ++c)
+			for (int wd = 0; wd < 2; ++wd)
+				out << kClassKeys[c] << " " << wd << " "
+				    << isaName(table.choice[c][wd].isa) << " "
+				    << table.choice[c][wd].unroll << "\n";
+		if (!out.flush())
+			return false;
+	}
+#if defined(_WIN32)
+	std::remove(path.c_str());
+#endif
+	if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+		std::remove(tmp.c_str());
+		return false;
+	}
+	return true;
+}
+
+
+// ---------------------------------------------------------------------------
+// Process-wide table
+// ---------------------------------------------------------------------------
+
+// The table from the cache file, or without one the static choice: the
+// widest ISA without unrolling. Tuning takes a while and allocates a few
+// MB, too much for the first _validate of a session on Nuke's UI thread,
+// so it only runs when asked for with `c44bench autotune`.
+static TuneTable tunedTable()
+{
+	const char* env = std::getenv("C44_AUTOTUNE");
+	const std::string mode = env ? env : "";
+
+	TuneTable t;
+	const std::string path = defaultTuneCachePath();
+	if (mode != "0" && mode != "off" && !path.empty() && loadTuneTable(path, t))
+		return t;
+
+	for (int c = 0; c < 3; ++c)
+		for (int wd = 0; wd < 2; ++wd)
+			t.choice[c][wd].isa = bestIsa();
+	t.streamWidth = kDefaultStreamWidth;
+	t.cpu = cpuSignature();
+	return t;
+}
+
+static TuneTable initialTable()
+{
+	TuneTable t = tunedTable();
+	if (const char* env = std::getenv("C44_STREAM_WIDTH")) {
+		char* end = nullptr;
+		const unsigned long long v = std::strtoull(env, &end, 10);
+		if (end != env && *end == '\0')
+			t.streamWidth = size_t(v);
+	}
+	const char* repro = std::getenv("C44_REPRODUCIBLE");
+	const bool reproducible = repro && *repro && std::strcmp(repro, "0") != 0;
+	for (int c = 0; c < 3; ++c) {
+		for (int wd = 0; wd < 2; ++wd) {
+			t.choice[c][wd].streamWidth = t.streamWidth;
+			t.choice[c][wd].reproducible = reproducible;
+		}
+	}
+	return t;
+}
+
+
+const TuneTable& activeTuneTable()
+{
+	static const TuneTable table = initialTable();
+	return table;
+}
+
+
+KernelVariant tunedVariant(MatrixClass cls, bool wDivide)
+{
+	return activeTuneTable().choice[int(cls)][wDivide ? 1 : 0];
+}
+
+} // namespace c44
@@ -0,0 +1,67 @@
+// C44Tune.h
+//
+// Per-machine choice of dense kernel variant. The fastest ISA and unroll
+// factor differ between CPU generations, so `c44bench autotune`
+// microbenchmarks the candidates for each matrix class at a representative
+// row width and keeps the winners. It then sweeps row widths for the
+// narrowest one from which the streaming kernels stay faster. The result
+// is stored in a small per-host cache file, which every process reads when
+// it builds its first plan. Without the file, plans use the widest ISA
+// without unrolling and the default streaming threshold.
+//
+// Cache location: $C44_TUNE_CACHE if set, else c44/tune-<host>.txt under
+// $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA%. C44_AUTOTUNE=0 ignores the
+// file. C44_STREAM_WIDTH overrides the streaming threshold in pixels
+// (0: never), and C44_REPRODUCIBLE=1 makes every tuned variant
+// reproducible.
+
+#pragma once
+
+#include "C44Transform.h"
+
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+struct TuneTable
+{
+	KernelVariant choice[3][2];   // [MatrixClass][wDivide]
+	size_t        streamWidth = 0;   // copied into every choice
+	int           width = 0;      // row width the table was measured at
+	std::string   cpu;            // cpuSignature() at the time
+};
+
+// Candidate variants for this CPU, widest ISA and smallest unroll first.
+std::vector<KernelVariant> candidateVariants();
+
+// Microbenchmarks every candidate for every class and w_divide setting.
+// 'progress', if set, is called with a line of text per measurement.
+TuneTable autotune(int width, void (*progress)(const char* line) = nullptr);
+
+// Best-of-several time of 'plan' over one row of 'width' pixels, in
+// nanoseconds per pixel, with in- and output rows reused between passes.
+double measurePlanar(const PlanarPlan& plan, size_t width);
+
+// Row widths the streaming threshold is chosen from, and the threshold
+// used without tuning: from there the eight planes of a row (32 bytes per
+// pixel) no longer fit a typical L2.
+std::vector<size_t> streamSweepWidths();
+static const size_t kDefaultStreamWidth = 32768;
+
+// The variant for a class, from the process-wide table. The first call
+// loads the cache file, as described above.
+KernelVariant tunedVariant(MatrixClass cls, bool wDivide);
+const TuneTable& activeTuneTable();
+
+// Text form of the cache. load fails on a missing or malformed file, or
+// one recorded on a different CPU.
+std::string defaultTuneCachePath();
+std::string cpuSignature();
+bool loadTuneTable(const std::string& path, TuneTable& table);
+bool saveTuneTable(const std::string& path, const TuneTable& table);
+
+// Row width `c44bench autotune` measures at by default.
+static const int kDefaultTuneWidth = 2048;
+
+} // namespace c44
@@ -0,0 +1,79 @@
+// BoundedQueue.h
+//
+// Blocking FIFO with a fixed capacity, used to hand frames between the
+// read, transform and write stages of the sequence pipeline.
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace c44 {
+
+template <typename T>
+class BoundedQueue
+{
+	std::mutex              _lock;
+	std::condition_variable _notEmpty, _notFull;
+	std::deque<T>           _items;
+	size_t                  _capacity;
+	bool                    _closed;
+
+public:
+	explicit BoundedQueue(size_t capacity) :
+		_capacity(capacity ? capacity : 1),
+		_closed(false)
+	{}
+
+	// Blocks while the queue is full. Returns false if the queue was closed.
+	bool push(T item)
+	{
+		std::unique_lock<std::mutex> lk(_lock);
+		_notFull.wait(lk, [this] { return _closed || _items.size() < _capacity; });
+		if (_closed)
+			return false;
+		_items.push_back(std::move(item));
+		_notEmpty.notify_one();
+		return true;
+	}
+
+	// Blocks while the queue is empty. Returns false once the queue is closed
+	// and drained.
+	bool pop(T& item)
+	{
+		std::unique_lock<std::mutex> lk(_lock);
+		_notEmpty.wait(lk, [this] { return _closed || !_items.empty(); });
+		if (_items.empty())
+			return false;
+		item = std::move(_items.front());
+		_items.pop_front();
+		_notFull.notify_one();
+		return true;
+	}
+
+	// Non-blocking pop; false if nothing is queued right now.
+	bool tryPop(T& item)
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		if (_items.empty())
+			return false;
+		item = std::move(_items.front());
+		_items.pop_front();
+		_notFull.notify_one();
+		return true;
+	}
+
+	// Wakes every waiter; pending items can still be popped.
+	void close()
+	{
+		std::lock_guard<std::mutex> lk(_lock);
+		_closed = true;
+		_notEmpty.notify_all();
+		_notFull.notify_all();
+	}
+};
+
+} // namespace c44
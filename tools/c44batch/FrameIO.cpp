@@ -0,0 +1,181 @@
+// FrameIO.cpp
+//
+// Backend selection, shared file helpers and the pread/pwrite backend.
+
+#include "FrameIO.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace c44 {
+
+static std::runtime_error ioError(const std::string& path, const char* what, int err)
+{
+	return std::runtime_error(path + ": " + what + ": " + std::strerror(err));
+}
+
+
+int openFrameFile(const std::string& path, const RawFrame& frame,
+                  bool write, bool& direct)
+{
+	const int base = write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY;
+
+	int fd = -1;
+#ifdef O_DIRECT
+	if (direct) {
+		fd = ::open(path.c_str(), base | O_DIRECT | O_CLOEXEC, 0644);
+		if (fd < 0 && errno == EINVAL)
+			direct = false;   // e.g. tmpfs
+	}
+#else
+	direct = false;
+#endif
+	if (fd < 0 && !direct)
+		fd = ::open(path.c_str(), base | O_CLOEXEC, 0644);
+	if (fd < 0)
+		throw ioError(path, write ? "cannot create" : "cannot open", errno);
+
+	if (!write) {
+		struct stat st;
+		if (::fstat(fd, &st) != 0) {
+			const int err = errno;
+			::close(fd);
+			throw ioError(path, "stat failed", err);
+		}
+		if (size_t(st.st_size) != frame.bytes()) {
+			::close(fd);
+			throw std::runtime_error(path + ": size does not match " +
+			                         std::to_string(frame.width) + "x" +
+			                         std::to_string(frame.height) + " RGBA " +
+			                         (frame.type == SampleType::Half ? "half" : "float"));
+		}
+	}
+	return fd;
+}
+
+
+size_t ioRequestLength(const RawFrame& frame, size_t offset, size_t length, bool direct)
+{
+	if (!direct)
+		return length;
+	const size_t end = std::min(offset + length, frame.bytes());
+	const size_t padded = (end + kIoAlignment - 1) & ~(kIoAlignment - 1);
+	return padded - offset;
+}
+
+
+void finishFrameFile(int fd, const std::string& path, const RawFrame& frame,
+                     bool write, bool direct)
+{
+	int err = 0;
+	if (write && direct && frame.paddedBytes() != frame.bytes() &&
+	    ::ftruncate(fd, off_t(frame.bytes())) != 0)
+		err = errno;
+	if (::close(fd) != 0 && !err)
+		err = errno;
+	if (err)
+		throw ioError(path, "write failed", err);
+}
+
+
+// ---------------------------------------------------------------------------
+// pread/pwrite backend
+// ---------------------------------------------------------------------------
+
+namespace {
+
+class PosixFrameIO : public FrameIO
+{
+	IoOptions              _opts;
+	std::deque<RawFrame*>  _done;
+
+	void _transfer(const std::string& path, RawFrame* frame, bool write)
+	{
+		bool direct = _opts.direct;
+		const int fd = openFrameFile(path, *frame, write, direct);
+		char* buf = frame->data();
+		const size_t total = frame->bytes();
+
+		size_t offset = 0;
+		while (offset < total) {
+			const size_t len = ioRequestLength(*frame, offset, total - offset, direct);
+			const ssize_t n = write ? ::pwrite(fd, buf + offset, len, off_t(offset))
+			                        : ::pread(fd, buf + offset, len, off_t(offset));
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0) {
+				const int err = n < 0 ? errno : EIO;
+				::close(fd);
+				throw ioError(path, write ? "write failed" : "read failed", err);
+			}
+			offset += size_t(n);
+		}
+
+		finishFrameFile(fd, path, *frame, write, direct);
+		_done.push_back(frame);
+	}
+
+public:
+	explicit PosixFrameIO(const IoOptions& opts) : _opts(opts) {}
+
+	const char* name() const override { return "posix"; }
+	unsigned depth() const override { return 1; }
+	unsigned inFlight() const override { return unsigned(_done.size()); }
+
+	// Transfers run synchronously; waitAny() only hands the frame back.
+	void startRead(const std::string& path, RawFrame* frame) override
+	{
+		_transfer(path, frame, false);
+	}
+
+	void startWrite(const std::string& path, RawFrame* frame) override
+	{
+		_transfer(path, frame, true);
+	}
+
+	RawFrame* waitAny() override
+	{
+		if (_done.empty())
+			throw std::logic_error("waitAny() with nothing in flight");
+		RawFrame* frame = _done.front();
+		_done.pop_front();
+		return frame;
+	}
+};
+
+} // namespace
+
+
+IoBackend parseIoBackend(const std::string& name)
+{
+	if (name == "auto")
+		return IoBackend::Auto;
+	if (name == "posix")
+		return IoBackend::Posix;
+	if (name == "uring")
+		return IoBackend::Uring;
+	throw std::runtime_error("unknown I/O backend '" + name + "' (auto, posix, uring)");
+}
+
+
+std::unique_ptr<FrameIO> createFrameIO(const IoOptions& opts)
+{
+	if (opts.backend == IoBackend::Uring ||
+	    (opts.backend == IoBackend::Auto && uringAvailable())) {
+		std::unique_ptr<FrameIO> io = createUringFrameIO(opts);
+		if (io)
+			return io;
+		if (opts.backend == IoBackend::Uring)
+			throw std::runtime_error("io_uring is not available on this system");
+	}
+	return std::unique_ptr<FrameIO>(new PosixFrameIO(opts));
+}
+
+} // namespace c44
@@ -0,0 +1,81 @@
+// FrameIO.h
+//
+// Asynchronous frame I/O backends for the batch tools.
+//
+// A FrameIO keeps up to depth() whole-frame transfers in flight. The pipeline
+// starts transfers with startRead()/startWrite() and collects them with
+// waitAny(), so a single I/O thread can overlap several frames. Two backends:
+//
+//   posix  pread/pwrite, one transfer at a time (portable fallback)
+//   uring  io_uring, every frame split into chunks with many in flight
+//
+// Both optionally open files with O_DIRECT, which is why frames live in
+// RawFrame's aligned, padded buffers.
+
+#pragma once
+
+#include "RawFrame.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace c44 {
+
+enum class IoBackend { Auto, Posix, Uring };
+
+struct IoOptions
+{
+	IoBackend backend    = IoBackend::Auto;
+	unsigned  depth      = 4;         // frames in flight per FrameIO (uring)
+	size_t    chunkBytes = 1 << 20;   // bytes per request (uring)
+	bool      direct     = false;     // O_DIRECT, falls back if unsupported
+};
+
+class FrameIO
+{
+public:
+	virtual ~FrameIO() {}
+
+	virtual const char* name() const = 0;
+	virtual unsigned depth() const = 0;
+	virtual unsigned inFlight() const = 0;
+
+	// 'frame' must already be allocated at the expected size and stays owned
+	// by the caller; it must not be touched until waitAny() hands it back.
+	virtual void startRead(const std::string& path, RawFrame* frame) = 0;
+	virtual void startWrite(const std::string& path, RawFrame* frame) = 0;
+
+	// Blocks until one started transfer has finished and returns its frame.
+	// Throws std::runtime_error if that transfer failed (including a file
+	// whose size does not match the frame).
+	virtual RawFrame* waitAny() = 0;
+};
+
+// Auto picks io_uring when the kernel allows it and pread/pwrite otherwise.
+std::unique_ptr<FrameIO> createFrameIO(const IoOptions& opts);
+bool uringAvailable();
+IoBackend parseIoBackend(const std::string& name);
+
+
+// ---------------------------------------------------------------------------
+// Helpers shared by the backends
+// ---------------------------------------------------------------------------
+
+// Opens a frame file, retrying without O_DIRECT if the filesystem refuses it.
+// 'direct' is updated to what was actually used. Readers are checked against
+// the frame size. Throws std::runtime_error.
+int openFrameFile(const std::string& path, const RawFrame& frame,
+                  bool write, bool& direct);
+
+// Bytes to request for [offset, offset + length) of a frame: O_DIRECT needs
+// the tail rounded up to kIoAlignment (the buffer is padded for it).
+size_t ioRequestLength(const RawFrame& frame, size_t offset, size_t length, bool direct);
+
+// Trims an O_DIRECT write's padding and closes the file. Throws on failure.
+void finishFrameFile(int fd, const std::string& path, const RawFrame& frame,
+                     bool write, bool direct);
+
+std::unique_ptr<FrameIO> createUringFrameIO(const IoOptions& opts);
+
+} // namespace c44
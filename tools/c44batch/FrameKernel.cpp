@@ -0,0 +1,44 @@
+// FrameKernel.cpp
+
+#include "FrameKernel.h"
+
+#include <stdexcept>
+
+namespace c44 {
+
+FrameKernel FrameKernel::fromKnobValues(const float values[16], bool transpose,
+                                        bool invert, bool wDivide)
+{
+	FrameKernel k;
+	k.mtx = Mat4f::fromArray(values);
+	k.wDivide = wDivide;
+
+	if (transpose)
+		k.mtx = c44::transpose(k.mtx);
+	if (invert && !c44::invert(k.mtx, k.mtx))
+		throw std::runtime_error("matrix is not invertible");
+	k.plan = planPlanar(k.mtx, wDivide);
+	return k;
+}
+
+
+void FrameKernel::apply(RawFrame& frame, int y0, int y1, SampleType outType) const
+{
+	// Rows are contiguous, so the whole band is one packed RGBA run.
+	if (y1 <= y0)
+		return;
+	const char* src = frame.row(y0);
+	char* dst = outType == frame.type ? frame.row(y0) : frame.spareRow(y0, outType);
+
+	const ConstStridedPoints in = frame.type == SampleType::Half
+		? packedPoints(reinterpret_cast<const uint16_t*>(src))
+		: packedPoints(reinterpret_cast<const float*>(src));
+	const StridedPoints out = outType == SampleType::Half
+		? packedPoints(reinterpret_cast<uint16_t*>(dst))
+		: packedPoints(reinterpret_cast<float*>(dst));
+
+	const size_t n = size_t(y1 - y0) * size_t(frame.width);
+	transformStrided(plan, in, out, n);
+}
+
+} // namespace c44
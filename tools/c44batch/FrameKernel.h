@@ -0,0 +1,34 @@
+// FrameKernel.h
+//
+// Applies a C44 matrix to the rows of a RawFrame with the same planar plan
+// C44Matrix::_validate builds for pixel_engine: tuned ISA and variant, and
+// sparse kernels where they apply. Interleaved RGBA rows are converted to
+// planar blocks on the way in and out (see transformStrided()).
+
+#pragma once
+
+#include "RawFrame.h"
+#include "core/C44Transform.h"
+
+namespace c44 {
+
+struct FrameKernel
+{
+	Mat4f      mtx      = Mat4f::identity();
+	bool       wDivide  = false;
+	PlanarPlan plan;
+
+	// Builds the effective matrix the way C44Matrix::_validate does: the
+	// 16 knob values, then transpose, then invert, and plans it once.
+	// Throws on a singular matrix when invert is requested.
+	static FrameKernel fromKnobValues(const float values[16], bool transpose,
+	                                  bool invert, bool wDivide);
+
+	// Transforms rows [y0, y1) of 'frame'. When 'outType' matches the frame
+	// this is in place, otherwise the rows go to frame.spareRow() and the
+	// caller reserves and swaps the spare buffer around the whole frame.
+	// Thread-safe for disjoint row ranges.
+	void apply(RawFrame& frame, int y0, int y1, SampleType outType) const;
+};
+
+} // namespace c44
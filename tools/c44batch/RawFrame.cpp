@@ -0,0 +1,84 @@
+// RawFrame.cpp
+
+#include "RawFrame.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <utility>
+
+namespace c44 {
+
+void RawFrame::Free::operator()(char* p) const
+{
+	std::free(p);
+}
+
+
+void RawFrame::grow(Buffer& buf, size_t& capacity, size_t need)
+{
+	if (need <= capacity)
+		return;
+
+	void* p = nullptr;
+	if (posix_memalign(&p, kIoAlignment, need) != 0)
+		throw std::bad_alloc();
+	buf.reset(static_cast<char*>(p));
+	capacity = need;
+}
+
+
+void RawFrame::allocate(int w, int h, SampleType t)
+{
+	width  = w;
+	height = h;
+	type   = t;
+	grow(_pixels, _capacity, paddedBytes());
+}
+
+
+void RawFrame::reserveSpare(SampleType t)
+{
+	grow(_spare, _spareCapacity, padded(size_t(width) * size_t(height) * 4 * sampleBytes(t)));
+}
+
+
+void RawFrame::swapSpare(SampleType t)
+{
+	std::swap(_pixels, _spare);
+	std::swap(_capacity, _spareCapacity);
+	type = t;
+}
+
+
+bool hasFramePattern(const std::string& pattern)
+{
+	return pattern.find('#') != std::string::npos ||
+	       pattern.find('%') != std::string::npos;
+}
+
+
+std::string expandFramePath(const std::string& pattern, int frame)
+{
+	const size_t hash = pattern.find('#');
+	if (hash != std::string::npos) {
+		size_t end = hash;
+		while (end < pattern.size() && pattern[end] == '#')
+			++end;
+
+		char digits[32];
+		std::snprintf(digits, sizeof(digits), "%0*d", int(end - hash), frame);
+		return pattern.substr(0, hash) + digits + pattern.substr(end);
+	}
+
+	const size_t pct = pattern.find('%');
+	if (pct != std::string::npos) {
+		char path[4096];
+		std::snprintf(path, sizeof(path), pattern.c_str(), frame);
+		return path;
+	}
+
+	return pattern;
+}
+
+} // namespace c44
@@ -0,0 +1,64 @@
+// RawFrame.h
+//
+// Frame buffers for the batch tools. Frames are stored as headerless,
+// row-major, interleaved RGBA files of float32 (width * height * 16 bytes)
+// or half (width * height * 8 bytes) samples, which is what our conversion
+// scripts dump out of Nuke/OIIO.
+
+#pragma once
+
+#include "core/C44Transform.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace c44 {
+
+// Buffers are aligned and padded to this so they can be used with O_DIRECT.
+static const size_t kIoAlignment = 4096;
+
+class RawFrame
+{
+	struct Free { void operator()(char* p) const; };
+	typedef std::unique_ptr<char, Free> Buffer;
+
+	Buffer _pixels;   // RGBA interleaved
+	Buffer _spare;    // same frame in another sample type, see spareRow()
+	size_t _capacity = 0, _spareCapacity = 0;
+
+	static void grow(Buffer& buf, size_t& capacity, size_t need);
+
+public:
+	int        width  = 0;
+	int        height = 0;
+	int        number = 0;   // frame number within the sequence
+	SampleType type   = SampleType::Float;
+
+	// (Re)allocates only when the frame grows; contents are undefined.
+	void allocate(int w, int h, SampleType t = SampleType::Float);
+
+	// Exact file size, and the size rounded up to kIoAlignment.
+	size_t pixelBytes() const { return 4 * sampleBytes(type); }
+	size_t bytes() const { return size_t(width) * size_t(height) * pixelBytes(); }
+	size_t paddedBytes() const { return padded(bytes()); }
+	static size_t padded(size_t n) { return (n + kIoAlignment - 1) & ~(kIoAlignment - 1); }
+
+	char*       data()             { return _pixels.get(); }
+	char*       row(int y)         { return _pixels.get() + size_t(y) * width * pixelBytes(); }
+	const char* row(int y) const   { return _pixels.get() + size_t(y) * width * pixelBytes(); }
+
+	// Conversions that change the sample type can't run in place: they write
+	// into a spare buffer, sized by reserveSpare(), which swapSpare() then
+	// makes the frame's pixels.
+	void  reserveSpare(SampleType t);
+	char* spareRow(int y, SampleType t) { return _spare.get() + size_t(y) * width * 4 * sampleBytes(t); }
+	void  swapSpare(SampleType t);
+};
+
+// Expands a "####" or printf-style "%04d" frame pattern. Paths without a
+// pattern are returned unchanged.
+std::string expandFramePath(const std::string& pattern, int frame);
+bool hasFramePattern(const std::string& pattern);
+
+} // namespace c44
@@ -0,0 +1,229 @@
+// SequencePipeline.cpp
+
+#include "SequencePipeline.h"
+
+#include "BoundedQueue.h"
+#include "RawFrame.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+// Shared state of one run: the frame pool, the queues between stages and
+// the first error. Frames are owned by 'storage'; the queues pass pointers.
+struct Pipeline
+{
+	std::vector<std::unique_ptr<RawFrame>> storage;
+	BoundedQueue<RawFrame*> freeFrames, readQueue, writeQueue;
+	std::atomic<int>        nextFrame;
+	std::atomic<unsigned>   readersLeft;
+	std::atomic<bool>       failed;
+	std::exception_ptr      error;
+	std::mutex              errorLock;
+	SequenceStats           stats;
+	std::mutex              statsLock;
+
+	Pipeline(size_t buffers, size_t depth) :
+		freeFrames(buffers), readQueue(depth), writeQueue(depth),
+		nextFrame(0), readersLeft(0), failed(false)
+	{}
+
+	void fail()
+	{
+		{
+			std::lock_guard<std::mutex> lk(errorLock);
+			if (!error)
+				error = std::current_exception();
+		}
+		failed = true;
+		freeFrames.close();
+		readQueue.close();
+		writeQueue.close();
+	}
+};
+
+
+// Keeps up to io->depth() reads in flight. Only blocks for a free buffer when
+// nothing is in flight, otherwise it collects a finished read first.
+void readerLoop(Pipeline& p, const SequenceOptions& opts)
+{
+	try {
+		std::unique_ptr<FrameIO> io = createFrameIO(opts.io);
+		bool more = true;
+
+		for (;;) {
+			while (more && !p.failed && io->inFlight() < io->depth()) {
+				RawFrame* buf = nullptr;
+				const bool got = io->inFlight() == 0 ? p.freeFrames.pop(buf)
+				                                     : p.freeFrames.tryPop(buf);
+				if (!got) {
+					more = io->inFlight() > 0;
+					break;
+				}
+
+				const int frame = p.nextFrame.fetch_add(1);
+				if (frame > opts.last) {
+					p.freeFrames.push(buf);
+					more = false;
+					break;
+				}
+				// A frame may come back from the writer in the output type.
+				buf->allocate(opts.width, opts.height, opts.inType);
+				buf->number = frame;
+				io->startRead(expandFramePath(opts.inPattern, frame), buf);
+			}
+
+			if (io->inFlight() == 0)
+				break;
+
+			RawFrame* done = io->waitAny();
+			{
+				std::lock_guard<std::mutex> lk(p.statsLock);
+				p.stats.bytesRead += done->bytes();
+				p.stats.backend = io->name();
+			}
+			if (!p.readQueue.push(done))
+				break;
+		}
+	}
+	catch (...) {
+		p.fail();
+	}
+
+	if (p.readersLeft.fetch_sub(1) == 1)
+		p.readQueue.close();
+}
+
+
+void transformLoop(Pipeline& p, const SequenceOptions& opts,
+                   const FrameKernel& kernel, ThreadPool& pool)
+{
+	try {
+		RawFrame* buf = nullptr;
+		while (p.readQueue.pop(buf)) {
+			RawFrame& frame = *buf;
+			const bool convert = opts.outType != frame.type;
+			if (convert)
+				frame.reserveSpare(opts.outType);
+			pool.parallelFor(0, size_t(frame.height), size_t(opts.rowGrain),
+			                 [&](size_t y0, size_t y1) {
+				kernel.apply(frame, int(y0), int(y1), opts.outType);
+			});
+			if (convert)
+				frame.swapSpare(opts.outType);
+			if (!p.writeQueue.push(buf))
+				break;
+		}
+	}
+	catch (...) {
+		p.fail();
+	}
+	p.writeQueue.close();
+}
+
+
+// Once another stage has failed, starts no new writes, so a failed run
+// leaves no frames behind that were written after the failure; writes
+// already in flight are finished before the buffers are let go.
+void writerLoop(Pipeline& p, const SequenceOptions& opts)
+{
+	try {
+		std::unique_ptr<FrameIO> io = createFrameIO(opts.io);
+
+		for (;;) {
+			while (!p.failed && io->inFlight() < io->depth()) {
+				RawFrame* buf = nullptr;
+				const bool got = io->inFlight() == 0 ? p.writeQueue.pop(buf)
+				                                     : p.writeQueue.tryPop(buf);
+				if (!got)
+					break;
+				io->startWrite(expandFramePath(opts.outPattern, buf->number), buf);
+			}
+
+			// Nothing in flight after a blocking pop: the queue is closed, or
+			// the run failed.
+			if (io->inFlight() == 0)
+				break;
+
+			RawFrame* done = io->waitAny();
+			{
+				std::lock_guard<std::mutex> lk(p.statsLock);
+				p.stats.bytesWritten += done->bytes();
+				++p.stats.frames;
+			}
+			if (opts.verbose)
+				std::fprintf(stderr, "c44batch: wrote %s\n",
+				             expandFramePath(opts.outPattern, done->number).c_str());
+			// Closed after a failure; keep collecting the writes in flight.
+			p.freeFrames.push(done);
+		}
+	}
+	catch (...) {
+		p.fail();
+	}
+}
+
+} // namespace
+
+
+SequenceStats runSequence(const SequenceOptions& opts, const FrameKernel& kernel)
+{
+	if (opts.width <= 0 || opts.height <= 0)
+		throw std::runtime_error("frame size must be given for raw frames");
+	if (opts.last < opts.first)
+		throw std::runtime_error("empty frame range");
+
+	const unsigned ioThreads = std::max(1u, opts.ioThreads);
+	const size_t depth = std::max<size_t>(1, opts.queueDepth);
+	const size_t ioDepth = std::max(1u, opts.io.depth);
+
+	// Enough buffers for every stage to have work in flight: what each reader
+	// and writer may have open, one in the transform, plus the queues.
+	const size_t frames = size_t(opts.last - opts.first) + 1;
+	const size_t buffers = std::min(frames, 2 * depth + 2 * ioThreads * ioDepth + 1);
+
+	Pipeline p(buffers, depth);
+	p.nextFrame = opts.first;
+	p.readersLeft = ioThreads;
+
+	for (size_t i = 0; i < buffers; ++i) {
+		p.storage.emplace_back(new RawFrame);
+		p.storage.back()->allocate(opts.width, opts.height, opts.inType);
+		p.freeFrames.push(p.storage.back().get());
+	}
+
+	ThreadPool pool(opts.threads);
+	const auto start = std::chrono::steady_clock::now();
+
+	std::vector<std::thread> threads;
+	for (unsigned i = 0; i < ioThreads; ++i)
+		threads.emplace_back(readerLoop, std::ref(p), std::cref(opts));
+	for (unsigned i = 0; i < ioThreads; ++i)
+		threads.emplace_back(writerLoop, std::ref(p), std::cref(opts));
+	threads.emplace_back(transformLoop, std::ref(p), std::cref(opts),
+	                     std::cref(kernel), std::ref(pool));
+
+	for (std::thread& t : threads)
+		t.join();
+
+	if (p.error)
+		std::rethrow_exception(p.error);
+
+	p.stats.seconds = std::chrono::duration<double>(
+		std::chrono::steady_clock::now() - start).count();
+	return p.stats;
+}
+
+} // namespace c44
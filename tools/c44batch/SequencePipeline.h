@@ -0,0 +1,52 @@
+// SequencePipeline.h
+//
+// Multi-frame sequence processing. Frames flow through three stages:
+//
+//   reader threads -> [read queue] -> transform -> [write queue] -> writer threads
+//
+// The transform stage splits each frame into row bands on a work-stealing
+// ThreadPool. Each reader and writer thread drives its own FrameIO, which
+// may keep several frames in flight (io_uring). A fixed pool of aligned frame
+// buffers circulates through the stages, so memory stays bounded and a slow
+// stage back-pressures the others instead of buffering the whole sequence.
+
+#pragma once
+
+#include "FrameIO.h"
+#include "FrameKernel.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace c44 {
+
+struct SequenceOptions
+{
+	std::string inPattern, outPattern;
+	int         first = 1, last = 1;
+	int         width = 0, height = 0;
+	SampleType  inType  = SampleType::Float;
+	SampleType  outType = SampleType::Float;
+	unsigned    threads    = 0;  // transform workers, 0 = all cores
+	unsigned    ioThreads  = 2;  // readers and writers, each
+	IoOptions   io;
+	size_t      queueDepth = 4;  // frames buffered between stages
+	int         rowGrain   = 16; // rows per transform task
+	bool        verbose    = false;
+};
+
+struct SequenceStats
+{
+	int      frames       = 0;
+	uint64_t bytesRead    = 0;
+	uint64_t bytesWritten = 0;
+	double   seconds      = 0.0;
+	const char* backend   = "";
+};
+
+// Runs the whole sequence. Throws std::runtime_error with the first stage
+// error; the other stages are shut down before it propagates.
+SequenceStats runSequence(const SequenceOptions& opts, const FrameKernel& kernel);
+
+} // namespace c44
@@ -0,0 +1,145 @@
+// ThreadPool.cpp
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace c44 {
+
+ThreadPool::ThreadPool(unsigned threads) :
+	_pending(0),
+	_nextQueue(0),
+	_stop(false)
+{
+	if (threads == 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (unsigned i = 0; i < threads; ++i)
+		_workers.emplace_back(new Worker);
+	for (unsigned i = 0; i < threads; ++i)
+		_threads.emplace_back(&ThreadPool::_workerLoop, this, size_t(i));
+}
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lk(_sleepLock);
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (std::thread& t : _threads)
+		t.join();
+}
+
+
+// Pops from the back of the preferred deque, otherwise steals from the front
+// of the next non-empty one. Returns false if there was nothing to run.
+bool ThreadPool::_runOne(size_t preferred)
+{
+	std::function<void()> task;
+	const size_t n = _workers.size();
+
+	for (size_t k = 0; k < n && !task; ++k) {
+		Worker& w = *_workers[(preferred + k) % n];
+		std::lock_guard<std::mutex> lk(w.lock);
+		if (w.tasks.empty())
+			continue;
+		if (k == 0) {
+			task = std::move(w.tasks.back());
+			w.tasks.pop_back();
+		}
+		else {
+			task = std::move(w.tasks.front());
+			w.tasks.pop_front();
+		}
+	}
+
+	if (!task)
+		return false;
+
+	_pending.fetch_sub(1, std::memory_order_relaxed);
+	task();
+	return true;
+}
+
+
+void ThreadPool::_workerLoop(size_t index)
+{
+	for (;;) {
+		if (_runOne(index))
+			continue;
+
+		std::unique_lock<std::mutex> lk(_sleepLock);
+		_wake.wait(lk, [this] { return _stop || _pending.load() > 0; });
+		if (_stop && _pending.load() == 0)
+			return;
+	}
+}
+
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& fn)
+{
+	if (begin >= end)
+		return;
+	grain = std::max<size_t>(grain, 1);
+
+	struct Group
+	{
+		std::atomic<size_t>     remaining;
+		std::mutex              lock;
+		std::condition_variable done;
+		std::exception_ptr      error;
+	};
+
+	const size_t chunks = (end - begin + grain - 1) / grain;
+	auto group = std::make_shared<Group>();
+	group->remaining = chunks;
+
+	// Deal the chunks out round-robin so every worker starts with local work.
+	const size_t n = _workers.size();
+	size_t queue = _nextQueue.fetch_add(1, std::memory_order_relaxed);
+	for (size_t c = 0; c < chunks; ++c, ++queue) {
+		const size_t b = begin + c * grain;
+		const size_t e = std::min(end, b + grain);
+		Worker& w = *_workers[queue % n];
+
+		// Counted before it is queued, so that a worker that runs it at once
+		// never takes _pending below the number of queued tasks.
+		_pending.fetch_add(1, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lk(w.lock);
+		w.tasks.emplace_back([group, &fn, b, e] {
+			try {
+				fn(b, e);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> glk(group->lock);
+				if (!group->error)
+					group->error = std::current_exception();
+			}
+			if (group->remaining.fetch_sub(1) == 1) {
+				std::lock_guard<std::mutex> glk(group->lock);
+				group->done.notify_all();
+			}
+		});
+	}
+	{
+		std::lock_guard<std::mutex> lk(_sleepLock);
+	}
+	_wake.notify_all();
+
+	// Help out instead of blocking; only sleep once the queues are empty.
+	while (group->remaining.load() > 0) {
+		if (_runOne(queue % n))
+			continue;
+		std::unique_lock<std::mutex> lk(group->lock);
+		group->done.wait(lk, [&] { return group->remaining.load() == 0; });
+	}
+
+	if (group->error)
+		std::rethrow_exception(group->error);
+}
+
+} // namespace c44
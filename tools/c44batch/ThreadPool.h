@@ -0,0 +1,56 @@
+// ThreadPool.h
+//
+// Small work-stealing thread pool. Each worker owns a deque; it pops its own
+// work from the back and steals from the front of the others when idle.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace c44 {
+
+class ThreadPool
+{
+	struct Worker
+	{
+		std::mutex                        lock;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::vector<std::thread>             _threads;
+	std::mutex                           _sleepLock;
+	std::condition_variable              _wake;
+	std::atomic<size_t>                  _pending;
+	std::atomic<size_t>                  _nextQueue;
+	bool                                 _stop;
+
+	void _workerLoop(size_t index);
+	bool _runOne(size_t preferred);
+
+public:
+	// threads == 0 uses std::thread::hardware_concurrency().
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	size_t size() const { return _workers.size(); }
+
+	// Runs fn(chunkBegin, chunkEnd) over [begin, end) in chunks of 'grain'.
+	// The calling thread executes tasks too until every chunk has finished.
+	// The first exception thrown by a chunk is rethrown here.
+	void parallelFor(size_t begin, size_t end, size_t grain,
+	                 const std::function<void(size_t, size_t)>& fn);
+};
+
+} // namespace c44
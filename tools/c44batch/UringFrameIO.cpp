@@ -0,0 +1,422 @@
+// UringFrameIO.cpp
+//
+// io_uring backend, talking to the kernel directly through the raw syscalls
+// so there is no liburing dependency. Every frame is cut into chunkBytes
+// requests; up to depth() frames are open at once and the ring is kept as
+// full as the chunk slots allow.
+
+#include "FrameIO.h"
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+
+#include <linux/io_uring.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+namespace c44 {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Minimal ring wrapper
+// ---------------------------------------------------------------------------
+
+class Ring
+{
+	int           _fd = -1;
+	void*         _sqMap = MAP_FAILED;
+	void*         _cqMap = MAP_FAILED;
+	size_t        _sqMapSize = 0, _cqMapSize = 0;
+	io_uring_sqe* _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+	size_t        _sqesSize = 0;
+
+	unsigned *_sqHead, *_sqTail, *_sqMask, *_sqArray;
+	unsigned *_cqHead, *_cqTail, *_cqMask;
+	io_uring_cqe* _cqes;
+	unsigned      _entries = 0;
+	unsigned      _toSubmit = 0;
+
+public:
+	explicit Ring(unsigned entries)
+	{
+		io_uring_params p;
+		std::memset(&p, 0, sizeof(p));
+		_fd = int(::syscall(__NR_io_uring_setup, entries, &p));
+		if (_fd < 0)
+			return;
+
+		_sqMapSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		_cqMapSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+		const bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single)
+			_sqMapSize = _cqMapSize = std::max(_sqMapSize, _cqMapSize);
+
+		_sqMap = ::mmap(nullptr, _sqMapSize, PROT_READ | PROT_WRITE,
+		                MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+		if (_sqMap == MAP_FAILED) {
+			close();
+			return;
+		}
+		_cqMap = single ? _sqMap
+		                : ::mmap(nullptr, _cqMapSize, PROT_READ | PROT_WRITE,
+		                         MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+		if (_cqMap == MAP_FAILED) {
+			close();
+			return;
+		}
+
+		_sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+		_sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE,
+		                                          MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQES));
+		if (_sqes == MAP_FAILED) {
+			close();
+			return;
+		}
+
+		char* sq = static_cast<char*>(_sqMap);
+		char* cq = static_cast<char*>(_cqMap);
+		_sqHead  = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+		_sqTail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+		_sqMask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+		_sqArray = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+		_cqHead  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+		_cqTail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+		_cqMask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+		_cqes    = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+		_entries = p.sq_entries;
+	}
+
+	~Ring() { close(); }
+
+	void close()
+	{
+		if (_sqes != MAP_FAILED)
+			::munmap(_sqes, _sqesSize);
+		if (_cqMap != MAP_FAILED && _cqMap != _sqMap)
+			::munmap(_cqMap, _cqMapSize);
+		if (_sqMap != MAP_FAILED)
+			::munmap(_sqMap, _sqMapSize);
+		if (_fd >= 0)
+			::close(_fd);
+		_sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		_sqMap = _cqMap = MAP_FAILED;
+		_fd = -1;
+	}
+
+	bool ok() const { return _fd >= 0; }
+	unsigned entries() const { return _entries; }
+
+	// Returns a zeroed SQE to fill in, or nullptr if the ring is full.
+	io_uring_sqe* nextSqe()
+	{
+		const unsigned head = __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+		const unsigned tail = *_sqTail + _toSubmit;
+		if (tail - head >= _entries)
+			return nullptr;
+		const unsigned idx = tail & *_sqMask;
+		_sqArray[idx] = idx;
+		++_toSubmit;
+		io_uring_sqe* sqe = &_sqes[idx];
+		std::memset(sqe, 0, sizeof(*sqe));
+		return sqe;
+	}
+
+	// Publishes the queued SQEs and waits for at least 'waitNr' completions.
+	void submitAndWait(unsigned waitNr)
+	{
+		__atomic_store_n(_sqTail, *_sqTail + _toSubmit, __ATOMIC_RELEASE);
+		_toSubmit = 0;
+
+		for (;;) {
+			// Whatever the kernel has not consumed yet, including leftovers
+			// from an interrupted call.
+			const unsigned pending = *_sqTail - __atomic_load_n(_sqHead, __ATOMIC_ACQUIRE);
+			const int r = int(::syscall(__NR_io_uring_enter, _fd, pending, waitNr,
+			                            waitNr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+			if (r >= 0)
+				return;
+			if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+				throw std::runtime_error(std::string("io_uring_enter: ") + std::strerror(errno));
+		}
+	}
+
+	bool popCqe(io_uring_cqe& out)
+	{
+		const unsigned head = *_cqHead;
+		if (head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+			return false;
+		out = _cqes[head & *_cqMask];
+		__atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+};
+
+
+// ---------------------------------------------------------------------------
+// Backend
+// ---------------------------------------------------------------------------
+
+class UringFrameIO : public FrameIO
+{
+	struct Transfer
+	{
+		RawFrame*   frame = nullptr;
+		std::string path;
+		int         fd = -1;
+		bool        write = false, direct = false;
+		size_t      nextOffset = 0;   // first byte not yet requested
+		size_t      completed = 0;    // bytes confirmed by the kernel
+		unsigned    outstanding = 0;  // chunks in the ring
+		int         error = 0;
+		bool        active = false;
+	};
+
+	struct Chunk
+	{
+		unsigned transfer;
+		size_t   offset;
+		size_t   length;
+		iovec    iov;
+	};
+
+	IoOptions             _opts;
+	Ring                  _ring;
+	std::vector<Transfer> _transfers;
+	std::vector<Chunk>    _chunks;
+	std::vector<unsigned> _freeChunks;
+	std::deque<unsigned>  _retries;    // chunks to resubmit after a short transfer
+	std::deque<unsigned>  _finished;   // transfers ready to hand back
+	unsigned              _active = 0;
+
+	void _start(const std::string& path, RawFrame* frame, bool write)
+	{
+		unsigned slot = 0;
+		while (slot < _transfers.size() && _transfers[slot].active)
+			++slot;
+		if (slot == _transfers.size())
+			throw std::logic_error("more transfers started than depth()");
+
+		Transfer& t = _transfers[slot];
+		t = Transfer();
+		t.direct = _opts.direct;
+		t.fd = openFrameFile(path, *frame, write, t.direct);
+		t.frame = frame;
+		t.path = path;
+		t.write = write;
+		t.active = true;
+		++_active;
+		if (frame->bytes() == 0)
+			_finished.push_back(slot);
+	}
+
+	void _queue(io_uring_sqe* sqe, unsigned c)
+	{
+		Chunk& ch = _chunks[c];
+		Transfer& t = _transfers[ch.transfer];
+		ch.iov.iov_base = t.frame->data() + ch.offset;
+		ch.iov.iov_len  = ioRequestLength(*t.frame, ch.offset, ch.length, t.direct);
+		sqe->opcode    = t.write ? IORING_OP_WRITEV : IORING_OP_READV;
+		sqe->fd        = t.fd;
+		sqe->off       = ch.offset;
+		sqe->addr      = reinterpret_cast<unsigned long long>(&ch.iov);
+		sqe->len       = 1;
+		sqe->user_data = c;
+	}
+
+	// Fills the ring: retries first, then new chunks round-robin over the
+	// open transfers so they progress together.
+	void _fill()
+	{
+		while (!_retries.empty()) {
+			io_uring_sqe* sqe = _ring.nextSqe();
+			if (!sqe)
+				return;
+			_queue(sqe, _retries.front());
+			_retries.pop_front();
+		}
+
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (unsigned i = 0; i < _transfers.size(); ++i) {
+				Transfer& t = _transfers[i];
+				if (!t.active || t.error || t.nextOffset >= t.frame->bytes())
+					continue;
+				if (_freeChunks.empty())
+					return;
+				io_uring_sqe* sqe = _ring.nextSqe();
+				if (!sqe)
+					return;
+
+				const unsigned c = _freeChunks.back();
+				_freeChunks.pop_back();
+				Chunk& ch = _chunks[c];
+				ch.transfer = i;
+				ch.offset = t.nextOffset;
+				ch.length = std::min(_opts.chunkBytes, t.frame->bytes() - t.nextOffset);
+				t.nextOffset += ch.length;
+				++t.outstanding;
+				_queue(sqe, c);
+				progress = true;
+			}
+		}
+	}
+
+	void _complete(const io_uring_cqe& cqe)
+	{
+		const unsigned c = unsigned(cqe.user_data);
+		Chunk& ch = _chunks[c];
+		Transfer& t = _transfers[ch.transfer];
+
+		if (cqe.res < 0)
+			t.error = -cqe.res;
+		else if (cqe.res == 0 && ch.length > 0)
+			t.error = EIO;
+		else if (size_t(cqe.res) < ch.length && !t.error) {
+			// Short transfer: resubmit the remainder; the chunk stays
+			// outstanding so the frame cannot finish early.
+			ch.offset += size_t(cqe.res);
+			ch.length -= size_t(cqe.res);
+			t.completed += size_t(cqe.res);
+			_retries.push_back(c);
+			return;
+		}
+		else
+			t.completed += ch.length;
+
+		--t.outstanding;
+		_freeChunks.push_back(c);
+		if (t.outstanding == 0 && (t.error || t.completed >= t.frame->bytes()))
+			_finished.push_back(ch.transfer);
+	}
+
+public:
+	explicit UringFrameIO(const IoOptions& opts) :
+		_opts(opts),
+		_ring(std::max(8u, std::min(256u, opts.depth * 16)))
+	{
+		_opts.depth = std::max(1u, opts.depth);
+		// O_DIRECT needs every chunk boundary aligned.
+		_opts.chunkBytes = std::max(kIoAlignment,
+		                            (opts.chunkBytes + kIoAlignment - 1) & ~(kIoAlignment - 1));
+		_transfers.resize(_opts.depth);
+		_chunks.resize(_ring.entries());
+		for (unsigned i = 0; i < _ring.entries(); ++i)
+			_freeChunks.push_back(_ring.entries() - 1 - i);
+	}
+
+	~UringFrameIO() override
+	{
+		// Never leave the kernel writing into buffers we no longer own.
+		try {
+			while (_freeChunks.size() + _retries.size() < _chunks.size()) {
+				_ring.submitAndWait(1);
+				io_uring_cqe cqe;
+				while (_ring.popCqe(cqe))
+					_freeChunks.push_back(unsigned(cqe.user_data));
+			}
+		}
+		catch (...) {
+		}
+		for (Transfer& t : _transfers)
+			if (t.active && t.fd >= 0)
+				::close(t.fd);
+	}
+
+	bool ok() const { return _ring.ok(); }
+
+	const char* name() const override { return "uring"; }
+	unsigned depth() const override { return _opts.depth; }
+	unsigned inFlight() const override { return _active; }
+
+	void startRead(const std::string& path, RawFrame* frame) override
+	{
+		_start(path, frame, false);
+	}
+
+	void startWrite(const std::string& path, RawFrame* frame) override
+	{
+		_start(path, frame, true);
+	}
+
+	RawFrame* waitAny() override
+	{
+		if (_active == 0)
+			throw std::logic_error("waitAny() with nothing in flight");
+
+		while (_finished.empty()) {
+			_fill();
+			_ring.submitAndWait(1);
+			io_uring_cqe cqe;
+			while (_ring.popCqe(cqe))
+				_complete(cqe);
+		}
+		// Keep the ring busy while the caller deals with this frame.
+		_fill();
+		_ring.submitAndWait(0);
+
+		const unsigned slot = _finished.front();
+		_finished.pop_front();
+		Transfer& t = _transfers[slot];
+		t.active = false;
+		--_active;
+
+		const int fd = t.fd;
+		t.fd = -1;
+		if (t.error) {
+			::close(fd);
+			throw std::runtime_error(t.path + (t.write ? ": write failed: " : ": read failed: ") +
+			                         std::strerror(t.error));
+		}
+		finishFrameFile(fd, t.path, *t.frame, t.write, t.direct);
+		return t.frame;
+	}
+};
+
+} // namespace
+
+
+bool uringAvailable()
+{
+	static const bool available = Ring(4).ok();
+	return available;
+}
+
+
+std::unique_ptr<FrameIO> createUringFrameIO(const IoOptions& opts)
+{
+	std::unique_ptr<UringFrameIO> io(new UringFrameIO(opts));
+	if (!io->ok())
+		return nullptr;
+	return io;
+}
+
+} // namespace c44
+
+#else // no io_uring
+
+namespace c44 {
+
+bool uringAvailable()
+{
+	return false;
+}
+
+std::unique_ptr<FrameIO> createUringFrameIO(const IoOptions&)
+{
+	return nullptr;
+}
+
+} // namespace c44
+
+#endif
@@ -0,0 +1,641 @@
+// Accuracy.cpp
+//
+// c44bench accuracy: drives every kernel path (planar per ISA, fused and
+// reproducible, streaming, sparse, half and mixed sample types, packed and
+// gathered layouts, interleaved points in float and double) with random and
+// adversarial inputs and compares the results to a long double reference.
+//
+// The rounding error of a four-term dot product is bounded relative to the
+// sum of the absolute terms, not to the result, so cancellation can make
+// the plain ULP error of a correct kernel arbitrarily large. Each result is
+// therefore also scored in units of that bound:
+//
+//   unit = (ulp_A(Sx) + |x| ulp_A(Sw)) / |w| + ulp_A(x) + ulp_O(x)
+//
+// where Sx and Sw are the sums of absolute terms of the output and of w
+// (Sw = 0 and w = 1 without w_divide), A is the arithmetic precision and O
+// the output precision. A correct kernel stays within a few units; a wrong
+// coefficient, a dropped term or a bad conversion scores in the thousands.
+//
+// Results that overflow somewhere on the way are counted but not scored,
+// and so are w_divide results where cancellation leaves w within a few
+// rounding errors of zero: there the computed w may even be exactly zero,
+// and no bound holds.
+// Non-finite inputs only have to produce the same kind of result (NaN, +inf,
+// -inf or finite) as the reference, evaluated either with every term or
+// with the non-zero terms only, as the sparse and class kernels skip zero
+// coefficients. A separate check pins which of the two the sparse and the
+// dense kernels give.
+
+#include "Commands.h"
+
+#include "core/C44Half.h"
+#include "core/C44Transform.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+typedef long double Real;
+
+enum class Num { Half, Float, Double };
+
+const char* numName(Num t)
+{
+	switch (t) {
+	case Num::Half:   return "half";
+	case Num::Float:  return "float";
+	case Num::Double: return "double";
+	}
+	return "?";
+}
+
+double quantize(double v, Num t)
+{
+	switch (t) {
+	case Num::Half:   return halfToFloat(floatToHalf(float(v)));
+	case Num::Float:  return float(v);
+	case Num::Double: return v;
+	}
+	return v;
+}
+
+Real maxFinite(Num t)
+{
+	switch (t) {
+	case Num::Half:   return 65504.0L;
+	case Num::Float:  return FLT_MAX;
+	case Num::Double: return DBL_MAX;
+	}
+	return 0;
+}
+
+// Spacing of the representable values of t around v, denormal spacing
+// near zero.
+Real ulpOf(Real v, Num t)
+{
+	int digits = 24, minExp = FLT_MIN_EXP;
+	if (t == Num::Half) {
+		digits = 11;
+		minExp = -13;
+	}
+	else if (t == Num::Double) {
+		digits = DBL_MANT_DIG;
+		minExp = DBL_MIN_EXP;
+	}
+
+	int e = minExp;
+	if (v != 0)
+		std::frexp(v, &e);
+	return std::ldexp(Real(1), std::max(e, minExp) - digits);
+}
+
+enum class Kind { Finite, Nan, PosInf, NegInf };
+
+Kind kindOf(Real v)
+{
+	if (std::isnan(v))
+		return Kind::Nan;
+	if (std::isinf(v))
+		return v > 0 ? Kind::PosInf : Kind::NegInf;
+	return Kind::Finite;
+}
+
+
+// ---------------------------------------------------------------------------
+// Reference
+// ---------------------------------------------------------------------------
+
+struct Reference
+{
+	Real value[4];     // non-zero terms only
+	Real dense[4];     // every term, zero coefficients included
+	Real unit[4];
+	bool range[4];     // overflows, or w is lost to cancellation
+	bool special;      // some input is not finite
+};
+
+Reference reference(const double m[16], bool wDivide, const double in[4], Num arith, Num out)
+{
+	Reference r;
+	r.special = false;
+	for (int j = 0; j < 4; ++j)
+		r.special = r.special || !std::isfinite(in[j]);
+
+	const Real maxA = maxFinite(arith), maxO = maxFinite(out);
+	Real sum[4], abs[4];
+	bool over[4];
+	for (int c = 0; c < 4; ++c) {
+		sum[c] = abs[c] = r.dense[c] = 0;
+		over[c] = false;
+		for (int j = 0; j < 4; ++j) {
+			const Real t = Real(m[j * 4 + c]) * Real(in[j]);
+			r.dense[c] += t;
+			if (m[j * 4 + c] == 0.0)
+				continue;
+			sum[c] += t;
+			if (std::isfinite(t))
+				abs[c] += std::fabs(t);
+		}
+		over[c] = abs[c] > maxA;
+	}
+
+	const Real w = wDivide ? sum[3] : Real(1);
+	const Real wAbs = wDivide ? abs[3] : Real(0);
+	const Real wDense = wDivide ? r.dense[3] : Real(1);
+	// Below 64 units of w's error bound, 1/w is no longer near-linear in
+	// that error; a zero w has no reliable sign either.
+	const bool wOver = wDivide && (over[3] || std::fabs(w) < 1 / maxA ||
+	                               std::fabs(w) < 64 * ulpOf(wAbs, arith));
+
+	for (int c = 0; c < 4; ++c) {
+		r.value[c] = sum[c] / w;
+		r.dense[c] = r.dense[c] / wDense;
+		r.range[c] = over[c] || wOver || (std::isfinite(r.value[c]) && std::fabs(r.value[c]) > maxO);
+		r.unit[c] = (ulpOf(abs[c], arith) + std::fabs(r.value[c]) * (wDivide ? ulpOf(wAbs, arith) : 0))
+		              / std::fabs(w)
+		          + ulpOf(r.value[c], arith) + ulpOf(r.value[c], out);
+	}
+	return r;
+}
+
+
+// ---------------------------------------------------------------------------
+// Kernel paths
+// ---------------------------------------------------------------------------
+
+typedef std::vector<double> Plane;
+
+struct Mode
+{
+	std::string name;
+	Num in, out, arith;
+	double threshold;   // in error units
+	std::function<void(const Mat4f&, bool, const Plane*, Plane*)> run;
+};
+
+
+template <typename T> struct SampleOf;
+template <> struct SampleOf<float>    { static float    put(double v) { return float(v); }
+                                        static double   get(float v)  { return v; } };
+template <> struct SampleOf<uint16_t> { static uint16_t put(double v) { return floatToHalf(float(v)); }
+                                        static double   get(uint16_t v) { return halfToFloat(v); } };
+
+
+Mode planarMode(const KernelVariant& v)
+{
+	Mode mode;
+	mode.name = std::string("planar ") + isaName(v.isa) + (v.reproducible ? " repro" : "")
+	          + (v.streamWidth ? " stream" : "");
+	mode.in = mode.out = mode.arith = Num::Float;
+	mode.threshold = 4;
+	mode.run = [v](const Mat4f& m, bool wDivide, const Plane* in, Plane* out) {
+		const size_t n = in[0].size();
+		std::vector<float> src(4 * n), dst(4 * n);
+		for (int c = 0; c < 4; ++c)
+			for (size_t i = 0; i < n; ++i)
+				src[c * n + i] = float(in[c][i]);
+		const float* const s[4] = { &src[0], &src[n], &src[2 * n], &src[3 * n] };
+		float* const d[4] = { &dst[0], &dst[n], &dst[2 * n], &dst[3 * n] };
+		planPlanar(m, wDivide, v).run(15u, s, d, n);
+		for (int c = 0; c < 4; ++c)
+			out[c].assign(d[c], d[c] + n);
+	};
+	return mode;
+}
+
+
+// transformStrided with components of type InT / OutT, 'components' per
+// point interleaved (1 = planar, 4 = packed RGBA, more = a struct with
+// padding, which takes the gather path).
+template <typename InT, typename OutT>
+Mode stridedMode(const char* layout, int components)
+{
+	const Num inNum = sizeof(InT) == 2 ? Num::Half : Num::Float;
+	const Num outNum = sizeof(OutT) == 2 ? Num::Half : Num::Float;
+
+	Mode mode;
+	mode.name = std::string(layout) + " " + numName(inNum) + "->" + numName(outNum);
+	mode.in = inNum;
+	mode.out = outNum;
+	mode.arith = Num::Float;
+	mode.threshold = 4;
+	mode.run = [components](const Mat4f& m, bool wDivide, const Plane* in, Plane* out) {
+		const size_t n = in[0].size();
+		const size_t size = n * size_t(std::max(4, components));
+		std::vector<InT> src(size);
+		std::vector<OutT> dst(size);
+
+		ConstStridedPoints s;
+		StridedPoints d;
+		s.type = sizeof(InT) == 2 ? SampleType::Half : SampleType::Float;
+		d.type = sizeof(OutT) == 2 ? SampleType::Half : SampleType::Float;
+		for (int c = 0; c < 4; ++c) {
+			// Planar: plane c; interleaved: component c of each point.
+			const size_t first = components == 1 ? c * n : size_t(c);
+			const size_t step = components == 1 ? 1 : size_t(components);
+			s.ptr[c] = &src[first];
+			d.ptr[c] = &dst[first];
+			s.stride[c] = ptrdiff_t(step * sizeof(InT));
+			d.stride[c] = ptrdiff_t(step * sizeof(OutT));
+			for (size_t i = 0; i < n; ++i)
+				src[first + i * step] = SampleOf<InT>::put(in[c][i]);
+		}
+
+		transformStrided(m, wDivide, s, d, n);
+
+		for (int c = 0; c < 4; ++c) {
+			const size_t first = components == 1 ? c * n : size_t(c);
+			const size_t step = components == 1 ? 1 : size_t(components);
+			out[c].resize(n);
+			for (size_t i = 0; i < n; ++i)
+				out[c][i] = SampleOf<OutT>::get(dst[first + i * step]);
+		}
+	};
+	return mode;
+}
+
+
+// transformPoints on four-component points: float data with a float or
+// double matrix, or double data.
+template <typename S, typename M>
+Mode pointsMode(bool useClass)
+{
+	const bool dataDouble = sizeof(S) == 8, mathDouble = sizeof(M) == sizeof(Mat4d);
+
+	Mode mode;
+	mode.name = std::string("points ") + (dataDouble ? "double" : "float")
+	          + (mathDouble && !dataDouble ? " (double math)" : "") + (useClass ? "" : " general");
+	mode.in = mode.out = dataDouble ? Num::Double : Num::Float;
+	mode.arith = mathDouble ? Num::Double : Num::Float;
+	mode.threshold = (mathDouble && !dataDouble) ? 1 : 4;
+	mode.run = [useClass](const Mat4f& m, bool wDivide, const Plane* in, Plane* out) {
+		const size_t n = in[0].size();
+		std::vector<S> src(4 * n), dst(4 * n);
+		for (size_t i = 0; i < n; ++i)
+			for (int c = 0; c < 4; ++c)
+				src[i * 4 + c] = S(in[c][i]);
+
+		M mtx;
+		for (int i = 0; i < 16; ++i)
+			mtx.m[i] = m.m[i];
+		transformPoints(mtx, wDivide, useClass, src.data(), 4, dst.data(), 4, n, 4);
+
+		for (int c = 0; c < 4; ++c) {
+			out[c].resize(n);
+			for (size_t i = 0; i < n; ++i)
+				out[c][i] = double(dst[i * 4 + c]);
+		}
+	};
+	return mode;
+}
+
+
+std::vector<Mode> allModes()
+{
+	std::vector<Mode> modes;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 }) {
+		if (!isaSupported(isa))
+			continue;
+		for (int repro = 0; repro < 2; ++repro) {
+			for (size_t stream : { size_t(0), size_t(1) }) {
+				KernelVariant v;
+				v.isa = isa;
+				v.streamWidth = stream;
+				v.reproducible = repro != 0;
+				modes.push_back(planarMode(v));
+			}
+		}
+	}
+
+	modes.push_back(stridedMode<uint16_t, float>("planar", 1));
+	modes.push_back(stridedMode<float, uint16_t>("planar", 1));
+	modes.push_back(stridedMode<uint16_t, uint16_t>("planar", 1));
+	modes.push_back(stridedMode<float, float>("packed", 4));
+	modes.push_back(stridedMode<uint16_t, float>("packed", 4));
+	modes.push_back(stridedMode<float, uint16_t>("packed", 4));
+	modes.push_back(stridedMode<uint16_t, uint16_t>("packed", 4));
+	modes.push_back(stridedMode<float, float>("gather", 6));
+	modes.push_back(stridedMode<uint16_t, uint16_t>("gather", 6));
+
+	modes.push_back(pointsMode<float, Mat4f>(true));
+	modes.push_back(pointsMode<float, Mat4f>(false));
+	modes.push_back(pointsMode<float, Mat4d>(true));
+	modes.push_back(pointsMode<double, Mat4d>(true));
+	modes.push_back(pointsMode<double, Mat4d>(false));
+	return modes;
+}
+
+
+// ---------------------------------------------------------------------------
+// Inputs
+// ---------------------------------------------------------------------------
+
+struct TestMatrix
+{
+	const char* name;
+	Mat4f       m;
+};
+
+std::vector<TestMatrix> testMatrices(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> coeff(-2.0f, 2.0f);
+	std::uniform_real_distribution<float> exponent(-60.0f, 60.0f);
+	std::vector<TestMatrix> list;
+
+	list.push_back({ "identity", Mat4f::identity() });
+
+	Mat4f general;
+	for (int i = 0; i < 16; ++i)
+		general.m[i] = coeff(rng);
+	list.push_back({ "general", general });
+
+	Mat4f affine = general;
+	affine.m[3] = affine.m[7] = affine.m[11] = 0.0f;
+	affine.m[15] = 1.0f;
+	list.push_back({ "affine", affine });
+
+	// Channel swaps with scales and a sign flip, as the sparse kernels see them.
+	Mat4f swizzle;
+	for (int i = 0; i < 16; ++i)
+		swizzle.m[i] = 0.0f;
+	swizzle.m[1 * 4 + 0] = 1.0f;
+	swizzle.m[0 * 4 + 1] = -1.0f;
+	swizzle.m[2 * 4 + 2] = 0.3f;
+	swizzle.m[3 * 4 + 3] = 1.0f;
+	list.push_back({ "swizzle", swizzle });
+
+	// A camera projection (column-major): w = -z, so w_divide is the
+	// perspective divide.
+	Mat4f projection;
+	for (int i = 0; i < 16; ++i)
+		projection.m[i] = 0.0f;
+	projection.m[0]  = 1.8f;
+	projection.m[5]  = 2.4f;
+	projection.m[10] = -1.0002f;
+	projection.m[11] = -1.0f;
+	projection.m[14] = -0.20002f;
+	list.push_back({ "projection", projection });
+
+	Mat4f wide;
+	for (int i = 0; i < 16; ++i)
+		wide.m[i] = std::ldexp(coeff(rng), int(exponent(rng)));
+	list.push_back({ "wide range", wide });
+	return list;
+}
+
+
+// One point, from a mix of categories. With w_divide some points are
+// placed on the plane where w is (nearly) zero.
+void makePoint(std::mt19937& rng, const Mat4f& m, bool wDivide, double p[4])
+{
+	std::uniform_real_distribution<double> unit(-4.0, 4.0);
+	std::uniform_real_distribution<double> exponent(-40.0, 40.0);
+	std::uniform_int_distribution<int> pick(0, 99);
+	static const double specials[] = { std::numeric_limits<double>::quiet_NaN(),
+	                                   std::numeric_limits<double>::infinity(),
+	                                   -std::numeric_limits<double>::infinity() };
+	static const double exact[] = { 0.0, -0.0, 1.0, -1.0, 0.5, 2.0 };
+
+	const int category = pick(rng);
+	for (int c = 0; c < 4; ++c) {
+		double v = unit(rng);
+		if (category >= 40 && category < 60)
+			v = std::ldexp(v, int(exponent(rng)));
+		else if (category < 70)
+			v = (rng() & 1) ? v * 1e-39 : v;                  // float denormals
+		else if (category < 75)
+			v = (rng() & 1) ? v * 8e37 : v;                   // near FLT_MAX
+		else if (category < 80)
+			v = exact[rng() % 6];
+		else if (category < 85)
+			v = (c == int(rng() % 4)) ? specials[rng() % 3] : v;
+		// Extra mantissa bits, so double data isn't just float values.
+		p[c] = v * (1.0 + std::ldexp(double(rng() % 1024), -40));
+	}
+
+	if (wDivide && category >= 85 && m.m[15] != 0.0f) {
+		// w = m3 r + m7 g + m11 b + m15 a, close to zero.
+		const double rest = double(m.m[3]) * p[0] + double(m.m[7]) * p[1] + double(m.m[11]) * p[2];
+		p[3] = -rest / double(m.m[15]) * (1.0 + std::ldexp(unit(rng), -30));
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+// Scoring
+// ---------------------------------------------------------------------------
+
+struct Score
+{
+	long long checked = 0, range = 0, special = 0, specialBad = 0;
+	Real maxUlp = 0, maxUnits = 0;
+	std::string worst;
+
+	bool failed(double threshold) const { return specialBad > 0 || maxUnits > threshold; }
+};
+
+void scoreCase(const Mode& mode, const char* matrixName, const Mat4f& m, bool wDivide,
+               const Plane* in, const Plane* out, Score& score)
+{
+	double md[16];
+	for (int i = 0; i < 16; ++i)
+		md[i] = m.m[i];
+
+	const size_t n = in[0].size();
+	for (size_t i = 0; i < n; ++i) {
+		const double p[4] = { in[0][i], in[1][i], in[2][i], in[3][i] };
+		const Reference ref = reference(md, wDivide, p, mode.arith, mode.out);
+
+		for (int c = 0; c < 4; ++c) {
+			const Real got = out[c][i];
+			if (ref.range[c]) {
+				++score.range;
+				continue;
+			}
+			if (ref.special || !std::isfinite(ref.value[c])) {
+				++score.special;
+				const Kind k = kindOf(got);
+				if (k != kindOf(ref.value[c]) && k != kindOf(ref.dense[c]))
+					++score.specialBad;
+				continue;
+			}
+
+			++score.checked;
+			const Real err = std::fabs(got - ref.value[c]);
+			const Real units = std::isfinite(got) ? err / ref.unit[c] : Real(INFINITY);
+			const Real ulp = err / ulpOf(ref.value[c], mode.out);
+			score.maxUlp = std::max(score.maxUlp, std::isfinite(got) ? ulp : Real(INFINITY));
+			if (units > score.maxUnits) {
+				score.maxUnits = units;
+				char text[256];
+				std::snprintf(text, sizeof(text), "%s, w_divide=%d, in (%.9g %.9g %.9g %.9g), ch %d: %.9Lg, expected %.12Lg",
+				              matrixName, int(wDivide), p[0], p[1], p[2], p[3], c, got, ref.value[c]);
+				score.worst = text;
+			}
+		}
+	}
+}
+
+
+// Sparse plans skip zero coefficients, so 0 * inf and 0 * NaN never happen
+// and a non-finite input only reaches the outputs that use it; the dense
+// general kernels, like Matrix4::transform(), spread NaN to every output.
+// Pins both behaviours per ISA on a swizzle whose w also takes red, which
+// is of the general class but sparse: the sparse plan must give the kind of
+// result of the non-zero terms, the dense kernels of that plan the kind of
+// every term, and the two must differ. Returns the number of failures.
+int nonFiniteCheck(size_t& checks)
+{
+	Mat4f swizzle;
+	for (int i = 0; i < 16; ++i)
+		swizzle.m[i] = 0.0f;
+	swizzle.m[1 * 4 + 0] = 1.0f;
+	swizzle.m[0 * 4 + 1] = -1.0f;
+	swizzle.m[2 * 4 + 2] = 0.3f;
+	swizzle.m[0 * 4 + 3] = 0.5f;
+	swizzle.m[3 * 4 + 3] = 1.0f;
+
+	const double inf = std::numeric_limits<double>::infinity();
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	const double pixels[][4] = { { inf, 1, 2, 3 }, { nan, 1, 2, 3 }, { 1, -inf, 2, 3 },
+	                             { 1, 2, nan, 3 }, { 1, 2, 3, inf } };
+	const size_t n = sizeof(pixels) / sizeof(pixels[0]);
+
+	double md[16];
+	for (int i = 0; i < 16; ++i)
+		md[i] = swizzle.m[i];
+
+	int failures = 0;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 }) {
+		if (!isaSupported(isa))
+			continue;
+		KernelVariant v;
+		v.isa = isa;
+		PlanarPlan sparse = planPlanar(swizzle, false, v);
+		PlanarPlan dense = sparse;
+		dense.sparse = false;
+
+		std::vector<float> src(4 * n), dstSparse(4 * n), dstDense(4 * n);
+		for (size_t i = 0; i < n; ++i)
+			for (int c = 0; c < 4; ++c)
+				src[c * n + i] = float(pixels[i][c]);
+		const float* const in[4] = { &src[0], &src[n], &src[2 * n], &src[3 * n] };
+		float* const outSparse[4] = { &dstSparse[0], &dstSparse[n], &dstSparse[2 * n], &dstSparse[3 * n] };
+		float* const outDense[4] = { &dstDense[0], &dstDense[n], &dstDense[2 * n], &dstDense[3 * n] };
+		sparse.run(15u, in, outSparse, n);
+		dense.run(15u, in, outDense, n);
+
+		int bad = sparse.sparse && sparse.cls == MatrixClass::General ? 0 : 1, differ = 0;
+		for (size_t i = 0; i < n; ++i) {
+			const Reference ref = reference(md, false, pixels[i], Num::Float, Num::Float);
+			for (int c = 0; c < 4; ++c) {
+				const Kind ks = kindOf(outSparse[c][i]), kd = kindOf(outDense[c][i]);
+				bad += ks != kindOf(ref.value[c]) ? 1 : 0;
+				bad += kd != kindOf(ref.dense[c]) ? 1 : 0;
+				differ += ks != kd ? 1 : 0;
+			}
+		}
+		if (differ == 0)
+			++bad;
+		++checks;
+		failures += bad ? 1 : 0;
+		std::printf("%-28s %9zu  sparse keeps inf/NaN to its outputs, dense spreads NaN: %d differ  %s\n",
+		            (std::string("non-finite ") + isaName(isa)).c_str(), n, differ, bad ? "FAIL" : "ok");
+	}
+	return failures;
+}
+
+} // namespace
+
+
+int accuracyCommand(int argc, char** argv)
+{
+	int points = 4096;
+	unsigned seed = 1;
+	bool verbose = false;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--points" && i + 1 < argc)
+			points = std::max(1, parseInt(argv[++i], "--points"));
+		else if (arg == "--seed" && i + 1 < argc)
+			seed = unsigned(parseInt(argv[++i], "--seed"));
+		else if (arg == "--verbose")
+			verbose = true;
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	std::mt19937 rng(seed);
+	const std::vector<TestMatrix> matrices = testMatrices(rng);
+	const std::vector<Mode> modes = allModes();
+
+	// Same inputs for every mode, quantised to each mode's input type.
+	struct Case { size_t matrix; bool wDivide; Plane in[4]; };
+	std::vector<Case> cases;
+	for (size_t k = 0; k < matrices.size(); ++k) {
+		for (int wd = 0; wd < 2; ++wd) {
+			Case cs;
+			cs.matrix = k;
+			cs.wDivide = wd != 0;
+			for (int c = 0; c < 4; ++c)
+				cs.in[c].resize(size_t(points));
+			for (int i = 0; i < points; ++i) {
+				double p[4];
+				makePoint(rng, matrices[k].m, cs.wDivide, p);
+				for (int c = 0; c < 4; ++c)
+					cs.in[c][size_t(i)] = p[c];
+			}
+			cases.push_back(cs);
+		}
+	}
+
+	std::printf("%-28s %9s %7s %8s %12s %10s  %s\n",
+	            "mode", "checked", "skipped", "special", "max ULP", "max units", "");
+	int failures = 0;
+	for (const Mode& mode : modes) {
+		Score score;
+		for (const Case& cs : cases) {
+			Plane in[4], out[4];
+			for (int c = 0; c < 4; ++c) {
+				in[c].resize(cs.in[c].size());
+				for (size_t i = 0; i < in[c].size(); ++i)
+					in[c][i] = quantize(cs.in[c][i], mode.in);
+			}
+			mode.run(matrices[cs.matrix].m, cs.wDivide, in, out);
+			scoreCase(mode, matrices[cs.matrix].name, matrices[cs.matrix].m, cs.wDivide, in, out, score);
+		}
+
+		const bool failed = score.failed(mode.threshold);
+		failures += failed ? 1 : 0;
+		char special[32];
+		std::snprintf(special, sizeof(special), score.specialBad ? "%lld BAD" : "%lld",
+		              score.specialBad ? score.specialBad : score.special);
+		std::printf("%-28s %9lld %7lld %8s %12.4Lg %10.3Lg  %s\n", mode.name.c_str(), score.checked,
+		            score.range, special, score.maxUlp, score.maxUnits,
+		            failed ? "FAIL" : "ok");
+		if ((verbose || failed) && !score.worst.empty())
+			std::printf("    worst: %s\n", score.worst.c_str());
+	}
+
+	size_t checks = modes.size();
+	failures += nonFiniteCheck(checks);
+
+	std::printf("%d of %zu checks failed (threshold 4 units; 1 for double math to float)\n",
+	            failures, checks);
+	return failures ? 1 : 0;
+}
+
+} // namespace c44
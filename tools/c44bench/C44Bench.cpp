@@ -0,0 +1,411 @@
+// C44Bench.cpp
+//
+// c44bench: microbenchmarks for the C44 core kernels, and the generator for
+// the per-host kernel tuning table the plugin reads (see core/C44Tune.h).
+
+#include "Commands.h"
+
+#include "core/C44Transform.h"
+#include "core/C44Tune.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace c44;
+
+static const char* const USAGE =
+	"usage: c44bench <command> [options]\n"
+	"\n"
+	"Commands:\n"
+	"  autotune               time every kernel variant per matrix class and\n"
+	"                         write the winners to the tuning cache\n"
+	"    --width N            row width to measure at (default: 2048)\n"
+	"    --cache PATH         cache file (default: the per-host cache)\n"
+	"    --dry-run            print the table without writing it\n"
+	"  show                   print the cache path and the table in use\n"
+	"  stream                 compare regular and streaming stores over the\n"
+	"                         row widths the streaming threshold is tuned on\n"
+	"    --isa NAME           baseline, avx2 or avx512 (default: tuned)\n"
+	"  repro                  check that every reproducible kernel variant\n"
+	"                         matches the baseline bit for bit, whatever the\n"
+	"                         row split; exits 1 on any difference\n"
+	"    --fused              check the default (FMA) kernels instead, to see\n"
+	"                         how much they differ\n"
+	"    --trials N           random matrices per class (default: 20)\n"
+	"  accuracy               score every kernel path against a long double\n"
+	"                         reference; exits 1 if any is over its threshold\n"
+	"    --points N           points per matrix and w_divide setting (default: 4096)\n"
+	"    --seed N             random seed (default: 1)\n"
+	"    --verbose            print the worst case of every path\n"
+	"  channels               check the N x M channel-matrix kernels against a\n"
+	"                         scalar loop and the planar kernels, then time\n"
+	"                         them; exits 1 on a mismatch\n"
+	"    --width N            row width to time at (default: 2048)\n"
+	"    --trials N           random matrices per size (default: 10)\n"
+	"  fanout                 check the kernels applying several matrices to the\n"
+	"                         same rows against the planar kernels, then time\n"
+	"                         them against one pass per matrix; exits 1 on a\n"
+	"                         mismatch\n"
+	"    --width N            row width to time at (default: 2048)\n"
+	"    --trials N           random sets of matrices (default: 10)\n"
+	"  plugin                 run the C44Matrix node on the DDImage shim: check\n"
+	"                         its output against the kernels, then time validate\n"
+	"                         and per-row overhead; exits 1 on a mismatch\n"
+	"    --width N            row width (default: 64, 512, 2048 and 8192)\n"
+	"  synth                  time every kernel path on synthetic P, N and Z\n"
+	"                         passes and on noise, or write one pass to a file\n"
+	"    --size WxH           frame size (default: 1920x1080)\n"
+	"    --coverage F         fraction of pixels covered by objects (default: 0.6)\n"
+	"    --objects N          place exactly N objects instead\n"
+	"    --ground             add a ground plane\n"
+	"    --seed N             scene seed (default: 1)\n"
+	"    --pass P|N|Z         pass to write (default: P)\n"
+	"    --out PATH           write the pass as raw RGBA float, as c44batch reads\n"
+	"  threads                run the kernel over a synthetic frame in row bands\n"
+	"                         on 1..N threads, next to a STREAM copy/triad\n"
+	"                         roofline measured with the same threads\n"
+	"    --threads N          most threads (default: all cores)\n"
+	"    --size WxH           frame size (default: 1920x1080)\n"
+	"    --passes N           timed passes per measurement (default: 5)\n"
+	"    --w-divide           project with w_divide\n";
+
+
+int c44::parseInt(const char* text, const char* option)
+{
+	char* end = nullptr;
+	const long v = std::strtol(text, &end, 10);
+	if (end == text || *end != '\0')
+		throw std::runtime_error(std::string(option) + ": not a number: " + text);
+	return int(v);
+}
+
+
+static void printLine(const char* line)
+{
+	std::fprintf(stderr, "  %s\n", line);
+}
+
+
+static void printTable(const TuneTable& t)
+{
+	static const char* const classes[3] = { "identity", "affine", "general" };
+	std::printf("cpu:   %s\nwidth: %d\nstream from: %zu px\n", t.cpu.c_str(), t.width, t.streamWidth);
+	for (int c = 0; c < 3; ++c)
+		for (int wd = 0; wd < 2; ++wd)
+			std::printf("  %-8s w_divide=%d  ->  %s x%d\n", classes[c], wd,
+			            isaName(t.choice[c][wd].isa), t.choice[c][wd].unroll);
+}
+
+
+static int cmdAutotune(int argc, char** argv)
+{
+	int width = kDefaultTuneWidth;
+	std::string path = defaultTuneCachePath();
+	bool dryRun = false;
+
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		auto value = [&]() -> const char* {
+			if (i + 1 >= argc)
+				throw std::runtime_error(arg + " needs a value");
+			return argv[++i];
+		};
+
+		if (arg == "--width")
+			width = parseInt(value(), "--width");
+		else if (arg == "--cache")
+			path = value();
+		else if (arg == "--dry-run")
+			dryRun = true;
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	std::fprintf(stderr, "c44bench: timing kernel variants at width %d\n", width);
+	const TuneTable table = autotune(width, printLine);
+	printTable(table);
+
+	if (!dryRun) {
+		if (!saveTuneTable(path, table))
+			throw std::runtime_error("cannot write " + (path.empty() ? std::string("(no cache path)") : path));
+		std::printf("wrote %s\n", path.c_str());
+	}
+	return 0;
+}
+
+
+static int cmdShow()
+{
+	const std::string path = defaultTuneCachePath();
+	TuneTable cached;
+	const bool valid = !path.empty() && loadTuneTable(path, cached);
+	std::printf("cache: %s (%s)\n", path.empty() ? "(none)" : path.c_str(),
+	            valid ? "valid" : "missing or stale, using the static table until `c44bench autotune`");
+	printTable(activeTuneTable());
+	return 0;
+}
+
+
+static int cmdStream(int argc, char** argv)
+{
+	static const float general[16] = {  0.9f,  0.1f,  -0.2f,   0.01f,
+	                                    0.3f,  1.1f,   0.05f,  0.02f,
+	                                   -0.1f,  0.2f,   0.8f,   0.03f,
+	                                    0.5f, -0.25f,  0.125f, 1.0f };
+	const Mat4f m = Mat4f::fromArray(general);
+	KernelVariant variant = tunedVariant(MatrixClass::General, false);
+
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--isa" && i + 1 < argc) {
+			const std::string name = argv[++i];
+			bool found = false;
+			for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 }) {
+				if (name == isaName(isa)) {
+					variant.isa = isa;
+					found = true;
+				}
+			}
+			if (!found)
+				throw std::runtime_error("unknown ISA " + name);
+			if (!isaSupported(variant.isa))
+				throw std::runtime_error(name + " is not supported on this machine");
+		}
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	const size_t threshold = variant.streamWidth;
+	std::printf("%s x%d, general matrix, streaming from %zu px%s\n",
+	            isaName(variant.isa), variant.unroll, threshold, threshold ? "" : " (off)");
+	std::printf("%9s %9s %14s %14s %8s\n", "width", "row KiB", "regular ns/px", "stream ns/px", "speedup");
+	for (size_t width : streamSweepWidths()) {
+		variant.streamWidth = 0;
+		const double regular = measurePlanar(planPlanar(m, false, variant), width);
+		variant.streamWidth = 1;
+		const double stream = measurePlanar(planPlanar(m, false, variant), width);
+		std::printf("%9zu %9zu %14.3f %14.3f %7.2fx%s\n", width, width * 32 / 1024, regular, stream,
+		            regular / stream, threshold && width >= threshold ? "  *" : "");
+	}
+	return 0;
+}
+
+
+// ---------------------------------------------------------------------------
+// repro
+// ---------------------------------------------------------------------------
+
+// A random dense matrix of the given class, or a sparse one (a permutation
+// with some scales) when 'sparse' is set.
+static Mat4f randomMatrix(std::mt19937& rng, MatrixClass cls, bool sparse)
+{
+	std::uniform_real_distribution<float> coeff(-2.0f, 2.0f);
+	Mat4f m = Mat4f::identity();
+	if (cls == MatrixClass::Identity)
+		return m;
+
+	if (sparse) {
+		int perm[4] = { 0, 1, 2, 3 };
+		std::shuffle(perm, perm + 4, rng);
+		for (int c = 0; c < 4; ++c) {
+			for (int r = 0; r < 4; ++r)
+				m.m[c * 4 + r] = 0.0f;
+		}
+		for (int r = 0; r < 4; ++r)
+			m.m[perm[r] * 4 + r] = (rng() & 1) ? 1.0f : coeff(rng);
+	}
+	else {
+		for (int i = 0; i < 16; ++i)
+			m.m[i] = coeff(rng);
+	}
+	if (cls == MatrixClass::Affine) {
+		m.m[3] = m.m[7] = m.m[11] = 0.0f;
+		m.m[15] = 1.0f;
+	}
+	return m;
+}
+
+
+// Samples with long mantissas, where fused and unfused results part, plus a
+// few infinities, NaNs, zeros and denormals.
+static void fillSamples(std::mt19937& rng, std::vector<float>& v)
+{
+	std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+	static const float specials[] = { 0.0f, -0.0f, 1e-40f, -1e30f, 3.4e38f,
+	                                  std::numeric_limits<float>::infinity(),
+	                                  std::numeric_limits<float>::quiet_NaN() };
+	for (float& x : v)
+		x = (rng() % 64 == 0) ? specials[rng() % 7] : value(rng);
+}
+
+
+// Bitwise equality, except that any two NaNs match: the compiler may swap
+// the operands of an add or multiply, which picks the other input's NaN.
+static bool sameBits(const float* a, const float* b, size_t n)
+{
+	if (std::memcmp(a, b, n * sizeof(float)) == 0)
+		return true;
+	for (size_t i = 0; i < n; ++i) {
+		if (std::memcmp(&a[i], &b[i], sizeof(float)) != 0 && !(a[i] != a[i] && b[i] != b[i]))
+			return false;
+	}
+	return true;
+}
+
+
+static int cmdRepro(int argc, char** argv)
+{
+	bool reproducible = true;
+	int trials = 20;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--fused")
+			reproducible = false;
+		else if (arg == "--trials" && i + 1 < argc)
+			trials = parseInt(argv[++i], "--trials");
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	std::vector<KernelVariant> variants;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 }) {
+		if (!isaSupported(isa))
+			continue;
+		for (int unroll : { 1, 2, 4 }) {
+			for (size_t streamWidth : { size_t(0), size_t(1) }) {
+				KernelVariant v;
+				v.isa = isa;
+				v.unroll = unroll;
+				v.streamWidth = streamWidth;
+				v.reproducible = reproducible;
+				variants.push_back(v);
+			}
+		}
+	}
+
+	// Odd widths exercise the vector tails; every plane starts at its own
+	// offset so the streaming kernels peel different amounts or give up.
+	static const size_t widths[] = { 1, 3, 17, 64, 333, 4099 };
+	const size_t maxWidth = 4099 + 16;
+
+	std::mt19937 rng(44);
+	std::vector<float> src(4 * maxWidth), ref(4 * maxWidth), got(4 * maxWidth);
+	long long checks = 0, failures = 0;
+
+	for (int cls = 0; cls < 3; ++cls) {
+		for (int sparse = 0; sparse < 2; ++sparse) {
+			for (int trial = 0; trial < trials; ++trial) {
+				const Mat4f m = randomMatrix(rng, MatrixClass(cls), sparse != 0);
+				fillSamples(rng, src);
+				for (int wd = 0; wd < 2; ++wd) {
+					for (size_t n : widths) {
+						size_t offset[4];
+						for (int c = 0; c < 4; ++c)
+							offset[c] = rng() % 16;
+						const float* in[4];
+						float* refOut[4];
+						float* gotOut[4];
+						for (int c = 0; c < 4; ++c) {
+							in[c] = &src[c * maxWidth + offset[(c + 1) % 4]];
+							refOut[c] = &ref[c * maxWidth + offset[c]];
+							gotOut[c] = &got[c * maxWidth + offset[c]];
+						}
+
+						KernelVariant baseline;
+						baseline.reproducible = reproducible;
+						planPlanar(m, wd != 0, baseline).run(15u, in, refOut, n);
+
+						for (const KernelVariant& v : variants) {
+							const PlanarPlan plan = planPlanar(m, wd != 0, v);
+							for (unsigned mask = 1; mask < 16; ++mask) {
+								std::fill(got.begin(), got.end(), 0.0f);
+
+								// The row in up to three pieces, as threads
+								// splitting an image at arbitrary pixels would.
+								const size_t cut1 = rng() % (n + 1);
+								const size_t cut2 = cut1 + rng() % (n - cut1 + 1);
+								const size_t cuts[4] = { 0, cut1, cut2, n };
+								for (int p = 0; p < 3; ++p) {
+									const float* pin[4];
+									float* pout[4];
+									for (int c = 0; c < 4; ++c) {
+										pin[c] = in[c] + cuts[p];
+										pout[c] = (mask & (1u << c)) ? gotOut[c] + cuts[p] : nullptr;
+									}
+									plan.run(mask, pin, pout, cuts[p + 1] - cuts[p]);
+								}
+
+								for (int c = 0; c < 4; ++c) {
+									if (!(mask & (1u << c)))
+										continue;
+									++checks;
+									if (sameBits(refOut[c], gotOut[c], n))
+										continue;
+									if (++failures <= 10)
+										std::printf("differs: %s x%d%s, %s%s matrix, w_divide=%d, width %zu, mask %u, channel %d\n",
+										            isaName(v.isa), v.unroll, v.streamWidth ? " streaming" : "",
+										            sparse ? "sparse " : "", matrixClassName(MatrixClass(cls)),
+										            wd, n, mask, c);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::printf("%s kernels: %zu variants, %lld channel rows compared, %lld differ from baseline\n",
+	            reproducible ? "reproducible" : "fused", variants.size(), checks, failures);
+	return failures == 0 || !reproducible ? 0 : 1;
+}
+
+
+int main(int argc, char** argv)
+{
+	try {
+		if (argc < 2) {
+			std::fputs(USAGE, stderr);
+			return 2;
+		}
+
+		const std::string cmd = argv[1];
+		if (cmd == "autotune")
+			return cmdAutotune(argc - 2, argv + 2);
+		if (cmd == "show")
+			return cmdShow();
+		if (cmd == "stream")
+			return cmdStream(argc - 2, argv + 2);
+		if (cmd == "repro")
+			return cmdRepro(argc - 2, argv + 2);
+		if (cmd == "accuracy")
+			return accuracyCommand(argc - 2, argv + 2);
+		if (cmd == "channels")
+			return channelsCommand(argc - 2, argv + 2);
+		if (cmd == "fanout")
+			return fanOutCommand(argc - 2, argv + 2);
+		if (cmd == "plugin")
+			return pluginCommand(argc - 2, argv + 2);
+		if (cmd == "synth")
+			return synthCommand(argc - 2, argv + 2);
+		if (cmd == "threads")
+			return threadsCommand(argc - 2, argv + 2);
+		if (cmd == "-h" || cmd == "--help") {
+			std::fputs(USAGE, stdout);
+			return 0;
+		}
+		throw std::runtime_error("unknown command " + cmd);
+	}
+	catch (const std::exception& e) {
+		std::fprintf(stderr, "c44bench: %s\n", e.what());
+		return 1;
+	}
+}
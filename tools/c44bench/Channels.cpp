@@ -0,0 +1,252 @@
+// Channels.cpp
+//
+// c44bench channels: the channel-matrix kernels (ChannelPlan in
+// core/C44Transform.h) at the sizes multi-channel work uses, 3x3 colour
+// matrices, 4x3 and 3x4 to and from RGBA, 6x6 and 8x8 spectral or AOV
+// recombinations, 8x3 down to RGB and an odd 5x7. Sizes are written
+// inputs x outputs. For each size it checks
+//
+//   - that every reproducible ISA gives the bits of a plain scalar loop
+//     summing in input order, however the row is split, and in place;
+//   - that the fused (FMA) kernels stay within the error bound of the
+//     sum, n * eps * sum |m x|, of a double reference;
+//   - that a 4x4 channel matrix gives the bits of the dense planar kernel
+//     of the same matrix on the same ISA;
+//
+// and then times the tuned plan against the scalar loop, whose channel
+// counts are only known at run time.
+
+#include "Commands.h"
+
+#include "core/C44Transform.h"
+#include "core/C44Tune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+struct Size
+{
+	int inputs, outputs;
+};
+
+const Size kSizes[] = { { 3, 3 }, { 3, 4 }, { 4, 3 }, { 4, 4 }, { 6, 6 }, { 8, 3 }, { 8, 8 }, { 5, 7 } };
+
+
+ChannelMatrix randomMatrix(std::mt19937& rng, Size size)
+{
+	std::uniform_real_distribution<float> coeff(-2.0f, 2.0f);
+	ChannelMatrix m;
+	m.inputs = size.inputs;
+	m.outputs = size.outputs;
+	for (int r = 0; r < size.outputs; ++r)
+		for (int c = 0; c < size.inputs; ++c)
+			m(r, c) = coeff(rng);
+	return m;
+}
+
+
+// The sum in input order, one pixel at a time, with the channel counts
+// read at run time.
+void scalarChannels(const ChannelMatrix& m, const float* const* in, float* const* out, size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		float x[kMaxChannels];
+		for (int c = 0; c < m.inputs; ++c)
+			x[c] = in[c][i];
+		for (int r = 0; r < m.outputs; ++r) {
+			float acc = m(r, 0) * x[0];
+			for (int c = 1; c < m.inputs; ++c)
+				acc = acc + m(r, c) * x[c];
+			out[r][i] = acc;
+		}
+	}
+}
+
+
+// Best-of-five time of 'body' in nanoseconds per call.
+double timeNs(const std::function<void()>& body)
+{
+	typedef std::chrono::steady_clock Clock;
+	int reps = 1;
+	for (;;) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		if (std::chrono::duration<double>(Clock::now() - t0).count() > 2e-3 || reps >= (1 << 22))
+			break;
+		reps *= 2;
+	}
+
+	double best = 1e30;
+	for (int sample = 0; sample < 5; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+	}
+	return best * 1e9 / double(reps);
+}
+
+
+// Planes of 'width' floats with room for an offset of up to 15, so that
+// they start at different alignments.
+struct Planes
+{
+	std::vector<float> data[kMaxChannels];
+	float*             p[kMaxChannels];
+
+	Planes(size_t width, std::mt19937* rng = nullptr)
+	{
+		for (int c = 0; c < kMaxChannels; ++c) {
+			data[c].assign(width + 16, 0.0f);
+			p[c] = data[c].data() + (rng ? (*rng)() % 16 : 0);
+		}
+	}
+};
+
+} // namespace
+
+
+int channelsCommand(int argc, char** argv)
+{
+	int width = 2048, trials = 10;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--width" && i + 1 < argc)
+			width = parseInt(argv[++i], "--width");
+		else if (arg == "--trials" && i + 1 < argc)
+			trials = parseInt(argv[++i], "--trials");
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+	if (width < 1)
+		throw std::runtime_error("--width must be positive");
+
+	std::vector<Isa> isas;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 })
+		if (isaSupported(isa))
+			isas.push_back(isa);
+
+	static const size_t widths[] = { 1, 3, 17, 64, 333, 4099 };
+	const size_t maxWidth = 4099;
+	std::mt19937 rng(44);
+	std::uniform_real_distribution<float> value(-4.0f, 4.0f);
+	long long checks = 0, failures = 0;
+	const auto fail = [&](const char* what, Size s, Isa isa, size_t n) {
+		if (++failures <= 10)
+			std::printf("%s: %dx%d, %s, width %zu\n", what, s.inputs, s.outputs, isaName(isa), n);
+	};
+
+	Planes src(maxWidth, &rng), ref(maxWidth, &rng), got(maxWidth, &rng);
+	for (const Size& s : kSizes) {
+		for (int trial = 0; trial < trials; ++trial) {
+			const ChannelMatrix m = randomMatrix(rng, s);
+			for (int c = 0; c < kMaxChannels; ++c)
+				for (size_t i = 0; i < maxWidth; ++i)
+					src.p[c][i] = value(rng);
+
+			for (size_t n : widths) {
+				scalarChannels(m, src.p, ref.p, n);
+
+				for (Isa isa : isas) {
+					// Reproducible, in up to three pieces.
+					const ChannelPlan exact = planChannels(m, true, isa);
+					const size_t cut1 = rng() % (n + 1);
+					const size_t cut2 = cut1 + rng() % (n - cut1 + 1);
+					const size_t cuts[4] = { 0, cut1, cut2, n };
+					for (int p = 0; p < 3; ++p) {
+						const float* pin[kMaxChannels];
+						float* pout[kMaxChannels];
+						for (int c = 0; c < kMaxChannels; ++c) {
+							pin[c] = src.p[c] + cuts[p];
+							pout[c] = got.p[c] + cuts[p];
+						}
+						exact.run(pin, pout, cuts[p + 1] - cuts[p]);
+					}
+					for (int r = 0; r < s.outputs; ++r, ++checks)
+						if (std::memcmp(ref.p[r], got.p[r], n * sizeof(float)) != 0)
+							fail("reproducible kernel differs from the scalar loop", s, isa, n);
+
+					// In place: outputs over the first inputs.
+					if (s.outputs <= s.inputs) {
+						Planes inplace(maxWidth);
+						for (int c = 0; c < s.inputs; ++c)
+							std::memcpy(inplace.p[c], src.p[c], n * sizeof(float));
+						exact.run(inplace.p, inplace.p, n);
+						for (int r = 0; r < s.outputs; ++r, ++checks)
+							if (std::memcmp(ref.p[r], inplace.p[r], n * sizeof(float)) != 0)
+								fail("in-place kernel differs from the scalar loop", s, isa, n);
+					}
+
+					// Fused, against the double sum.
+					planChannels(m, false, isa).run(src.p, got.p, n);
+					const double eps = std::numeric_limits<float>::epsilon();
+					for (int r = 0; r < s.outputs; ++r, ++checks)
+						for (size_t i = 0; i < n; ++i) {
+							double sum = 0.0, mag = 0.0;
+							for (int c = 0; c < s.inputs; ++c) {
+								sum += double(m(r, c)) * src.p[c][i];
+								mag += std::fabs(double(m(r, c)) * src.p[c][i]);
+							}
+							if (std::fabs(got.p[r][i] - sum) > s.inputs * eps * mag) {
+								fail("fused kernel is outside the error bound", s, isa, n);
+								break;
+							}
+						}
+
+					// A 4x4 against the dense planar kernel of the same matrix.
+					if (s.inputs == 4 && s.outputs == 4) {
+						Mat4f mat;
+						for (int r = 0; r < 4; ++r)
+							for (int c = 0; c < 4; ++c)
+								mat(r, c) = m(r, c);
+						for (bool reproducible : { false, true }) {
+							KernelVariant v;
+							v.isa = isa;
+							v.reproducible = reproducible;
+							planPlanar(mat, false, v).run(15u, src.p, ref.p, n);
+							planChannels(m, reproducible, isa).run(src.p, got.p, n);
+							for (int r = 0; r < 4; ++r, ++checks)
+								if (std::memcmp(ref.p[r], got.p[r], n * sizeof(float)) != 0)
+									fail("4x4 channel kernel differs from the planar kernel", s, isa, n);
+						}
+					}
+				}
+			}
+		}
+	}
+	std::printf("%lld channel rows compared, %lld wrong\n\n", checks, failures);
+
+	const size_t w = size_t(width);
+	Planes in(w), out(w);
+	for (int c = 0; c < kMaxChannels; ++c)
+		for (size_t i = 0; i < w; ++i)
+			in.p[c][i] = value(rng);
+
+	std::printf("width %d, tuned ISA %s\n", width, isaName(planChannels(ChannelMatrix::identity(4)).isa));
+	std::printf("%7s %14s %14s %8s\n", "size", "kernel ns/px", "scalar ns/px", "speedup");
+	for (const Size& s : kSizes) {
+		const ChannelMatrix m = randomMatrix(rng, s);
+		const ChannelPlan plan = planChannels(m);
+		const double kernelNs = timeNs([&] { plan.run(in.p, out.p, w); }) / double(w);
+		const double scalarNs = timeNs([&] { scalarChannels(m, in.p, out.p, w); }) / double(w);
+		std::printf("%4dx%-2d %14.3f %14.3f %7.2fx\n", s.inputs, s.outputs, kernelNs, scalarNs, scalarNs / kernelNs);
+	}
+
+	return failures ? 1 : 0;
+}
+
+} // namespace c44
@@ -0,0 +1,20 @@
+// Commands.h
+//
+// c44bench subcommands that live in their own files. Each takes the
+// arguments after the command name and returns the process exit status;
+// errors in the arguments are thrown as std::runtime_error.
+
+#pragma once
+
+namespace c44 {
+
+int parseInt(const char* text, const char* option);
+
+int accuracyCommand(int argc, char** argv);
+int channelsCommand(int argc, char** argv);
+int fanOutCommand(int argc, char** argv);
+int pluginCommand(int argc, char** argv);
+int synthCommand(int argc, char** argv);
+int threadsCommand(int argc, char** argv);
+
+} // namespace c44
@@ -0,0 +1,220 @@
+// FanOut.cpp
+//
+// c44bench fanout: the fan-out kernels (FanOutPlan in core/C44Transform.h),
+// which apply up to four 4x4 matrices to the same RGBA rows in one pass.
+// For every count of matrices and every set of w-divided ones it checks
+//
+//   - that each matrix's outputs have the bits of the dense planar kernel
+//     of that matrix with its w_divide, on every ISA, fused and
+//     reproducible, streaming or not, however the row is split;
+//   - that the first matrix may write over the input planes;
+//
+// and then times the tuned plan against the same matrices as separate
+// planar passes over the input, which is what one node per matrix costs.
+
+#include "Commands.h"
+
+#include "core/C44Transform.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+// A dense general matrix, with w kept well away from zero for inputs in
+// [-1, 1] and alpha in [1, 2].
+Mat4f randomMatrix(std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> coeff(-0.5f, 0.5f);
+	Mat4f m;
+	for (int i = 0; i < 16; ++i)
+		m.m[i] = coeff(rng);
+	m(3, 3) = 4.0f + coeff(rng);
+	return m;
+}
+
+
+// Best-of-five time of 'body' in nanoseconds per call.
+double timeNs(const std::function<void()>& body)
+{
+	typedef std::chrono::steady_clock Clock;
+	int reps = 1;
+	for (;;) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		if (std::chrono::duration<double>(Clock::now() - t0).count() > 2e-3 || reps >= (1 << 22))
+			break;
+		reps *= 2;
+	}
+
+	double best = 1e30;
+	for (int sample = 0; sample < 5; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		best = std::min(best, std::chrono::duration<double>(Clock::now() - t0).count());
+	}
+	return best * 1e9 / double(reps);
+}
+
+
+// 4 input planes and 4 output planes per matrix, of 'width' floats with
+// room for an offset of up to 15, so that they start at different
+// alignments; or, with 'shift', all 'shift' floats past a 64-byte boundary,
+// so that the streaming kernels can stream to them.
+struct Planes
+{
+	static const int kPlanes = 4 + 4 * kMaxFanOut;
+
+	std::vector<float> data[kPlanes];
+	float*             p[kPlanes];
+
+	Planes(size_t width, std::mt19937* rng = nullptr, int shift = -1)
+	{
+		for (int c = 0; c < kPlanes; ++c) {
+			data[c].assign(width + 32, 0.0f);
+			p[c] = data[c].data() + (rng ? (*rng)() % 16 : 0);
+			if (shift >= 0)
+				p[c] = data[c].data() + (16 - uintptr_t(data[c].data()) / sizeof(float) % 16) % 16 + shift;
+		}
+	}
+
+	float* const* in() const { return p; }
+	float* const* out(int k = 0) const { return p + 4 + 4 * k; }
+};
+
+} // namespace
+
+
+int fanOutCommand(int argc, char** argv)
+{
+	int width = 2048, trials = 10;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--width" && i + 1 < argc)
+			width = parseInt(argv[++i], "--width");
+		else if (arg == "--trials" && i + 1 < argc)
+			trials = parseInt(argv[++i], "--trials");
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+	if (width < 1)
+		throw std::runtime_error("--width must be positive");
+
+	std::vector<Isa> isas;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 })
+		if (isaSupported(isa))
+			isas.push_back(isa);
+
+	static const size_t widths[] = { 1, 3, 17, 64, 333, 4099 };
+	const size_t maxWidth = 4099;
+	std::mt19937 rng(44);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f), alpha(1.0f, 2.0f);
+	long long checks = 0, failures = 0;
+	const auto fail = [&](const char* what, int count, unsigned wDivide, const KernelVariant& v, size_t n) {
+		if (++failures <= 10)
+			std::printf("%s: %d matrices, w_divide bits %x, %s%s%s, width %zu\n", what, count, wDivide,
+			            isaName(v.isa), v.reproducible ? " reproducible" : "",
+			            v.streamWidth ? " streaming" : "", n);
+	};
+
+	Planes src(maxWidth, &rng), ref(maxWidth, &rng), got(maxWidth, &rng), gotAligned(maxWidth, nullptr, 5);
+	for (int trial = 0; trial < trials; ++trial) {
+		Mat4f m[kMaxFanOut];
+		for (Mat4f& a : m)
+			a = randomMatrix(rng);
+		for (int c = 0; c < 4; ++c)
+			for (size_t i = 0; i < maxWidth; ++i)
+				src.p[c][i] = c == 3 ? alpha(rng) : value(rng);
+
+		for (int count = 1; count <= kMaxFanOut; ++count)
+			for (unsigned wDivide = 0; wDivide < (1u << count); ++wDivide)
+				for (Isa isa : isas)
+					for (int mode = 0; mode < 4; ++mode) {
+						const bool reproducible = mode & 1, stream = mode & 2;
+						KernelVariant v;
+						v.isa = isa;
+						v.reproducible = reproducible;
+						v.streamWidth = stream ? 1 : 0;
+						const FanOutPlan plan = planFanOut(m, count, wDivide, v);
+						const Planes& dst = stream ? gotAligned : got;
+
+						for (size_t n : widths) {
+							for (int k = 0; k < count; ++k)
+								planPlanar(m[k], (wDivide >> k) & 1u, v).run(15u, src.in(), ref.out(k), n);
+
+							// In up to three pieces.
+							const size_t cut1 = rng() % (n + 1);
+							const size_t cut2 = cut1 + rng() % (n - cut1 + 1);
+							const size_t cuts[4] = { 0, cut1, cut2, n };
+							for (int p = 0; p < 3; ++p) {
+								const float* pin[4];
+								float* pout[4 * kMaxFanOut];
+								for (int c = 0; c < 4; ++c)
+									pin[c] = src.p[c] + cuts[p];
+								for (int c = 0; c < 4 * count; ++c)
+									pout[c] = dst.out()[c] + cuts[p];
+								plan.run(pin, pout, cuts[p + 1] - cuts[p]);
+							}
+							for (int c = 0; c < 4 * count; ++c, ++checks)
+								if (std::memcmp(ref.out()[c], dst.out()[c], n * sizeof(float)) != 0)
+									fail("fan-out output differs from the planar kernel", count, wDivide, v, n);
+
+							// In place: the first matrix over the inputs.
+							Planes inplace(maxWidth);
+							for (int c = 0; c < 4; ++c)
+								std::memcpy(inplace.p[c], src.p[c], n * sizeof(float));
+							float* pout[4 * kMaxFanOut];
+							for (int c = 0; c < 4 * count; ++c)
+								pout[c] = c < 4 ? inplace.p[c] : dst.out()[c];
+							plan.run(inplace.in(), pout, n);
+							for (int c = 0; c < 4; ++c, ++checks)
+								if (std::memcmp(ref.out()[c], inplace.p[c], n * sizeof(float)) != 0)
+									fail("in-place fan-out differs from the planar kernel", count, wDivide, v, n);
+						}
+					}
+	}
+	std::printf("%lld fan-out rows compared, %lld wrong\n\n", checks, failures);
+
+	const size_t w = size_t(width);
+	Planes planes(w);
+	for (int c = 0; c < 4; ++c)
+		for (size_t i = 0; i < w; ++i)
+			planes.p[c][i] = c == 3 ? alpha(rng) : value(rng);
+	Mat4f m[kMaxFanOut];
+	for (Mat4f& a : m)
+		a = randomMatrix(rng);
+
+	// The first matrix without w divide, the others with it: camera space,
+	// then NDC and the like.
+	std::printf("width %d, tuned ISA %s\n", width, isaName(planFanOut(m, 1, 0u).variant.isa));
+	std::printf("%8s %14s %14s %8s\n", "matrices", "fan-out ns/px", "passes ns/px", "speedup");
+	for (int count = 1; count <= kMaxFanOut; ++count) {
+		const unsigned wDivide = (1u << count) - 2u;
+		const FanOutPlan plan = planFanOut(m, count, wDivide);
+		PlanarPlan passes[kMaxFanOut];
+		for (int k = 0; k < count; ++k)
+			passes[k] = planPlanar(m[k], (wDivide >> k) & 1u);
+
+		const double fanOutNs = timeNs([&] { plan.run(planes.in(), planes.out(), w); }) / double(w);
+		const double passesNs = timeNs([&] {
+			for (int k = 0; k < count; ++k)
+				passes[k].run(15u, planes.in(), planes.out(k), w);
+		}) / double(w);
+		std::printf("%8d %14.3f %14.3f %7.2fx\n", count, fanOutNs, passesNs, passesNs / fanOutNs);
+	}
+
+	return failures ? 1 : 0;
+}
+
+} // namespace c44
@@ -0,0 +1,725 @@
+// PluginBench.cpp
+//
+// c44bench plugin: runs the C44Matrix node itself (src/16.1+/C44Matrix.cpp)
+// on the DDImage shim in ddimage/, fed by a source op that hands out the
+// same rows every time. For each scenario it first checks that the node's
+// output matches the core kernels bit for bit, then times
+//
+//   validate   storing the knobs for a new frame (through the value
+//              provider when the matrix comes from the camera input) and
+//              running _validate
+//   row        one Iop::get of RGBA through the node, against the source
+//              alone and the bare PlanarPlan::run on the same row
+//
+// The difference is what the plugin adds per row: the PixelIop engine,
+// channel bookkeeping, aborted(), the counters and the pass-through copies.
+// The shim is leaner than DDImage, so these are lower bounds on what Nuke
+// would spend. With "publish matrix" on, the matrix in the node's output
+// metadata must be the one it applies, and a second C44Matrix taking the
+// published inverse from metadata must give back the source to within
+// rounding. Last come the node's own Diagnostics counters, which for
+// the camera and axis scenarios include the input matrix lookups that
+// validate made through the value provider.
+//
+// The channel matrix scenarios run the node on up to eight source
+// channels, checked against ChannelPlan::run, also with the knob
+// transposed and transpose on; for square matrices a second node with
+// invert on must give back the source.
+//
+// The fan-out scenario runs the node with the general matrix on RGBA and
+// three more entries, from metadata with w_divide, from the camera input
+// inverted and typed in, each to its own layer. Every channel must match
+// FanOutPlan::run on the same matrices, and a layer overlapping RGBA must
+// be an error. It is timed against four nodes, one per matrix, which is
+// what the same result took before.
+//
+// Last, playback: the node steps forward and then back through frames of a
+// camera that moves every frame and takes 2 ms to validate, one frame every
+// 10 ms. Per frame it reports the wait for the knobs to be stored and the
+// node validated, which is where the camera lookup stalls the viewer, and
+// checks the matrix is that frame's.
+
+#include "Commands.h"
+
+#include "DDImage/CameraOp.h"
+#include "DDImage/PixelIop.h"
+
+#include "core/C44Transform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace DD::Image;
+
+namespace c44 {
+
+namespace {
+
+// Channels of the source: RGBA, Z and three more, enough for an 8x8
+// channel matrix.
+const int kSourceChannels = 8;
+
+ChannelSet firstChannels(int n)
+{
+	ChannelSet s;
+	for (int c = 1; c <= n; ++c)
+		s += Channel(c);
+	return s;
+}
+
+
+// Rows of random samples, the same for every y, and metadata set by the
+// harness.
+class SourceIop : public Iop
+{
+	Format             _format;
+	std::vector<float> _planes[kSourceChannels];
+	MetaData::Bundle   _metadata;
+
+public:
+	SourceIop(int width, unsigned seed) : Iop(nullptr), _format(width, 1)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> dist(-1.0f, 2.0f);
+		for (std::vector<float>& p : _planes) {
+			p.resize(size_t(width));
+			for (float& v : p)
+				v = dist(rng);
+		}
+	}
+
+	const char* Class() const override { return "Source"; }
+	int minimum_inputs() const override { return 0; }
+	int maximum_inputs() const override { return 0; }
+
+	const float* plane(int c) const { return _planes[c].data(); }
+	void setMetadata(const char* key, const std::vector<double>& values) { _metadata.setData(key, values); }
+
+protected:
+	void _validate(bool) override
+	{
+		info_.set_channels(firstChannels(kSourceChannels));
+		info_.set_format(_format);
+		set_out_channels(firstChannels(kSourceChannels));
+	}
+
+	void _request(int, int, int, int, ChannelMask, int) override {}
+	const MetaData::Bundle& _fetchMetaData(const char*) override { return _metadata; }
+
+	void engine(int, int x, int r, ChannelMask channels, Row& row) override
+	{
+		foreach (z, channels)
+			if (z <= kSourceChannels)
+				std::memcpy(row.writable(z) + x, _planes[z - 1].data() + x, sizeof(float) * size_t(r - x));
+	}
+};
+
+
+enum class Input { Knob, Camera, Axis, Metadata, Expression };
+
+// Camera and axis translations of the expression scenario, and the
+// expression: inverse(T(1, 2, 3)) * T(1.25, 2.5, 3.75) * scale(2).
+const double kExprCamera[3] = { 1.0, 2.0, 3.0 };
+const double kExprAxis[3] = { 1.25, 2.5, 3.75 };
+const char* const kExpression = "inverse(cam.transform) * ax * scale(2)";
+
+struct Scenario
+{
+	const char* name;
+	Input       input;       // where the matrix comes from
+	int         matrixType;  // with a camera or axis input; the layout with
+	                         // metadata
+	bool        wDivide;
+	float       m[16];       // column-major, as Matrix4::array(); with an
+	                         // input, the result of matrixType on it
+};
+
+// Channel matrix mode, from the first 'inputs' source channels to the
+// first 'outputs', with a random matrix near the identity.
+struct ChannelScenario
+{
+	const char* name;
+	int         inputs, outputs;
+};
+
+const ChannelScenario kChannelScenarios[] = {
+	{ "chan 3x3", 3, 3 },
+	{ "chan 8x3", 8, 3 },
+	{ "chan 6x6", 6, 6 },
+	{ "chan 8x8", 8, 8 },
+};
+
+
+const Scenario kScenarios[] = {
+	{ "identity", Input::Knob,   0, false, { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } },
+	{ "swizzle",  Input::Knob,   0, false, { 0, 0, 1, 0,  0, 1, 0, 0,  1, 0, 0, 0,  0, 0, 0, 1 } },
+	{ "affine",   Input::Knob,   0, false, { 0.9f, 0.1f, 0.05f, 0,  0.2f, 0.8f, 0.1f, 0,  -0.1f, 0.1f, 1.1f, 0,  0.01f, 0.02f, 0.03f, 1 } },
+	{ "general",  Input::Knob,   0, false, { 0.9f, 0.1f, 0.05f, 0.1f,  0.2f, 0.8f, 0.1f, 0.2f,  -0.1f, 0.1f, 1.1f, 0.1f,  0.01f, 0.02f, 0.03f, 1 } },
+	{ "w_divide", Input::Knob,   0, true,  { 0.9f, 0.1f, 0.05f, 0.1f,  0.2f, 0.8f, 0.1f, 0.2f,  -0.1f, 0.1f, 1.1f, 0.1f,  0.01f, 0.02f, 0.03f, 1.5f } },
+	{ "camera",   Input::Camera, 0, false, { 0.9f, 0.1f, 0.05f, 0,  0.2f, 0.8f, 0.1f, 0,  -0.1f, 0.1f, 1.1f, 0,  0.01f, 0.02f, 0.03f, 1 } },
+	{ "axis",     Input::Axis,   1, false, { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0.01f, 0.02f, 0.03f, 1 } },
+	{ "metadata", Input::Metadata, 1, true, { 0.9f, 0.1f, 0.05f, 0.1f,  0.2f, 0.8f, 0.1f, 0.2f,  -0.1f, 0.1f, 1.1f, 0.1f,  0.01f, 0.02f, 0.03f, 1.5f } },
+	{ "expr",     Input::Expression, 0, false, { 2, 0, 0, 0,  0, 2, 0, 0,  0, 0, 2, 0,  0.25f, 0.5f, 0.75f, 1 } },
+};
+
+
+// Best-of-five time of 'body' in nanoseconds per call, each sample long
+// enough to be measured reliably.
+double timeNs(const std::function<void()>& body)
+{
+	typedef std::chrono::steady_clock Clock;
+	for (int i = 0; i < 4; ++i)
+		body();
+
+	int reps = 1;
+	for (;;) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		if (std::chrono::duration<double>(Clock::now() - t0).count() > 2e-3 || reps >= (1 << 22))
+			break;
+		reps *= 2;
+	}
+
+	double best = 1e30;
+	for (int sample = 0; sample < 5; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		for (int i = 0; i < reps; ++i)
+			body();
+		const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+		if (s < best)
+			best = s;
+	}
+	return best * 1e9 / double(reps);
+}
+
+
+std::unique_ptr<Iop> makeNode(const Scenario& s, SourceIop* source, CameraOp* camera, AxisOp* axis)
+{
+	const Iop::Description* d = Iop::Description::find("C44Matrix");
+	if (!d)
+		throw std::runtime_error("C44Matrix is not registered");
+
+	std::unique_ptr<Iop> node(d->constructor(nullptr));
+	node->buildKnobs();
+	AxisOp* const matrixInput = s.input == Input::Camera ? camera : s.input == Input::Axis ? axis : nullptr;
+	node->knob("matrixFrom")->set_value(matrixInput ? 1 : s.input == Input::Metadata ? 2 : s.input == Input::Expression ? 3 : 0);
+	node->knob("matrixType")->set_value(s.matrixType);
+	node->knob("metadataLayout")->set_value(s.matrixType);
+	node->knob("w_divide")->set_value(s.wDivide ? 1 : 0);
+	if (matrixInput) {
+		fdk::Mat4d world;
+		for (int i = 0; i < 16; ++i)
+			world.array()[i] = double(s.m[i]);
+		matrixInput->setWorldTransform(world);
+	}
+	else if (s.input == Input::Expression) {
+		fdk::Mat4d world;
+		for (int i = 0; i < 3; ++i)
+			world.array()[12 + i] = kExprCamera[i];
+		camera->setWorldTransform(world);
+		for (int i = 0; i < 3; ++i)
+			world.array()[12 + i] = kExprAxis[i];
+		axis->setWorldTransform(world);
+		node->knob("expression")->set_text(kExpression);
+	}
+	else if (s.input == Input::Metadata) {
+		// As an EXR stores it: column-major, the layout of Matrix4::array().
+		source->setMetadata("exr/worldToCamera", std::vector<double>(s.m, s.m + 16));
+	}
+	else {
+		for (int i = 0; i < 16; ++i)
+			node->knob("matrix")->set_value(double(s.m[i]), i);
+	}
+
+	node->set_input(0, source);
+	if (matrixInput && !node->set_input(1, matrixInput))
+		throw std::runtime_error(std::string("C44Matrix rejected the ") + matrixInput->Class() + " input");
+	if (s.input == Input::Expression && (!node->set_input(1, camera) || !node->set_input(2, axis)))
+		throw std::runtime_error("C44Matrix rejected the expression inputs");
+
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	node->request(0, 0, source->info().format().width(), 1, Mask_RGBA, 1);
+	return node;
+}
+
+
+bool sameBits(const float* a, const float* b, size_t n)
+{
+	return std::memcmp(a, b, n * sizeof(float)) == 0;
+}
+
+
+// Turns on "publish matrix" and checks the published matrix and inverse;
+// returns the number of failed checks.
+int checkPublished(const Scenario& s, Iop* node, SourceIop* source, int width)
+{
+	int failures = 0;
+	node->knob("publish")->set_value(1);
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+
+	const MetaData::Property& published = node->fetchMetaData(nullptr).getData("c44/matrix");
+	bool same = published.size() == 16;
+	for (size_t i = 0; same && i < 16; ++i)
+		same = published[i] == double(s.m[i]);
+	if (!same) {
+		std::printf("%-9s the published matrix is not the one applied\n", s.name);
+		++failures;
+	}
+
+	// The inverse undoes the matrix only without the w divide.
+	if (!s.wDivide) {
+		std::unique_ptr<Iop> undo(Iop::Description::find("C44Matrix")->constructor(nullptr));
+		undo->buildKnobs();
+		undo->knob("matrixFrom")->set_value(2);
+		undo->knob("metadataKey")->set_text("c44/matrixInverse");
+		undo->set_input(0, node);
+		undo->setOutputContext(OutputContext(1.0));
+		undo->validate(true);
+		undo->request(0, 0, width, 1, Mask_RGBA, 1);
+
+		Row row(0, width);
+		undo->get(0, 0, width, Mask_RGBA, row);
+		static const Channel rgba[4] = { Chan_Red, Chan_Green, Chan_Blue, Chan_Alpha };
+		double worst = 0.0;
+		for (int c = 0; c < 4; ++c)
+			for (int x = 0; x < width; ++x)
+				worst = std::max(worst, double(std::fabs(row[rgba[c]][x] - source->plane(c)[x])));
+		if (!undo->lastWarning().empty() || worst > 1e-5) {
+			std::printf("%-9s the published inverse gives back the source only to %g\n", s.name, worst);
+			++failures;
+		}
+	}
+
+	node->knob("publish")->set_value(0);
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	return failures;
+}
+
+
+// Times validate at a new frame, then at each width one Iop::get of
+// 'channels' through 'node', the source alone getting 'sourceChannels',
+// and 'kernel', which returns the time of the bare kernel on a row of w
+// pixels written into the row it is given. The source and kernel get rows
+// of their own, so the kernel sees the same buffer alignment (and so
+// streaming choice) as in the node.
+void printTimes(const char* name, Iop* node, SourceIop* source, ChannelMask channels,
+                ChannelMask sourceChannels, const std::vector<int>& widths,
+                const std::function<double(Row& kernelRow, size_t w)>& kernel)
+{
+	double frame = 1.0;
+	const double validateNs = timeNs([&] {
+		frame += 1.0;
+		node->setOutputContext(OutputContext(frame));
+		node->validate(true);
+	});
+
+	Row row(0, 1);
+	for (size_t k = 0; k < widths.size(); ++k) {
+		const int w = widths[k];
+		const double nodeNs = timeNs([&] { node->get(0, 0, w, channels, row); });
+		Row srcRow(0, w), kernelRow(0, w);
+		const double sourceNs = timeNs([&] { source->get(0, 0, w, sourceChannels, srcRow); });
+		const double kernelNs = kernel(kernelRow, size_t(w));
+		if (k == 0)
+			std::printf("%-9s %8.0f ns ", name, validateNs);
+		else
+			std::printf("%-9s %11s ", "", "");
+		std::printf(" %6d %11.0f %11.0f %11.0f %11.0f\n",
+		            w, nodeNs, sourceNs, kernelNs, nodeNs - sourceNs - kernelNs);
+	}
+}
+
+
+// A C44Matrix in channel matrix mode on 'source'.
+std::unique_ptr<Iop> makeChannelNode(const ChannelScenario& s, const ChannelMatrix& m,
+                                     SourceIop* source, bool transpose, bool invert)
+{
+	std::unique_ptr<Iop> node(Iop::Description::find("C44Matrix")->constructor(nullptr));
+	node->buildKnobs();
+	node->knob("channelMode")->set_value(1);
+	node->knob("inChannels")->set_value(double(firstChannels(s.inputs).bits()));
+	node->knob("outChannels")->set_value(double(firstChannels(s.outputs).bits()));
+	node->knob("transpose")->set_value(transpose ? 1 : 0);
+	node->knob("invert")->set_value(invert ? 1 : 0);
+	for (int r = 0; r < kMaxChannels; ++r)
+		for (int c = 0; c < kMaxChannels; ++c)
+			node->knob("channelMatrix")->set_value(double(transpose ? m(c, r) : m(r, c)), r * kMaxChannels + c);
+	node->set_input(0, source);
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	node->request(0, 0, source->info().format().width(), 1, firstChannels(kSourceChannels), 1);
+	return node;
+}
+
+
+// Checks channel matrix mode against ChannelPlan::run, with the knob as
+// given and transposed, and that a second node with invert on gives back
+// the source; then times it. Returns the number of failed checks.
+int checkChannels(const ChannelScenario& s, SourceIop* source, int width, const std::vector<int>& widths)
+{
+	std::mt19937 rng(unsigned(s.inputs * 8 + s.outputs));
+	std::uniform_real_distribution<float> offDiagonal(-0.2f, 0.2f);
+	ChannelMatrix m;
+	m.inputs = s.inputs;
+	m.outputs = s.outputs;
+	for (int r = 0; r < s.outputs; ++r)
+		for (int c = 0; c < s.inputs; ++c)
+			m(r, c) = (r == c ? 1.0f : 0.0f) + offDiagonal(rng);
+
+	const ChannelPlan plan = planChannels(m);
+	const float* in[kMaxChannels];
+	std::vector<float> expect(size_t(kMaxChannels) * size_t(width));
+	float* out[kMaxChannels];
+	for (int c = 0; c < kMaxChannels; ++c) {
+		in[c] = source->plane(c);
+		out[c] = &expect[size_t(c) * size_t(width)];
+	}
+	plan.run(in, out, size_t(width));
+
+	int failures = 0;
+	const ChannelSet outputs = firstChannels(s.outputs);
+	Row row(0, width);
+	for (bool transpose : { false, true }) {
+		std::unique_ptr<Iop> node = makeChannelNode(s, m, source, transpose, false);
+		node->get(0, 0, width, outputs, row);
+		for (int c = 0; c < s.outputs; ++c)
+			if (!sameBits(row[Channel(c + 1)], out[c], size_t(width))) {
+				std::printf("%-9s channel %d differs from ChannelPlan::run%s\n", s.name, c,
+				            transpose ? " with the knob transposed" : "");
+				++failures;
+			}
+	}
+
+	std::unique_ptr<Iop> node = makeChannelNode(s, m, source, false, false);
+	if (s.inputs == s.outputs) {
+		std::unique_ptr<Iop> undo = makeChannelNode(s, m, source, false, true);
+		undo->set_input(0, node.get());
+		undo->setOutputContext(OutputContext(1.0));
+		undo->validate(true);
+		undo->get(0, 0, width, outputs, row);
+		double worst = 0.0;
+		for (int c = 0; c < s.outputs; ++c)
+			for (int x = 0; x < width; ++x)
+				worst = std::max(worst, double(std::fabs(row[Channel(c + 1)][x] - source->plane(c)[x])));
+		if (!undo->lastError().empty() || worst > 1e-5) {
+			std::printf("%-9s the inverted channel matrix gives back the source only to %g\n", s.name, worst);
+			++failures;
+		}
+	}
+
+	ChannelSet sourceChannels = outputs;
+	sourceChannels += firstChannels(s.inputs);
+	printTimes(s.name, node.get(), source, outputs, sourceChannels, widths,
+	           [&](Row& kernelRow, size_t w) {
+		float* rowOut[kMaxChannels];
+		for (int c = 0; c < s.outputs; ++c)
+			rowOut[c] = kernelRow.writable(Channel(c + 1));
+		return timeNs([&] { plan.run(in, rowOut, w); });
+	});
+	return failures;
+}
+
+
+// Layer k of the fan-out scenario: four channels past the source's.
+ChannelSet fanOutLayer(int k)
+{
+	ChannelSet s;
+	for (int c = 0; c < 4; ++c)
+		s += Channel(kSourceChannels + 1 + 4 * (k - 1) + c);
+	return s;
+}
+
+// Checks the fan-out scenario, then times it; returns the number of failed
+// checks.
+int checkFanOut(SourceIop* source, CameraOp* camera, AxisOp* axis, int width, const std::vector<int>& widths)
+{
+	const Scenario& general = kScenarios[3];
+	const Scenario main = { "fan-out", Input::Knob, 0, false, {} };
+	Scenario s = main;
+	std::copy(general.m, general.m + 16, s.m);
+
+	// Matrix k of the plan: the general one, a projection-like one to
+	// divide by w, the inverse of a camera transform and one typed in.
+	static const float ndc[16] = { 1.2f, 0, 0, 0,  0, 1.6f, 0, 0,  0.1f, 0.05f, -1.0f, -1.0f,  0, 0, -0.2f, 0 };
+	static const float world[16] = { 0.8f, 0.2f, 0, 0,  -0.2f, 0.8f, 0, 0,  0, 0, 1, 0,  3, -1, 5, 1 };
+	static const float typed[16] = { 0.5f, 0, 0, 0,  0, 0.25f, 0, 0,  0, 0, 2, 0,  0.1f, 0.2f, 0.3f, 1 };
+	Mat4f mtx[kMaxFanOut] = { Mat4f::fromArray(s.m), Mat4f::fromArray(ndc),
+	                          Mat4f::fromArray(Matrix4(world).inverse().array()), Mat4f::fromArray(typed) };
+
+	std::unique_ptr<Iop> node = makeNode(s, source, camera, axis);
+	source->setMetadata("exr/worldToNDC", std::vector<double>(ndc, ndc + 16));
+	fdk::Mat4d cam;
+	for (int i = 0; i < 16; ++i)
+		cam.array()[i] = double(world[i]);
+	camera->setWorldTransform(cam);
+	for (int k = 1; k <= 3; ++k) {
+		const std::string n = "fanOut" + std::to_string(k);
+		node->knob((n + "Layer").c_str())->set_value(double(fanOutLayer(k).bits()));
+		node->knob((n + "From").c_str())->set_value(k == 1 ? 2 : k == 2 ? 1 : 0);
+	}
+	node->knob("metadataLayout")->set_value(1);   // column-major, as written above
+	node->knob("fanOut1WDivide")->set_value(1);
+	node->knob("fanOut2Invert")->set_value(1);
+	for (int i = 0; i < 16; ++i)
+		node->knob("fanOut3Matrix")->set_value(double(typed[i]), i);
+	if (!node->set_input(1, camera))
+		throw std::runtime_error("C44Matrix rejected the fan-out camera input");
+
+	ChannelSet channels = Mask_RGBA;
+	for (int k = 1; k <= 3; ++k)
+		channels += fanOutLayer(k);
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	node->request(0, 0, width, 1, channels, 1);
+
+	const FanOutPlan plan = planFanOut(mtx, kMaxFanOut, 2u);
+	const float* const in[4] = { source->plane(0), source->plane(1), source->plane(2), source->plane(3) };
+	std::vector<float> expect(4 * kMaxFanOut * size_t(width));
+	float* out[4 * kMaxFanOut];
+	for (int c = 0; c < 4 * kMaxFanOut; ++c)
+		out[c] = &expect[size_t(c) * size_t(width)];
+	plan.run(in, out, size_t(width));
+
+	int failures = 0;
+	Row row(0, width);
+	node->get(0, 0, width, channels, row);
+	if (!node->lastError().empty() || !node->lastWarning().empty()) {
+		std::printf("%-9s the node reported: %s%s\n", s.name, node->lastError().c_str(), node->lastWarning().c_str());
+		++failures;
+	}
+	for (int c = 0; c < 4 * kMaxFanOut; ++c)
+		if (!sameBits(row[Channel(c < 4 ? c + 1 : kSourceChannels + c - 3)], out[c], size_t(width))) {
+			std::printf("%-9s matrix %d channel %d differs from FanOutPlan::run\n", s.name, c / 4, c % 4);
+			++failures;
+		}
+
+	// A layer over RGBA is an error; a key that is not there a warning.
+	node->knob("fanOut3Layer")->set_value(double(ChannelSet(Mask_RGB).bits()));
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	if (node->lastError().empty()) {
+		std::printf("%-9s a layer over rgba gave no error\n", s.name);
+		++failures;
+	}
+	node->knob("fanOut3Layer")->set_value(double(fanOutLayer(3).bits()));
+	node->knob("fanOut1Key")->set_text("exr/worldToScreen");
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+	if (node->lastWarning().empty()) {
+		std::printf("%-9s a missing fan-out key gave no warning\n", s.name);
+		++failures;
+	}
+	node->knob("fanOut1Key")->set_text("exr/worldToNDC");
+	node->setOutputContext(OutputContext(1.0));
+	node->validate(true);
+
+	printTimes(s.name, node.get(), source, channels, Mask_RGBA, widths,
+	           [&](Row& kernelRow, size_t w) {
+		float* rowOut[4 * kMaxFanOut];
+		for (int c = 0; c < 4 * kMaxFanOut; ++c)
+			rowOut[c] = kernelRow.writable(Channel(c < 4 ? c + 1 : kSourceChannels + c - 3));
+		return timeNs([&] { plan.run(in, rowOut, w); });
+	});
+
+	// The same four matrices as four nodes on RGBA, each fetching the
+	// source rows itself.
+	std::unique_ptr<Iop> nodes[kMaxFanOut];
+	for (int k = 0; k < kMaxFanOut; ++k) {
+		Scenario one = main;
+		one.wDivide = k == 1;
+		std::copy(mtx[k].m, mtx[k].m + 16, one.m);
+		nodes[k] = makeNode(one, source, camera, axis);
+	}
+	for (int w : widths) {
+		Row rows[kMaxFanOut] = { Row(0, 1), Row(0, 1), Row(0, 1), Row(0, 1) };
+		const double ns = timeNs([&] {
+			for (int k = 0; k < kMaxFanOut; ++k)
+				nodes[k]->get(0, 0, w, Mask_RGBA, rows[k]);
+		});
+		std::printf("%-9s %11s  %6d %11.0f  (%d nodes, one matrix each)\n", "", "", w, ns, kMaxFanOut);
+	}
+
+	camera->setWorldTransform(fdk::Mat4d());
+	return failures;
+}
+
+
+struct Playback
+{
+	double meanWaitUs = 0.0, maxWaitUs = 0.0;
+	int    wrongFrames = 0;
+	std::string counters;
+};
+
+// Plays 'frames' frames forward and back of the camera moving 'step' along
+// x per frame.
+Playback playback(SourceIop* source, CameraOp* camera, int width)
+{
+	typedef std::chrono::steady_clock Clock;
+	const int frames = 48;
+	const double step = 0.01;
+	const Clock::duration interval = std::chrono::milliseconds(10);
+
+	const Scenario still = { "playback", Input::Camera, 0, false, { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } };
+	camera->animate(step, 2e6);
+	std::unique_ptr<Iop> node = makeNode(still, source, camera, nullptr);
+	node->knob_changed(node->knob("reset_stats"));
+
+	Playback result;
+	Row row(0, width);
+	for (int i = 0; i < 2 * frames; ++i) {
+		const int f = i < frames ? i + 1 : 2 * frames - i;
+		const Clock::time_point t0 = Clock::now();
+		node->setOutputContext(OutputContext(double(f)));
+		node->validate(true);
+		const double waitUs = std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+		result.meanWaitUs += waitUs / (2 * frames);
+		result.maxWaitUs = std::max(result.maxWaitUs, waitUs);
+		if (float(node->knob("matrix")->get_value(12)) != float(step * f))
+			++result.wrongFrames;
+
+		for (int y = 0; y < 64; ++y)
+			node->get(0, 0, width, Mask_RGBA, row);
+		std::this_thread::sleep_until(t0 + interval);
+	}
+
+	node->knob_changed(node->knob("update_stats"));
+	result.counters = node->knob("stats")->get_text();
+	result.counters = result.counters.substr(result.counters.find("resolve"));
+	std::replace(result.counters.begin(), result.counters.end(), '\n', ' ');
+	camera->animate(0.0, 0.0);
+	return result;
+}
+
+} // namespace
+
+
+int pluginCommand(int argc, char** argv)
+{
+	std::vector<int> widths = { 64, 512, 2048, 8192 };
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--width" && i + 1 < argc)
+			widths.assign(1, parseInt(argv[++i], "--width"));
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+	for (int w : widths)
+		if (w < 1)
+			throw std::runtime_error("--width must be positive");
+
+	int maxWidth = 0;
+	for (int w : widths)
+		maxWidth = std::max(maxWidth, w);
+
+	SourceIop source(maxWidth, 1u);
+	source.validate(true);
+	CameraOp camera;
+	AxisOp axis;
+
+	std::vector<float> expect(4 * size_t(maxWidth));
+	int failures = 0;
+
+	std::printf("%-9s %11s  %6s %11s %11s %11s %11s\n",
+	            "scenario", "validate", "width", "node ns/row", "source", "kernel", "overhead");
+	for (const Scenario& s : kScenarios) {
+		std::unique_ptr<Iop> node = makeNode(s, &source, &camera, &axis);
+
+		// The node against the core kernels on the same matrix.
+		const PlanarPlan plan = planPlanar(Mat4f::fromArray(s.m), s.wDivide);
+		const float* const in[4] = { source.plane(0), source.plane(1), source.plane(2), source.plane(3) };
+		float* const out[4] = { &expect[0], &expect[size_t(maxWidth)],
+		                        &expect[2 * size_t(maxWidth)], &expect[3 * size_t(maxWidth)] };
+		plan.run(15u, in, out, size_t(maxWidth));
+
+		// Channels the node computes rather than passes through, as in
+		// C44Matrix::_validate.
+		unsigned mask = 15u;
+		if (!s.wDivide)
+			mask &= ~passthroughMask(plan.rows);
+
+		Row row(0, maxWidth);
+		node->get(0, 0, maxWidth, Mask_RGBA, row);
+		static const Channel rgba[4] = { Chan_Red, Chan_Green, Chan_Blue, Chan_Alpha };
+		for (int c = 0; c < 4; ++c)
+			if (!sameBits(row[rgba[c]], out[c], size_t(maxWidth))) {
+				std::printf("%-9s channel %d differs from PlanarPlan::run\n", s.name, c);
+				++failures;
+			}
+
+		failures += checkPublished(s, node.get(), &source, maxWidth);
+
+		// A broken expression is an error on the node.
+		if (s.input == Input::Expression) {
+			node->knob("expression")->set_text("inverse(cam");
+			node->setOutputContext(OutputContext(1.0));
+			node->validate(true);
+			if (node->lastError().empty()) {
+				std::printf("%-9s a broken expression gave no error\n", s.name);
+				++failures;
+			}
+			node->knob("expression")->set_text(kExpression);
+			node->setOutputContext(OutputContext(1.0));
+			node->validate(true);
+		}
+
+		// A key that is not there gives the identity and a warning.
+		if (s.input == Input::Metadata) {
+			node->knob("metadataKey")->set_text("exr/worldToNDC");
+			node->setOutputContext(OutputContext(1.0));
+			node->validate(true);
+			if (node->lastWarning().empty() || node->knob("matrix")->get_value(0) != 1.0) {
+				std::printf("%-9s a missing key gave no warning or not the identity\n", s.name);
+				++failures;
+			}
+			node->knob("metadataKey")->set_text("exr/worldToCamera");
+		}
+
+		printTimes(s.name, node.get(), &source, Mask_RGBA, Mask_RGBA, widths,
+		           [&](Row& kernelRow, size_t w) {
+			float* const rowOut[4] = { kernelRow.writable(Chan_Red), kernelRow.writable(Chan_Green),
+			                           kernelRow.writable(Chan_Blue), kernelRow.writable(Chan_Alpha) };
+			return timeNs([&] { plan.run(mask, in, rowOut, w); });
+		});
+
+		// The node's own counters, read the way a script would.
+		node->knob_changed(node->knob("update_stats"));
+		std::string counters = node->knob("stats")->get_text();
+		std::replace(counters.begin(), counters.end(), '\n', ' ');
+		std::printf("%-9s %s\n", "", counters.c_str());
+	}
+
+	for (const ChannelScenario& s : kChannelScenarios)
+		failures += checkChannels(s, &source, maxWidth, widths);
+
+	failures += checkFanOut(&source, &camera, &axis, maxWidth, widths);
+
+	std::printf("\n%-9s %13s %13s\n", "playback", "mean wait", "max wait");
+	const Playback p = playback(&source, &camera, std::min(maxWidth, 2048));
+	std::printf("%-9s %10.0f us %10.0f us\n", "", p.meanWaitUs, p.maxWaitUs);
+	std::printf("%-9s %s\n", "", p.counters.c_str());
+	if (p.wrongFrames) {
+		std::printf("%-9s %d frames got another frame's matrix\n", "", p.wrongFrames);
+		failures += p.wrongFrames;
+	}
+
+	if (failures)
+		std::printf("%d channel rows or frames differ\n", failures);
+	return failures ? 1 : 0;
+}
+
+} // namespace c44
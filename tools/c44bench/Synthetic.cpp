@@ -0,0 +1,524 @@
+// Synthetic.cpp
+//
+// The P/N/Z pass generator and `c44bench synth`, which benchmarks the
+// kernels on those passes next to uniform noise.
+//
+// Objects are placed at random inside the view frustum until a coarse
+// render reaches the requested coverage. For the full-size render each
+// object's screen bounds are binned into 16x16 pixel tiles, so a pixel only
+// tests the objects that can reach it. Random numbers come straight from
+// std::mt19937, whose output the standard fixes, not from the
+// distributions, whose output it doesn't.
+
+#include "Synthetic.h"
+
+#include "Commands.h"
+
+#include "core/C44Transform.h"
+#include "core/C44Tune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+// ---------------------------------------------------------------------------
+// Scene
+// ---------------------------------------------------------------------------
+
+struct Vec3
+{
+	double x, y, z;
+};
+
+Vec3 operator+(Vec3 a, Vec3 b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+Vec3 operator-(Vec3 a, Vec3 b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+Vec3 operator*(Vec3 a, double s) { return { a.x * s, a.y * s, a.z * s }; }
+double dot(Vec3 a, Vec3 b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+Vec3 normalize(Vec3 a) { return a * (1.0 / std::sqrt(dot(a, a))); }
+
+// Camera 1.6 units up and 8 back, pitched 10 degrees down, 55 degree
+// horizontal field of view.
+const Vec3   kEye = { 0.0, 1.6, 8.0 };
+const double kPitch = -10.0 * 3.14159265358979323846 / 180.0;
+const double kTanHalfFov = 0.52056705055174;   // tan(27.5 degrees)
+const double kFar = 200.0;
+
+// Camera axes in world space.
+const Vec3 kRight = { 1.0, 0.0, 0.0 };
+const Vec3 kUp    = { 0.0, std::cos(kPitch), std::sin(kPitch) };
+const Vec3 kBack  = { 0.0, -std::sin(kPitch), std::cos(kPitch) };
+
+Vec3 toWorld(Vec3 c) { return kRight * c.x + kUp * c.y + kBack * c.z; }
+Vec3 toCamera(Vec3 w) { return { dot(w, kRight), dot(w, kUp), dot(w, kBack) }; }
+
+struct Object
+{
+	bool   sphere;   // else a disc
+	Vec3   centre;
+	Vec3   normal;   // discs only
+	double radius;
+};
+
+struct Hit
+{
+	double t;
+	Vec3   normal;
+};
+
+bool intersect(const Object& o, Vec3 origin, Vec3 dir, Hit& hit)
+{
+	if (o.sphere) {
+		const Vec3   oc = origin - o.centre;
+		const double b = dot(oc, dir);
+		const double disc = b * b - (dot(oc, oc) - o.radius * o.radius);
+		if (disc < 0.0)
+			return false;
+		const double t = -b - std::sqrt(disc);
+		if (t <= 1e-6 || t >= hit.t)
+			return false;
+		hit.t = t;
+		hit.normal = normalize(origin + dir * t - o.centre);
+		return true;
+	}
+	const double denom = dot(o.normal, dir);
+	if (std::fabs(denom) < 1e-12)
+		return false;
+	const double t = dot(o.centre - origin, o.normal) / denom;
+	if (t <= 1e-6 || t >= hit.t)
+		return false;
+	const Vec3 d = origin + dir * t - o.centre;
+	if (dot(d, d) > o.radius * o.radius)
+		return false;
+	hit.t = t;
+	hit.normal = denom < 0.0 ? o.normal : o.normal * -1.0;
+	return true;
+}
+
+bool intersectGround(Vec3 origin, Vec3 dir, Hit& hit)
+{
+	if (dir.y >= 0.0)
+		return false;
+	const double t = -origin.y / dir.y;
+	if (t >= hit.t || t >= kFar)
+		return false;
+	hit.t = t;
+	hit.normal = { 0.0, 1.0, 0.0 };
+	return true;
+}
+
+
+// Uniform in [lo, hi) from the top 53 bits of two draws.
+double uniform(std::mt19937& rng, double lo, double hi)
+{
+	const uint64_t a = rng() >> 5, b = rng() >> 6;
+	const double u = (double(a) * 67108864.0 + double(b)) * (1.0 / 9007199254740992.0);
+	return lo + (hi - lo) * u;
+}
+
+Object randomObject(std::mt19937& rng)
+{
+	// Depth uniform from 4 to 60 units, so most objects are small and far;
+	// screen position a little past the frame edges.
+	const double depth = uniform(rng, 4.0, 60.0);
+	const double u = uniform(rng, -1.1, 1.1), v = uniform(rng, -0.7, 0.7);
+
+	Object o;
+	o.sphere = uniform(rng, 0.0, 1.0) < 0.7;
+	o.centre = kEye + toWorld({ u * kTanHalfFov * depth, v * kTanHalfFov * depth, -depth });
+	o.radius = uniform(rng, 0.2, 1.6);
+	o.normal = normalize({ uniform(rng, -1.0, 1.0), uniform(rng, -1.0, 1.0), uniform(rng, -1.0, 1.0) });
+	return o;
+}
+
+
+// Pixel to ray direction, with row 0 at the bottom.
+Vec3 rayDir(int x, int y, int width, int height)
+{
+	const double u = (2.0 * (x + 0.5) / width - 1.0) * kTanHalfFov;
+	const double v = (2.0 * (y + 0.5) / height - 1.0) * kTanHalfFov * height / width;
+	return normalize(toWorld({ u, v, -1.0 }));
+}
+
+// Pixel bounds [x0, x1] x [y0, y1] the object can cover; false if none.
+bool screenBounds(const Object& o, int width, int height, int& x0, int& y0, int& x1, int& y1)
+{
+	const Vec3   c = toCamera(o.centre - kEye);
+	const double depth = -c.z, r = o.radius;
+	if (depth + r <= 0.0)
+		return false;
+	if (depth - r <= 0.05) {
+		x0 = 0, y0 = 0, x1 = width - 1, y1 = height - 1;
+		return true;
+	}
+
+	// Extremes of x / z over the bounding box, at the near and far depth.
+	double u0 = 1e30, u1 = -1e30, v0 = 1e30, v1 = -1e30;
+	for (double z : { depth - r, depth + r }) {
+		for (double s : { -r, r }) {
+			u0 = std::min(u0, (c.x + s) / z), u1 = std::max(u1, (c.x + s) / z);
+			v0 = std::min(v0, (c.y + s) / z), v1 = std::max(v1, (c.y + s) / z);
+		}
+	}
+	const double sx = width / (2.0 * kTanHalfFov), sy = height / (2.0 * kTanHalfFov * height / width);
+	x0 = std::max(0, int(std::floor(u0 * sx + width * 0.5)) - 1);
+	x1 = std::min(width - 1, int(std::ceil(u1 * sx + width * 0.5)) + 1);
+	y0 = std::max(0, int(std::floor(v0 * sy + height * 0.5)) - 1);
+	y1 = std::min(height - 1, int(std::ceil(v1 * sy + height * 0.5)) + 1);
+	return x0 <= x1 && y0 <= y1;
+}
+
+
+// Places objects until a coarse render reaches the coverage, or the
+// requested count.
+std::vector<Object> buildScene(const SynthOptions& opt)
+{
+	const int cw = std::min(opt.width, 192);
+	const int ch = std::max(1, cw * opt.height / opt.width);
+	std::vector<char> covered(size_t(cw) * size_t(ch), 0);
+	size_t count = 0;
+
+	if (opt.ground) {
+		for (int y = 0; y < ch; ++y)
+			for (int x = 0; x < cw; ++x) {
+				Hit hit = { 1e30, {} };
+				if (intersectGround(kEye, rayDir(x, y, cw, ch), hit))
+					covered[size_t(y) * size_t(cw) + size_t(x)] = 1, ++count;
+			}
+	}
+
+	std::mt19937 rng(opt.seed);
+	std::vector<Object> objects;
+	const size_t target = size_t(std::ceil(std::min(opt.coverage, 1.0) * double(covered.size())));
+	const size_t maxObjects = opt.objects > 0 ? size_t(opt.objects) : 20000;
+	while (objects.size() < maxObjects && (opt.objects > 0 || count < target)) {
+		const Object o = randomObject(rng);
+		objects.push_back(o);
+
+		int x0, y0, x1, y1;
+		if (!screenBounds(o, cw, ch, x0, y0, x1, y1))
+			continue;
+		for (int y = y0; y <= y1; ++y)
+			for (int x = x0; x <= x1; ++x) {
+				char& c = covered[size_t(y) * size_t(cw) + size_t(x)];
+				Hit hit = { 1e30, {} };
+				if (!c && intersect(o, kEye, rayDir(x, y, cw, ch), hit))
+					c = 1, ++count;
+			}
+	}
+	return objects;
+}
+
+} // namespace
+
+
+const char* synthPassName(SynthPass pass)
+{
+	switch (pass) {
+	case SynthPass::Position: return "P";
+	case SynthPass::Normal:   return "N";
+	case SynthPass::Depth:    return "Z";
+	}
+	return "?";
+}
+
+
+SynthFrame synthesize(SynthPass pass, const SynthOptions& opt)
+{
+	if (opt.width < 1 || opt.height < 1)
+		throw std::runtime_error("synthetic frame size must be positive");
+
+	const std::vector<Object> objects = buildScene(opt);
+
+	// Objects per 16x16 tile.
+	const int tile = 16;
+	const int tw = (opt.width + tile - 1) / tile, th = (opt.height + tile - 1) / tile;
+	std::vector<std::vector<uint32_t>> bins(size_t(tw) * size_t(th));
+	for (size_t i = 0; i < objects.size(); ++i) {
+		int x0, y0, x1, y1;
+		if (!screenBounds(objects[i], opt.width, opt.height, x0, y0, x1, y1))
+			continue;
+		for (int ty = y0 / tile; ty <= y1 / tile; ++ty)
+			for (int tx = x0 / tile; tx <= x1 / tile; ++tx)
+				bins[size_t(ty) * size_t(tw) + size_t(tx)].push_back(uint32_t(i));
+	}
+
+	SynthFrame f;
+	f.width = opt.width;
+	f.height = opt.height;
+	f.objects = int(objects.size());
+	for (std::vector<float>& p : f.planes)
+		p.assign(size_t(opt.width) * size_t(opt.height), 0.0f);
+
+	size_t hits = 0;
+	for (int y = 0; y < opt.height; ++y) {
+		float* const out[4] = { f.row(0, y), f.row(1, y), f.row(2, y), f.row(3, y) };
+		for (int x = 0; x < opt.width; ++x) {
+			const Vec3 dir = rayDir(x, y, opt.width, opt.height);
+			Hit hit = { 1e30, {} };
+			bool any = opt.ground && intersectGround(kEye, dir, hit);
+			for (uint32_t i : bins[size_t(y / tile) * size_t(tw) + size_t(x / tile)])
+				any = intersect(objects[i], kEye, dir, hit) || any;
+			if (!any)
+				continue;
+
+			++hits;
+			const Vec3 p = kEye + dir * hit.t;
+			Vec3 v{};
+			switch (pass) {
+			case SynthPass::Position:
+				v = p;
+				break;
+			case SynthPass::Normal:
+				v = hit.normal;
+				break;
+			case SynthPass::Depth: {
+				const double depth = -toCamera(p - kEye).z;
+				v = { 1.0 / depth, depth, 0.0 };
+				break;
+			}
+			}
+			out[0][x] = float(v.x);
+			out[1][x] = float(v.y);
+			out[2][x] = float(v.z);
+			out[3][x] = 1.0f;
+		}
+	}
+	f.coverage = double(hits) / (double(opt.width) * double(opt.height));
+	return f;
+}
+
+
+std::vector<float> packRgba(const SynthFrame& frame)
+{
+	const size_t n = size_t(frame.width) * size_t(frame.height);
+	std::vector<float> rgba(4 * n);
+	for (size_t i = 0; i < n; ++i)
+		for (int c = 0; c < 4; ++c)
+			rgba[4 * i + size_t(c)] = frame.planes[c][i];
+	return rgba;
+}
+
+
+Mat4f synthCamera()
+{
+	const Vec3 axes[3] = { kRight, kUp, kBack };
+	Mat4f m = Mat4f::identity();
+	for (int col = 0; col < 3; ++col) {
+		m(0, col) = float(axes[col].x);
+		m(1, col) = float(axes[col].y);
+		m(2, col) = float(axes[col].z);
+	}
+	m(0, 3) = float(kEye.x);
+	m(1, 3) = float(kEye.y);
+	m(2, 3) = float(kEye.z);
+	return m;
+}
+
+
+Mat4f synthProjection()
+{
+	// Rows of the world-to-camera transform, then x / t, y / t, 1 and
+	// -z into w.
+	const Vec3 rows[3] = { kRight, kUp, kBack };
+	const double shift[3] = { -dot(kRight, kEye), -dot(kUp, kEye), -dot(kBack, kEye) };
+	Mat4f m = Mat4f::identity();
+	for (int r = 0; r < 2; ++r) {
+		m(r, 0) = float(rows[r].x / kTanHalfFov);
+		m(r, 1) = float(rows[r].y / kTanHalfFov);
+		m(r, 2) = float(rows[r].z / kTanHalfFov);
+		m(r, 3) = float(shift[r] / kTanHalfFov);
+	}
+	m(2, 0) = m(2, 1) = m(2, 2) = 0.0f;
+	m(2, 3) = 1.0f;
+	m(3, 0) = float(-rows[2].x);
+	m(3, 1) = float(-rows[2].y);
+	m(3, 2) = float(-rows[2].z);
+	m(3, 3) = float(-shift[2]);
+	return m;
+}
+
+
+// ---------------------------------------------------------------------------
+// c44bench synth
+// ---------------------------------------------------------------------------
+
+namespace {
+
+// Best-of-three time of one pass of 'plan' over every row, in ns per pixel.
+double measureFrame(const PlanarPlan& plan, const SynthFrame& f, std::vector<float> (&out)[4])
+{
+	typedef std::chrono::steady_clock Clock;
+	double best = 1e30;
+	for (int sample = 0; sample < 4; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		for (int y = 0; y < f.height; ++y) {
+			const float* const in[4] = { f.row(0, y), f.row(1, y), f.row(2, y), f.row(3, y) };
+			const size_t o = size_t(y) * size_t(f.width);
+			float* const dst[4] = { &out[0][o], &out[1][o], &out[2][o], &out[3][o] };
+			plan.run(15u, in, dst, size_t(f.width));
+		}
+		const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+		if (sample > 0 && s < best)   // the first pass warms up
+			best = s;
+	}
+	return best * 1e9 / (double(f.width) * double(f.height));
+}
+
+double measurePacked(const Mat4f& m, bool wDivide, const std::vector<float>& in, std::vector<float>& out, size_t n)
+{
+	typedef std::chrono::steady_clock Clock;
+	double best = 1e30;
+	for (int sample = 0; sample < 4; ++sample) {
+		const Clock::time_point t0 = Clock::now();
+		transformStrided(m, wDivide, packedPoints(in.data()), packedPoints(out.data()), n);
+		const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+		if (sample > 0 && s < best)
+			best = s;
+	}
+	return best * 1e9 / double(n);
+}
+
+SynthFrame noiseFrame(const SynthOptions& opt)
+{
+	SynthFrame f;
+	f.width = opt.width;
+	f.height = opt.height;
+	f.coverage = 1.0;
+	std::mt19937 rng(opt.seed);
+	for (std::vector<float>& p : f.planes) {
+		p.resize(size_t(opt.width) * size_t(opt.height));
+		for (float& v : p)
+			v = float(uniform(rng, -1.0, 2.0));
+	}
+	return f;
+}
+
+} // namespace
+
+
+int synthCommand(int argc, char** argv)
+{
+	SynthOptions opt;
+	SynthPass pass = SynthPass::Position;
+	std::string outPath;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const auto value = [&]() -> const char* {
+			if (i + 1 >= argc)
+				throw std::runtime_error(arg + " needs a value");
+			return argv[++i];
+		};
+		if (arg == "--size") {
+			const char* v = value();
+			if (std::sscanf(v, "%dx%d", &opt.width, &opt.height) != 2 || opt.width < 1 || opt.height < 1)
+				throw std::runtime_error(std::string("--size: expected WxH, got ") + v);
+		}
+		else if (arg == "--coverage") {
+			char* end = nullptr;
+			const char* v = value();
+			opt.coverage = std::strtod(v, &end);
+			if (end == v || *end != '\0' || opt.coverage < 0.0 || opt.coverage > 1.0)
+				throw std::runtime_error(std::string("--coverage: expected 0..1, got ") + v);
+		}
+		else if (arg == "--objects")
+			opt.objects = parseInt(value(), "--objects");
+		else if (arg == "--ground")
+			opt.ground = true;
+		else if (arg == "--seed")
+			opt.seed = uint32_t(parseInt(value(), "--seed"));
+		else if (arg == "--pass") {
+			const std::string v = value();
+			if (v == "P" || v == "p")
+				pass = SynthPass::Position;
+			else if (v == "N" || v == "n")
+				pass = SynthPass::Normal;
+			else if (v == "Z" || v == "z")
+				pass = SynthPass::Depth;
+			else
+				throw std::runtime_error("--pass: expected P, N or Z, got " + v);
+		}
+		else if (arg == "--out")
+			outPath = value();
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+
+	if (!outPath.empty()) {
+		const SynthFrame f = synthesize(pass, opt);
+		const std::vector<float> rgba = packRgba(f);
+		FILE* fp = std::fopen(outPath.c_str(), "wb");
+		if (!fp || std::fwrite(rgba.data(), sizeof(float), rgba.size(), fp) != rgba.size() || std::fclose(fp) != 0)
+			throw std::runtime_error("cannot write " + outPath);
+		std::printf("%s: %s pass %dx%d, %d objects, %.1f%% coverage\n", outPath.c_str(),
+		            synthPassName(pass), f.width, f.height, f.objects, 100.0 * f.coverage);
+		return 0;
+	}
+
+	// Every pass through every kernel path, next to noise.
+	static const float swizzle[16] = { 0, 0, 1, 0,  0, 1, 0, 0,  1, 0, 0, 0,  0, 0, 0, 1 };
+	Mat4f worldToCamera;
+	invert(synthCamera(), worldToCamera);
+	const Mat4f projection = synthProjection();
+	const struct
+	{
+		const char* name;
+		Mat4f       m;
+		bool        wDivide;
+	} cases[] = {
+		{ "identity", Mat4f::identity(),           false },
+		{ "swizzle",  Mat4f::fromArray(swizzle),   false },
+		{ "camera",   worldToCamera,               false },
+		{ "project",  projection,                  false },
+		{ "project/w", projection,                 true },
+	};
+
+	std::vector<SynthFrame> frames;
+	frames.push_back(noiseFrame(opt));
+	for (SynthPass p : { SynthPass::Position, SynthPass::Normal, SynthPass::Depth })
+		frames.push_back(synthesize(p, opt));
+
+	std::vector<Isa> isas;
+	for (Isa isa : { Isa::Baseline, Isa::Avx2, Isa::Avx512 })
+		if (isaSupported(isa))
+			isas.push_back(isa);
+
+	std::printf("%dx%d, %d objects, %.1f%% coverage; ns per pixel\n",
+	            opt.width, opt.height, frames[1].objects, 100.0 * frames[1].coverage);
+	std::printf("%-6s %-10s", "pass", "matrix");
+	for (Isa isa : isas)
+		std::printf(" %9s", isaName(isa));
+	std::printf(" %9s %9s\n", "tuned", "packed");
+
+	std::vector<float> out[4];
+	for (std::vector<float>& o : out)
+		o.resize(size_t(opt.width) * size_t(opt.height));
+	std::vector<float> packedOut(4 * size_t(opt.width) * size_t(opt.height));
+
+	for (size_t fi = 0; fi < frames.size(); ++fi) {
+		const SynthFrame& f = frames[fi];
+		const std::vector<float> packed = packRgba(f);
+		for (const auto& c : cases) {
+			std::printf("%-6s %-10s", fi == 0 ? "noise" : synthPassName(SynthPass(fi - 1)), c.name);
+			for (Isa isa : isas) {
+				KernelVariant v;
+				v.isa = isa;
+				std::printf(" %9.3f", measureFrame(planPlanar(c.m, c.wDivide, v), f, out));
+			}
+			std::printf(" %9.3f", measureFrame(planPlanar(c.m, c.wDivide), f, out));
+			std::printf(" %9.3f\n", measurePacked(c.m, c.wDivide, packed, packedOut, packed.size() / 4));
+		}
+	}
+	return 0;
+}
+
+} // namespace c44
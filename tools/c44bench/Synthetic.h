@@ -0,0 +1,59 @@
+// Synthetic.h
+//
+// Deterministic stand-ins for the CG passes C44Matrix is usually fed:
+// world position (P), world normal (N) and depth (Z), ray cast from a fixed
+// camera over a scene of scattered spheres and discs and an optional ground
+// plane. Unlike noise they have what real renders have: empty background
+// (all zero, alpha 0), smooth gradients across surfaces, and w values that
+// cluster at 0 and 1. The same options and seed give the same frame
+// bit for bit on every platform.
+
+#pragma once
+
+#include "core/C44Transform.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace c44 {
+
+enum class SynthPass { Position, Normal, Depth };
+
+const char* synthPassName(SynthPass pass);
+
+struct SynthOptions
+{
+	int      width    = 1920;
+	int      height   = 1080;
+	double   coverage = 0.6;     // fraction of pixels hit, with objects == 0
+	int      objects  = 0;       // exact object count instead of a coverage
+	bool     ground   = false;   // add a ground plane below the objects
+	uint32_t seed     = 1;
+};
+
+// Pixels of one pass, as four planes of width * height floats with row 0
+// at the bottom, as in Nuke. P and N hold world x, y, z and alpha; Z holds
+// 1/depth (Nuke's depth.Z), depth, 0 and alpha.
+struct SynthFrame
+{
+	int                width = 0, height = 0;
+	std::vector<float> planes[4];
+	double             coverage = 0.0;   // fraction of pixels with alpha 1
+	int                objects = 0;
+
+	const float* row(int c, int y) const { return planes[c].data() + size_t(y) * size_t(width); }
+	float*       row(int c, int y)       { return planes[c].data() + size_t(y) * size_t(width); }
+};
+
+SynthFrame synthesize(SynthPass pass, const SynthOptions& options);
+
+// Interleaved RGBA, the layout c44batch reads.
+std::vector<float> packRgba(const SynthFrame& frame);
+
+// The camera the passes are rendered from (camera to world), and the
+// matrix that projects world positions to its normalised screen: after the
+// w divide x and y are -1..1 across the frame width, and w is the depth.
+Mat4f synthCamera();
+Mat4f synthProjection();
+
+} // namespace c44
@@ -0,0 +1,171 @@
+// ThreadScaling.cpp
+//
+// c44bench threads: runs the tuned planar kernel over a full frame from
+// 1..N threads, each on its own band of rows, as Nuke's engine threads
+// call pixel_engine on different rows at once. The frame is a synthetic
+// P pass (see Synthetic.h) held as four input and four output planes.
+//
+// Next to it, at every thread count, the same threads run STREAM-style
+// copy and triad loops over the same planes. The faster of the two is the
+// roofline: the bandwidth this machine actually sustains with that many
+// threads. Bytes are counted the STREAM way, reads plus writes without
+// write-allocate traffic, so the kernel moves 32 bytes per pixel. When the
+// kernel's bandwidth approaches the roofline, more threads cannot help and
+// the node is bandwidth-bound; while it stays well below, it is
+// compute-bound and scales with cores.
+//
+// Threads are started for every pass and joined at the end of it; on a
+// frame of a few milliseconds that costs well under a percent.
+
+#include "Commands.h"
+#include "Synthetic.h"
+
+#include "core/C44Transform.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace c44 {
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Calls body(first, last) for thread t's band of 'rows' on each of 'threads'
+// threads, and returns the wall time of the slowest.
+double runBands(int threads, int rows, const std::function<void(int, int)>& body)
+{
+	std::vector<std::thread> pool;
+	pool.reserve(size_t(threads));
+	const Clock::time_point t0 = Clock::now();
+	for (int t = 0; t < threads; ++t) {
+		const int first = int(int64_t(rows) * t / threads);
+		const int last = int(int64_t(rows) * (t + 1) / threads);
+		pool.emplace_back(body, first, last);
+	}
+	for (std::thread& th : pool)
+		th.join();
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// Best of 'passes' runs, after one to warm up.
+double bestOf(int passes, int threads, int rows, const std::function<void(int, int)>& body)
+{
+	runBands(threads, rows, body);
+	double best = 1e30;
+	for (int p = 0; p < passes; ++p)
+		best = std::min(best, runBands(threads, rows, body));
+	return best;
+}
+
+std::vector<int> threadCounts(int maxThreads)
+{
+	std::vector<int> counts;
+	for (int t = 1; t < maxThreads; t *= 2)
+		counts.push_back(t);
+	counts.push_back(maxThreads);
+	return counts;
+}
+
+} // namespace
+
+
+int threadsCommand(int argc, char** argv)
+{
+	SynthOptions opt;
+	int maxThreads = int(std::thread::hardware_concurrency());
+	int passes = 5;
+	bool wDivide = false;
+	for (int i = 0; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const auto value = [&]() -> const char* {
+			if (i + 1 >= argc)
+				throw std::runtime_error(arg + " needs a value");
+			return argv[++i];
+		};
+		if (arg == "--threads")
+			maxThreads = parseInt(value(), "--threads");
+		else if (arg == "--size") {
+			const char* v = value();
+			if (std::sscanf(v, "%dx%d", &opt.width, &opt.height) != 2 || opt.width < 1 || opt.height < 1)
+				throw std::runtime_error(std::string("--size: expected WxH, got ") + v);
+		}
+		else if (arg == "--passes")
+			passes = parseInt(value(), "--passes");
+		else if (arg == "--w-divide")
+			wDivide = true;
+		else
+			throw std::runtime_error("unknown option " + arg);
+	}
+	if (maxThreads < 1)
+		maxThreads = 1;
+	if (passes < 1)
+		throw std::runtime_error("--passes must be positive");
+
+	const SynthFrame frame = synthesize(SynthPass::Position, opt);
+	const size_t width = size_t(frame.width), pixels = width * size_t(frame.height);
+	std::vector<float> out[4];
+	for (std::vector<float>& o : out)
+		o.assign(pixels, 0.0f);
+
+	const PlanarPlan plan = planPlanar(synthProjection(), wDivide);
+
+	const auto kernel = [&](int first, int last) {
+		for (int y = first; y < last; ++y) {
+			const size_t o = size_t(y) * width;
+			const float* const in[4] = { frame.row(0, y), frame.row(1, y), frame.row(2, y), frame.row(3, y) };
+			float* const dst[4] = { &out[0][o], &out[1][o], &out[2][o], &out[3][o] };
+			plan.run(15u, in, dst, width);
+		}
+	};
+	const auto copy = [&](int first, int last) {
+		const size_t o = size_t(first) * width, n = size_t(last - first) * width;
+		for (int c = 0; c < 4; ++c)
+			std::memcpy(&out[c][o], &frame.planes[c][o], n * sizeof(float));
+	};
+	const auto triad = [&](int first, int last) {
+		const size_t o = size_t(first) * width, n = size_t(last - first) * width;
+		for (int c = 0; c < 4; ++c) {
+			const float* b = &frame.planes[c][o];
+			const float* d = &frame.planes[(c + 1) & 3][o];
+			float* a = &out[c][o];
+			for (size_t i = 0; i < n; ++i)
+				a[i] = b[i] + 3.0f * d[i];
+		}
+	};
+
+	std::printf("%dx%d P pass, %s x%d, projection%s, %.0f MiB per frame\n",
+	            frame.width, frame.height, isaName(plan.variant.isa), plan.variant.unroll,
+	            wDivide ? " with w_divide" : "", double(pixels) * 32.0 / (1024.0 * 1024.0));
+	std::printf("%7s %9s %9s %8s %6s %9s %10s %10s %7s  %s\n", "threads", "ms/frame", "Mpx/s", "speedup",
+	            "eff", "GB/s", "copy GB/s", "triad GB/s", "of roof", "bound");
+
+	double single = 0.0;
+	for (int t : threadCounts(maxThreads)) {
+		const double s = bestOf(passes, t, frame.height, kernel);
+		const double sCopy = bestOf(passes, t, frame.height, copy);
+		const double sTriad = bestOf(passes, t, frame.height, triad);
+		if (t == 1)
+			single = s;
+
+		const double gbs = double(pixels) * 32.0 / s * 1e-9;
+		const double copyGbs = double(pixels) * 32.0 / sCopy * 1e-9;
+		const double triadGbs = double(pixels) * 48.0 / sTriad * 1e-9;
+		const double roof = std::max(copyGbs, triadGbs);
+		const double speedup = single / s;
+		std::printf("%7d %9.2f %9.0f %7.2fx %5.0f%% %9.1f %10.1f %10.1f %6.0f%%  %s\n",
+		            t, s * 1e3, double(pixels) / s * 1e-6, speedup, 100.0 * speedup / t,
+		            gbs, copyGbs, triadGbs, 100.0 * gbs / roof, gbs >= 0.8 * roof ? "bandwidth" : "compute");
+	}
+	return 0;
+}
+
+} // namespace c44
@@ -0,0 +1,456 @@
+// DDImage.cpp
+//
+// Out-of-line parts of the c44bench DDImage shim: knob creation and
+// storage, the op graph, rows and the PixelIop engine.
+
+#include "DDImage/CameraOp.h"
+#include "DDImage/Knobs.h"
+#include "DDImage/Matrix4.h"
+#include "DDImage/PixelIop.h"
+#include "DDImage/Row.h"
+
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+namespace DD {
+namespace Image {
+
+// ---------------------------------------------------------------------------
+// Knobs
+// ---------------------------------------------------------------------------
+
+Knob Knob::showPanel;
+
+void Knob::store(const OutputContext& oc)
+{
+	if (_provider && _provider->provideValuesEnabled(this, oc))
+		_provider->provideValues(_values.data(), _values.size(), this, oc);
+
+	switch (_type) {
+	case ENUMERATION:
+	case INT:
+		*static_cast<int*>(_storage) = int(_values[0]);
+		break;
+	case BOOL:
+		*static_cast<bool*>(_storage) = _values[0] != 0.0;
+		break;
+	case ARRAY: {
+		ConvolveArray* a = static_cast<ConvolveArray*>(_storage);
+		for (size_t i = 0; i < _values.size(); ++i)
+			a->storage[i] = float(_values[i]);
+		break;
+	}
+	case TEXT:
+		*static_cast<const char**>(_storage) = _text.c_str();
+		break;
+	case CHANNELS:
+		*static_cast<ChannelSet*>(_storage) = ChannelSet::fromBits(uint32_t(_values[0]));
+		break;
+	case DIVIDER:
+	case BUTTON:
+	case TAB:
+		break;
+	}
+}
+
+void Knob::set_text(const char* text)
+{
+	_text = text ? text : "";
+	if (_type == TEXT)
+		*static_cast<const char**>(_storage) = _text.c_str();
+}
+
+static Knob* addKnob(Knob_Callback f, Knob* k)
+{
+	f.knobs.push_back(k);
+	return k;
+}
+
+Knob* Enumeration_knob(Knob_Callback f, int* storage, const char* const* /*labels*/,
+                       const char* name, const char* /*label*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::ENUMERATION, name, storage, 1));
+	k->set_value(*storage);
+	return k;
+}
+
+Knob* Bool_knob(Knob_Callback f, bool* storage, const char* name, const char* /*label*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::BOOL, name, storage, 1));
+	k->set_value(*storage ? 1.0 : 0.0);
+	return k;
+}
+
+Knob* Int_knob(Knob_Callback f, int* storage, const char* name, const char* /*label*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::INT, name, storage, 1));
+	k->set_value(*storage);
+	return k;
+}
+
+Knob* Array_knob(Knob_Callback f, ConvolveArray* storage, int width, int height,
+                 const char* name, const char* /*label*/)
+{
+	const size_t n = size_t(width) * size_t(height);
+	storage->width = width;
+	storage->height = height;
+	storage->storage.assign(n, 0.0f);
+	storage->array = storage->storage.data();
+
+	Knob* k = addKnob(f, new Knob(Knob::ARRAY, name, storage, n));
+	if (width == height)
+		for (int i = 0; i < width; ++i)
+			k->set_value(1.0, i * width + i);
+	k->store(OutputContext());
+	return k;
+}
+
+Knob* String_knob(Knob_Callback f, const char** storage, const char* name, const char* /*label*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::TEXT, name, storage, 0));
+	k->set_text(*storage);
+	return k;
+}
+
+Knob* Multiline_String_knob(Knob_Callback f, const char** storage, const char* name,
+                            const char* /*label*/, int /*lines*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::TEXT, name, storage, 0));
+	k->set_text(*storage);
+	return k;
+}
+
+Knob* ChannelSet_knob(Knob_Callback f, ChannelSet* storage, const char* name, const char* /*label*/)
+{
+	Knob* k = addKnob(f, new Knob(Knob::CHANNELS, name, storage, 1));
+	k->set_value(double(storage->bits()));
+	return k;
+}
+
+Knob* Input_ChannelSet_knob(Knob_Callback f, ChannelSet* storage, int /*input*/,
+                            const char* name, const char* label)
+{
+	return ChannelSet_knob(f, storage, name, label);
+}
+
+Knob* Button(Knob_Callback f, const char* name, const char* /*label*/)
+{
+	return addKnob(f, new Knob(Knob::BUTTON, name));
+}
+
+Knob* Tab_knob(Knob_Callback f, const char* /*label*/)
+{
+	return addKnob(f, new Knob(Knob::TAB));
+}
+
+Knob* Divider(Knob_Callback f, const char* /*label*/)
+{
+	return addKnob(f, new Knob());
+}
+
+void SetFlags(Knob_Callback f, int flags)
+{
+	if (Knob* k = f.last())
+		k->set_flag(flags);
+}
+
+void Tooltip(Knob_Callback f, const char* text)
+{
+	if (Knob* k = f.last())
+		k->tooltip(text);
+}
+
+void SetValueProvider(Knob_Callback f, ValueProvider* provider)
+{
+	if (Knob* k = f.last())
+		k->setValueProvider(provider);
+}
+
+
+// ---------------------------------------------------------------------------
+// Op
+// ---------------------------------------------------------------------------
+
+Op* Op::input(int n) const
+{
+	return node_input(n);
+}
+
+Op* Op::node_input(int n, GenerateType /*type*/, const OutputContext* oc) const
+{
+	Op* op = size_t(n) < _inputs.size() ? _inputs[size_t(n)] : nullptr;
+	return op ? op->atContext(oc ? *oc : _context) : default_input(n);
+}
+
+bool Op::set_input(int n, Op* op)
+{
+	if (op && !test_input(n, op))
+		return false;
+	if (_inputs.size() <= size_t(n))
+		_inputs.resize(size_t(n) + 1, nullptr);
+	_inputs[size_t(n)] = op;
+	invalidate();
+	return true;
+}
+
+Knob* Op::knob(const char* name) const
+{
+	for (Knob* k : _knobPtrs)
+		if (k->is(name))
+			return k;
+	return nullptr;
+}
+
+void Op::buildKnobs()
+{
+	_knobPtrs.clear();
+	_knobs.clear();
+	Knob_Closure f{ _knobPtrs };
+	knobs(f);
+	for (Knob* k : _knobPtrs)
+		_knobs.emplace_back(k);
+	knob_changed(&Knob::showPanel);
+}
+
+void Op::setOutputContext(const OutputContext& oc)
+{
+	_context = oc;
+	for (Knob* k : _knobPtrs)
+		k->store(oc);
+	invalidate();
+}
+
+void Op::validate(bool for_real)
+{
+	if (_valid)
+		return;
+	_warning.clear();
+	_error.clear();
+	_validate(for_real);
+	_valid = true;
+}
+
+void Op::warning(const char* format, ...)
+{
+	char text[512];
+	va_list args;
+	va_start(args, format);
+	std::vsnprintf(text, sizeof text, format, args);
+	va_end(args);
+	_warning = text;
+}
+
+void Op::error(const char* format, ...)
+{
+	char text[512];
+	va_list args;
+	va_start(args, format);
+	std::vsnprintf(text, sizeof text, format, args);
+	va_end(args);
+	_error = text;
+}
+
+
+// ---------------------------------------------------------------------------
+// Iop
+// ---------------------------------------------------------------------------
+
+static std::map<std::string, const Iop::Description*>& registry()
+{
+	static std::map<std::string, const Iop::Description*> r;
+	return r;
+}
+
+Iop::Description::Description(const char* name_, const char* menu_, Iop* (*constructor_)(Node*))
+	: name(name_), menu(menu_), constructor(constructor_)
+{
+	registry()[name] = this;
+}
+
+const Iop::Description* Iop::Description::find(const char* name)
+{
+	auto it = registry().find(name);
+	return it == registry().end() ? nullptr : it->second;
+}
+
+void Iop::_validate(bool /*for_real*/)
+{
+	copy_info();
+	set_out_channels(info_.channels());
+}
+
+void Iop::copy_info()
+{
+	Iop* in = input(0);
+	if (!in)
+		throw std::runtime_error(std::string(Class()) + ": input 0 is not an image");
+	in->validate();
+	info_ = in->info();
+}
+
+const MetaData::Bundle& Iop::_fetchMetaData(const char* key)
+{
+	static const MetaData::Bundle none;
+	Iop* in = input(0);
+	return in ? in->fetchMetaData(key) : none;
+}
+
+void Iop::_request(int x, int y, int r, int t, ChannelMask channels, int count)
+{
+	if (Iop* in = input(0))
+		in->request(x, y, r, t, channels, count);
+}
+
+void PixelIop::engine(int y, int x, int r, ChannelMask channels, Row& out)
+{
+	ChannelSet compute = channels & out_channels();
+	ChannelSet want = channels;
+	in_channels(0, want);
+	input0().get(y, x, r, want, _in);
+
+	if (!compute.empty())
+		pixel_engine(_in, y, x, r, compute, out);
+
+	ChannelSet pass = channels;
+	pass -= compute;
+	out.copy(_in, pass, x, r);
+}
+
+
+// ---------------------------------------------------------------------------
+// Row
+// ---------------------------------------------------------------------------
+
+void Row::range(int x, int r)
+{
+	_x = x;
+	_r = r;
+	_zeros.assign(size_t(r - x), 0.0f);
+	for (const float*& p : _read)
+		p = nullptr;
+}
+
+float* Row::writable(Channel z)
+{
+	if (_buf[z].size() < size_t(_r - _x))
+		_buf[z].resize(size_t(_r - _x));
+	float* p = _buf[z].data() - _x;
+	_read[z] = p;
+	return p;
+}
+
+void Row::copy(const Row& source, ChannelMask set, int x, int r)
+{
+	const bool share = x == _x && r == _r && source._x <= x && r <= source._r;
+	foreach (z, set) {
+		if (share)
+			_read[z] = source[z];
+		else
+			std::memcpy(writable(z) + x, source[z] + x, sizeof(float) * size_t(r - x));
+	}
+}
+
+
+// ---------------------------------------------------------------------------
+// Camera / Matrix4
+// ---------------------------------------------------------------------------
+
+void CameraOp::ToFormat(fdk::Mat4f& m, const Format* format)
+{
+	const float w = float(format->width()), h = float(format->height());
+	m.setToIdentity();
+	m.array()[0]  = w * 0.5f;
+	m.array()[5]  = w * 0.5f;
+	m.array()[12] = w * 0.5f;
+	m.array()[13] = h * 0.5f;
+}
+
+void AxisOp::animate(double step, double validateNs)
+{
+	_step = step;
+	_validateNs = validateNs;
+	_copies.clear();
+}
+
+Op* AxisOp::atContext(const OutputContext& oc)
+{
+	if (_original || (_step == 0.0 && _validateNs == 0.0))
+		return this;
+
+	std::unique_ptr<AxisOp>& copy = _copies[std::make_pair(oc.frame(), oc.view())];
+	if (!copy) {
+		copy.reset(newCopy());
+		copy->_original = this;
+		copy->_world = _world;
+		copy->_world.array()[12] += _step * oc.frame();
+		copy->_validateNs = _validateNs;
+		copy->setOutputContext(oc);
+	}
+	return copy.get();
+}
+
+Hash AxisOp::hash() const
+{
+	Hash h;
+	h.append(_world.array(), sizeof(double) * 16);
+	return h;
+}
+
+void AxisOp::_validate(bool /*for_real*/)
+{
+	typedef std::chrono::steady_clock Clock;
+	const Clock::time_point end = Clock::now() + std::chrono::nanoseconds(int64_t(_validateNs));
+	while (Clock::now() < end) {}
+}
+
+AxisOp* CameraOp::newCopy() const
+{
+	CameraOp* c = new CameraOp;
+	c->_projection = _projection;
+	return c;
+}
+
+CameraOp* CameraOp::default_camera()
+{
+	static CameraOp camera;
+	return &camera;
+}
+
+// Cofactor expansion, as in the usual 4x4 inverse; singular matrices give
+// the identity.
+Matrix4 Matrix4::inverse() const
+{
+	const float* m = _a;
+	float inv[16];
+	inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+	inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+	inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+	inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+	inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+	inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+	inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+	inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+	const float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+	if (det == 0.0f)
+		return Matrix4();
+	for (float& v : inv)
+		v /= det;
+	return Matrix4(inv);
+}
+
+} // namespace Image
+} // namespace DD
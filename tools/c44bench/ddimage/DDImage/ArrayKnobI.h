@@ -0,0 +1,17 @@
+// ArrayKnobI.h (c44bench DDImage shim)
+
+#pragma once
+
+namespace DD {
+namespace Image {
+
+// Interface of array-valued knobs. Nothing is called through it; it is only
+// passed to ValueProvider.
+class ArrayKnobI
+{
+public:
+	virtual ~ArrayKnobI() {}
+};
+
+} // namespace Image
+} // namespace DD
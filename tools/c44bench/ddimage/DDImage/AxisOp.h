@@ -0,0 +1,48 @@
+// AxisOp.h (c44bench DDImage shim)
+//
+// An axis whose transform is set directly by the harness. animate() makes
+// it vary over time, as a keyed axis under a deep hierarchy does: at each
+// frame it translates by 'step' along x, and its validate() spins for the
+// given time. It then hands out one copy of itself per context.
+
+#pragma once
+
+#include "Matrix4.h"
+#include "Op.h"
+
+#include <map>
+#include <memory>
+#include <utility>
+
+namespace DD {
+namespace Image {
+
+class AxisOp : public Op
+{
+	fdk::Mat4d _world;
+	double     _step = 0.0, _validateNs = 0.0;
+	AxisOp*    _original = nullptr;
+
+	std::map<std::pair<double, int>, std::unique_ptr<AxisOp>> _copies;
+
+public:
+	explicit AxisOp(Node* node = nullptr) : Op(node) {}
+
+	const char* Class() const override { return "Axis"; }
+	int minimum_inputs() const override { return 0; }
+	int maximum_inputs() const override { return 0; }
+
+	const fdk::Mat4d worldTransform() const { return _world; }
+	void setWorldTransform(const fdk::Mat4d& m) { _world = m; }
+	void animate(double step, double validateNs);
+
+	Op* atContext(const OutputContext& oc) override;
+	Hash hash() const override;
+
+protected:
+	void _validate(bool for_real) override;
+	virtual AxisOp* newCopy() const { return new AxisOp; }
+};
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,34 @@
+// CameraOp.h (c44bench DDImage shim)
+
+#pragma once
+
+#include "AxisOp.h"
+
+namespace DD {
+namespace Image {
+
+class CameraOp : public AxisOp
+{
+	fdk::Mat4d _projection;
+
+public:
+	explicit CameraOp(Node* node = nullptr) : AxisOp(node) {}
+
+	const char* Class() const override { return "Camera"; }
+
+	const fdk::Mat4d projectionMatrix() const { return _projection; }
+	void setProjectionMatrix(const fdk::Mat4d& m) { _projection = m; }
+
+	// Maps -1..1 across the width of 'format' to 0..width, with y scaled
+	// the same way and centred on the format's height.
+	static void ToFormat(fdk::Mat4f& m, const Format* format);
+
+	// Identity camera used for an unconnected camera input.
+	static CameraOp* default_camera();
+
+protected:
+	AxisOp* newCopy() const override;
+};
+
+} // namespace Image
+} // namespace DD
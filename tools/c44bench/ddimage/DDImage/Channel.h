@@ -0,0 +1,86 @@
+// Channel.h (c44bench DDImage shim)
+//
+// Channels and channel sets. Only the first 32 channels exist; that covers
+// rgba and a handful of extra layers, which is all a benchmark needs.
+
+#pragma once
+
+#include <cstdint>
+
+namespace DD {
+namespace Image {
+
+enum Channel
+{
+	Chan_Black = 0,
+	Chan_Red, Chan_Green, Chan_Blue, Chan_Alpha,
+	Chan_Z,
+	Chan_Last = 31
+};
+
+enum ChannelSetInit
+{
+	Mask_None  = 0,
+	Mask_Red   = 1 << Chan_Red,
+	Mask_Green = 1 << Chan_Green,
+	Mask_Blue  = 1 << Chan_Blue,
+	Mask_Alpha = 1 << Chan_Alpha,
+	Mask_RGB   = Mask_Red | Mask_Green | Mask_Blue,
+	Mask_RGBA  = Mask_RGB | Mask_Alpha,
+	Mask_Z     = 1 << Chan_Z,
+	Mask_All   = int(0x7ffffffe)
+};
+
+class ChannelSet
+{
+	uint32_t _bits;
+
+public:
+	ChannelSet() : _bits(0) {}
+	ChannelSet(ChannelSetInit init) : _bits(uint32_t(init)) {}
+	ChannelSet(Channel z) : _bits(z == Chan_Black ? 0u : 1u << z) {}
+
+	bool contains(Channel z) const { return z != Chan_Black && (_bits >> z) & 1u; }
+	bool empty() const { return _bits == 0; }
+	unsigned size() const
+	{
+		unsigned n = 0;
+		for (uint32_t b = _bits; b; b &= b - 1)
+			++n;
+		return n;
+	}
+
+	ChannelSet& operator+=(const ChannelSet& s) { _bits |= s._bits; return *this; }
+	ChannelSet& operator-=(const ChannelSet& s) { _bits &= ~s._bits; return *this; }
+	ChannelSet& operator&=(const ChannelSet& s) { _bits &= s._bits; return *this; }
+	ChannelSet& operator+=(Channel z) { return *this += ChannelSet(z); }
+	ChannelSet& operator-=(Channel z) { return *this -= ChannelSet(z); }
+	ChannelSet& operator+=(ChannelSetInit m) { return *this += ChannelSet(m); }
+	ChannelSet& operator-=(ChannelSetInit m) { return *this -= ChannelSet(m); }
+
+	// The shim's channel knobs store a set as its bits.
+	uint32_t bits() const { return _bits; }
+	static ChannelSet fromBits(uint32_t bits) { ChannelSet s; s._bits = bits & ~1u; return s; }
+
+	bool operator==(const ChannelSet& s) const { return _bits == s._bits; }
+	bool operator!=(const ChannelSet& s) const { return _bits != s._bits; }
+
+	// Channels in ascending order, Chan_Black past the last one.
+	Channel first() const { return next(Chan_Black); }
+	Channel next(Channel z) const
+	{
+		for (int c = int(z) + 1; c <= int(Chan_Last); ++c)
+			if ((_bits >> c) & 1u)
+				return Channel(c);
+		return Chan_Black;
+	}
+};
+
+typedef const ChannelSet& ChannelMask;
+
+inline ChannelSet operator&(ChannelSet a, const ChannelSet& b) { return a &= b; }
+
+#define foreach(z, set) for (DD::Image::Channel z = (set).first(); z; z = (set).next(z))
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,20 @@
+// Convolve.h (c44bench DDImage shim)
+
+#pragma once
+
+#include <vector>
+
+namespace DD {
+namespace Image {
+
+// Storage of an Array_knob: 'array' points at width * height floats, row
+// after row, once the knob has been created.
+struct ConvolveArray
+{
+	int                width = 0, height = 0;
+	float*             array = nullptr;
+	std::vector<float> storage;
+};
+
+} // namespace Image
+} // namespace DD
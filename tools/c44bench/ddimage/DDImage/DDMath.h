@@ -0,0 +1,6 @@
+// DDMath.h (c44bench DDImage shim)
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
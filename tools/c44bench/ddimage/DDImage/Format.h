@@ -0,0 +1,33 @@
+// Format.h (c44bench DDImage shim)
+
+#pragma once
+
+namespace DD {
+namespace Image {
+
+class Node {};
+
+class Format
+{
+	int _w, _h;
+
+public:
+	Format(int w = 2048, int h = 1556) : _w(w), _h(h) {}
+	int width()  const { return _w; }
+	int height() const { return _h; }
+};
+
+class OutputContext
+{
+	double _frame;
+	int    _view;
+
+public:
+	OutputContext(double frame = 1.0, int view = 1) : _frame(frame), _view(view) {}
+	double frame() const { return _frame; }
+	int    view()  const { return _view; }
+	void   setFrame(double f) { _frame = f; }
+};
+
+} // namespace Image
+} // namespace DD
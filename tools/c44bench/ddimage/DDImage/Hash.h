@@ -0,0 +1,38 @@
+// Hash.h (c44bench DDImage shim)
+//
+// 64-bit FNV-1a over whatever is appended, in place of DDImage's hash.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace DD {
+namespace Image {
+
+class Hash
+{
+	uint64_t _v = 14695981039346656037ull;
+
+public:
+	void append(const void* data, size_t n)
+	{
+		const unsigned char* p = static_cast<const unsigned char*>(data);
+		for (size_t i = 0; i < n; ++i)
+			_v = (_v ^ p[i]) * 1099511628211ull;
+	}
+	void append(int v)    { append(&v, sizeof v); }
+	void append(double v) { append(&v, sizeof v); }
+	void append(const Hash& h) { append(&h._v, sizeof h._v); }
+	void append(const char* s)
+	{
+		for (; s && *s; ++s)
+			append(s, 1);
+		append(s, 1);
+	}
+
+	uint64_t value() const { return _v; }
+};
+
+} // namespace Image
+} // namespace DD
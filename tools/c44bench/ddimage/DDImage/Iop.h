@@ -0,0 +1,86 @@
+// Iop.h (c44bench DDImage shim)
+
+#pragma once
+
+#include "Channel.h"
+#include "MetaData.h"
+#include "Op.h"
+#include "Row.h"
+
+namespace DD {
+namespace Image {
+
+class IopInfo
+{
+	ChannelSet _channels;
+	Format     _format;
+	bool       _blackOutside = false;
+
+public:
+	const ChannelSet& channels() const { return _channels; }
+	void set_channels(const ChannelSet& c) { _channels = c; }
+	void turn_on(const ChannelSet& c) { _channels += c; }
+	const Format& format() const { return _format; }
+	void set_format(const Format& f) { _format = f; }
+	void black_outside(bool b) { _blackOutside = b; }
+};
+
+
+class Iop : public Op
+{
+public:
+	explicit Iop(Node* node) : Op(node) {}
+
+	// Registry of Iop classes by name, in place of Nuke's plug-in loader.
+	struct Description
+	{
+		const char* name;
+		const char* menu;
+		Iop* (*constructor)(Node*);
+
+		Description(const char* name, const char* menu, Iop* (*constructor)(Node*));
+		static const Description* find(const char* name);
+	};
+
+	Iop* input(int n) const { return dynamic_cast<Iop*>(Op::input(n)); }
+	Iop& input0() const { return *input(0); }
+
+	bool test_input(int n, Op* op) const override { return n == 0 && dynamic_cast<Iop*>(op); }
+
+	virtual bool pass_transform() const { return false; }
+	virtual void in_channels(int /*input*/, ChannelSet& /*mask*/) const {}
+
+	const IopInfo& info() const { return info_; }
+	const ChannelSet& out_channels() const { return _outChannels; }
+	const Format& input_format() const { return input0().info().format(); }
+
+	void request(int x, int y, int r, int t, ChannelMask channels, int count)
+	{
+		_request(x, y, r, t, channels, count);
+	}
+	// Metadata of this op's output; by default that of input 0.
+	const MetaData::Bundle& fetchMetaData(const char* key) { return _fetchMetaData(key); }
+
+	// Fills 'row' from x to r with 'channels' of line y.
+	void get(int y, int x, int r, ChannelMask channels, Row& row)
+	{
+		row.range(x, r);
+		engine(y, x, r, channels, row);
+	}
+
+protected:
+	void _validate(bool for_real) override;
+	virtual void _request(int x, int y, int r, int t, ChannelMask channels, int count);
+	virtual void engine(int y, int x, int r, ChannelMask channels, Row& row) = 0;
+	virtual const MetaData::Bundle& _fetchMetaData(const char* key);
+
+	// Takes the info of input 0 and validates it first.
+	void copy_info();
+	void set_out_channels(const ChannelSet& c) { _outChannels = c; }
+
+	IopInfo    info_;
+	ChannelSet _outChannels;
+};
+
+} // namespace Image
+} // namespace DD
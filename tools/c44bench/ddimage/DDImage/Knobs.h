@@ -0,0 +1,104 @@
+// Knobs.h (c44bench DDImage shim)
+//
+// Knobs hold their values as doubles and copy them into the op's member
+// variables on Knob::store(), which Op::setOutputContext calls for every
+// knob, as Nuke does before validate. There is no animation: get_value_at
+// returns the stored value at any frame. An enabled ValueProvider replaces
+// the stored values of its knob at each context, through the buffer
+// overload of provideValues. Channel knobs hold their set as
+// ChannelSet::bits().
+
+#pragma once
+
+#include "ArrayKnobI.h"
+#include "Channel.h"
+#include "Convolve.h"
+#include "ValueProvider.h"
+
+#include <string>
+#include <vector>
+
+namespace DD {
+namespace Image {
+
+class Op;
+
+class Knob : public ArrayKnobI
+{
+public:
+	enum Type { DIVIDER, ENUMERATION, BOOL, INT, ARRAY, TEXT, CHANNELS, BUTTON, TAB };
+	enum Flags { STARTLINE = 1, READ_ONLY = 2, DO_NOT_WRITE = 4, NO_ANIMATION = 8 };
+
+	// Passed to knob_changed when the panel opens.
+	static Knob showPanel;
+
+	Knob(Type type = DIVIDER, const char* name = "", void* storage = nullptr, size_t count = 0)
+		: _type(type), _name(name), _storage(storage), _values(count, 0.0)
+	{}
+
+	const char* name() const { return _name.c_str(); }
+	bool is(const char* name) const { return _name == name; }
+
+	double get_value(int index = 0) const { return _values[size_t(index)]; }
+	double get_value_at(double /*frame*/, int /*view*/, int index = 0) const { return get_value(index); }
+	void   set_value(double v, int index = 0) { _values[size_t(index)] = v; }
+	size_t size() const { return _values.size(); }
+
+	// Text knobs.
+	void        set_text(const char* text);
+	const char* get_text() const { return _text.c_str(); }
+
+	void visible(bool v) { _visible = v; }
+	bool isVisible() const { return _visible; }
+	void set_flag(int flags) { _flags |= flags; }
+	void tooltip(const char* text) { _tooltip = text; }
+	void setValueProvider(ValueProvider* p) { _provider = p; }
+
+	// Pulls provided values for 'oc' if the provider is on, then writes the
+	// values into the op's storage.
+	void store(const OutputContext& oc);
+
+private:
+	Type                _type;
+	std::string         _name, _tooltip, _text;
+	void*               _storage;
+	std::vector<double> _values;
+	ValueProvider*      _provider = nullptr;
+	int                 _flags = 0;
+	bool                _visible = true;
+};
+
+
+// Collects the knobs an op creates in Op::knobs().
+struct Knob_Closure
+{
+	std::vector<Knob*>& knobs;
+	Knob* last() const { return knobs.empty() ? nullptr : knobs.back(); }
+};
+typedef Knob_Closure& Knob_Callback;
+
+Knob* Enumeration_knob(Knob_Callback f, int* storage, const char* const* labels,
+                       const char* name, const char* label = nullptr);
+Knob* Bool_knob(Knob_Callback f, bool* storage, const char* name, const char* label = nullptr);
+Knob* Int_knob(Knob_Callback f, int* storage, const char* name, const char* label = nullptr);
+// A square array starts out as the identity, anything else as zeros.
+Knob* Array_knob(Knob_Callback f, ConvolveArray* storage, int width, int height,
+                 const char* name, const char* label = nullptr);
+Knob* String_knob(Knob_Callback f, const char** storage, const char* name,
+                  const char* label = nullptr);
+Knob* Multiline_String_knob(Knob_Callback f, const char** storage, const char* name,
+                            const char* label = nullptr, int lines = 5);
+Knob* ChannelSet_knob(Knob_Callback f, ChannelSet* storage, const char* name,
+                      const char* label = nullptr);
+Knob* Input_ChannelSet_knob(Knob_Callback f, ChannelSet* storage, int input,
+                            const char* name, const char* label = nullptr);
+Knob* Button(Knob_Callback f, const char* name, const char* label = nullptr);
+Knob* Tab_knob(Knob_Callback f, const char* label);
+Knob* Divider(Knob_Callback f, const char* label = nullptr);
+void  SetFlags(Knob_Callback f, int flags);
+inline void SetRange(Knob_Callback, double /*min*/, double /*max*/) {}
+void  Tooltip(Knob_Callback f, const char* text);
+void  SetValueProvider(Knob_Callback f, ValueProvider* provider);
+
+} // namespace Image
+} // namespace DD
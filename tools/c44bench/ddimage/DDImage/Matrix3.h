@@ -0,0 +1,25 @@
+// Matrix3.h (c44bench DDImage shim)
+
+#pragma once
+
+#include "Matrix4.h"
+
+namespace DD {
+namespace Image {
+
+class Matrix3
+{
+	float _a[9];
+
+public:
+	Matrix3() { makeIdentity(); }
+	void makeIdentity()
+	{
+		for (int i = 0; i < 9; ++i)
+			_a[i] = (i % 4 == 0) ? 1.0f : 0.0f;
+	}
+	const float* array() const { return _a; }
+};
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,123 @@
+// Matrix4.h (c44bench DDImage shim)
+//
+// The parts of DD::Image::Matrix4 / Vector4 and fdk::Mat4f / Mat4d that the
+// plugin uses, with the same column-major storage: array()[col * 4 + row].
+
+#pragma once
+
+#include <cmath>
+
+namespace fdk {
+
+template <typename T>
+struct Mat4
+{
+	T m[16];
+
+	Mat4() { setToIdentity(); }
+	void setToIdentity()
+	{
+		for (int i = 0; i < 16; ++i)
+			m[i] = (i % 5 == 0) ? T(1) : T(0);
+	}
+	const T* array() const { return m; }
+	T*       array()       { return m; }
+};
+
+typedef Mat4<float>  Mat4f;
+typedef Mat4<double> Mat4d;
+
+} // namespace fdk
+
+
+namespace DD {
+namespace Image {
+
+class Vector4
+{
+public:
+	float x, y, z, w;
+
+	Vector4() : x(0), y(0), z(0), w(1) {}
+	Vector4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+};
+
+
+class Matrix4
+{
+	float _a[16];
+
+public:
+	Matrix4() { makeIdentity(); }
+	explicit Matrix4(const float* a)
+	{
+		for (int i = 0; i < 16; ++i)
+			_a[i] = a[i];
+	}
+
+	const float* array() const { return _a; }
+	float  operator()(int row, int col) const { return _a[col * 4 + row]; }
+	float& operator()(int row, int col)       { return _a[col * 4 + row]; }
+
+	void makeIdentity()
+	{
+		for (int i = 0; i < 16; ++i)
+			_a[i] = (i % 5 == 0) ? 1.0f : 0.0f;
+	}
+
+	void transpose()
+	{
+		for (int r = 0; r < 4; ++r)
+			for (int c = r + 1; c < 4; ++c) {
+				const float t = (*this)(r, c);
+				(*this)(r, c) = (*this)(c, r);
+				(*this)(c, r) = t;
+			}
+	}
+
+	Matrix4 inverse() const;
+
+	// Keep only the translation column / the rotation with scale removed /
+	// the per-axis scale.
+	void translationOnly()
+	{
+		const float tx = _a[12], ty = _a[13], tz = _a[14];
+		makeIdentity();
+		_a[12] = tx;
+		_a[13] = ty;
+		_a[14] = tz;
+	}
+
+	void rotationOnly()
+	{
+		Matrix4 r;
+		for (int c = 0; c < 3; ++c) {
+			const float* col = _a + c * 4;
+			const float len = std::sqrt(col[0] * col[0] + col[1] * col[1] + col[2] * col[2]);
+			for (int k = 0; k < 3; ++k)
+				r._a[c * 4 + k] = len > 0.0f ? col[k] / len : 0.0f;
+		}
+		*this = r;
+	}
+
+	void scaleOnly()
+	{
+		Matrix4 s;
+		for (int c = 0; c < 3; ++c) {
+			const float* col = _a + c * 4;
+			s._a[c * 5] = std::sqrt(col[0] * col[0] + col[1] * col[1] + col[2] * col[2]);
+		}
+		*this = s;
+	}
+
+	Vector4 transform(const Vector4& v) const
+	{
+		return Vector4(_a[0] * v.x + _a[4] * v.y + _a[8]  * v.z + _a[12] * v.w,
+		               _a[1] * v.x + _a[5] * v.y + _a[9]  * v.z + _a[13] * v.w,
+		               _a[2] * v.x + _a[6] * v.y + _a[10] * v.z + _a[14] * v.w,
+		               _a[3] * v.x + _a[7] * v.y + _a[11] * v.z + _a[15] * v.w);
+	}
+};
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,43 @@
+// MetaData.h (c44bench DDImage shim)
+//
+// A metadata bundle holding numeric properties only, as vectors of
+// doubles, with the free functions the plugin reads them through.
+
+#pragma once
+
+#include "Hash.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace DD {
+namespace Image {
+namespace MetaData {
+
+typedef std::vector<double> Property;
+
+inline size_t propertySize(const Property& p) { return p.size(); }
+inline double propertyDouble(const Property& p, size_t index = 0) { return p[index]; }
+
+class Bundle
+{
+	std::map<std::string, Property> _data;
+
+public:
+	// An empty property when 'key' is not set.
+	const Property& getData(const std::string& key) const
+	{
+		static const Property none;
+		auto it = _data.find(key);
+		return it == _data.end() ? none : it->second;
+	}
+	void setData(const std::string& key, const std::vector<double>& values) { _data[key] = values; }
+	void erase(const std::string& key) { _data.erase(key); }
+	bool empty() const { return _data.empty(); }
+	size_t size() const { return _data.size(); }
+};
+
+} // namespace MetaData
+} // namespace Image
+} // namespace DD
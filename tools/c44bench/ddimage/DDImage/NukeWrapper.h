@@ -0,0 +1,7 @@
+// NukeWrapper.h (c44bench DDImage shim)
+//
+// Nothing from this header is used by the plugin.
+
+#pragma once
+
+#include "PixelIop.h"
@@ -0,0 +1,93 @@
+// Op.h (c44bench DDImage shim)
+//
+// The node graph without Nuke: an op owns its knobs and a list of inputs,
+// unconnected inputs fall back to default_input(), and validate() calls
+// _validate() once until the next invalidate(). The harness calls
+// buildKnobs() after construction and setOutputContext() for each frame,
+// which is where Nuke would store the knobs. An op that varies over time
+// hands out a copy of itself per context from atContext(), which input()
+// and node_input() go through, as Nuke builds an op per context.
+
+#pragma once
+
+#include "Format.h"
+#include "Hash.h"
+#include "Knobs.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace DD {
+namespace Image {
+
+class Op
+{
+public:
+	enum GenerateType { OUTPUT_OP, INPUT_OP, EXECUTABLE, EXECUTABLE_INPUT };
+
+	explicit Op(Node* node) : _node(node) {}
+	virtual ~Op() {}
+
+	virtual const char* Class() const = 0;
+	virtual const char* node_help() const { return ""; }
+
+	virtual int minimum_inputs() const { return 1; }
+	virtual int maximum_inputs() const { return 1; }
+	virtual bool test_input(int /*n*/, Op* /*op*/) const { return true; }
+	virtual Op* default_input(int /*n*/) const { return nullptr; }
+	virtual const char* input_label(int /*n*/, char* /*buf*/) const { return nullptr; }
+
+	virtual void knobs(Knob_Callback) {}
+	virtual int knob_changed(Knob*) { return 0; }
+
+	// Every op is the first (and only) op of its node here.
+	Op* firstOp() const { return const_cast<Op*>(this); }
+
+	Op* input(int n) const;
+	// Input n as it is at 'oc', or at this op's context.
+	Op* node_input(int n, GenerateType type = OUTPUT_OP, const OutputContext* oc = nullptr) const;
+	virtual Op* atContext(const OutputContext& /*oc*/) { return this; }
+	virtual Hash hash() const
+	{
+		Hash h;
+		const Op* self = this;
+		h.append(&self, sizeof self);
+		return h;
+	}
+	// Connects 'op' to input n; false if test_input rejects it.
+	bool set_input(int n, Op* op);
+
+	Knob* knob(const char* name) const;
+	void buildKnobs();
+
+	const OutputContext& outputContext() const { return _context; }
+	void setOutputContext(const OutputContext& oc);
+
+	void validate(bool for_real = true);
+	void invalidate() { _valid = false; }
+	bool aborted() const { return false; }
+
+	// Nuke shows these on the node; here the last one of each is kept for
+	// the harness, and the next validate clears them.
+	void warning(const char* format, ...);
+	void error(const char* format, ...);
+	const std::string& lastWarning() const { return _warning; }
+	const std::string& lastError() const { return _error; }
+
+protected:
+	virtual void _validate(bool /*for_real*/) {}
+
+	Node*                              _node;
+	OutputContext                      _context;
+
+private:
+	std::vector<Op*>                   _inputs;
+	std::vector<Knob*>                 _knobPtrs;
+	std::vector<std::unique_ptr<Knob>> _knobs;
+	bool                               _valid = false;
+	std::string                        _warning, _error;
+};
+
+} // namespace Image
+} // namespace DD
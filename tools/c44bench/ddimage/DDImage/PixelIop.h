@@ -0,0 +1,27 @@
+// PixelIop.h (c44bench DDImage shim)
+
+#pragma once
+
+#include "Iop.h"
+
+namespace DD {
+namespace Image {
+
+// Gets each row from input 0 and hands the requested channels that are in
+// out_channels() to pixel_engine; the others are copied through.
+class PixelIop : public Iop
+{
+	Row _in;
+
+public:
+	explicit PixelIop(Node* node) : Iop(node), _in(0, 1) {}
+
+	virtual void pixel_engine(const Row& in, int y, int x, int r,
+	                          ChannelMask channels, Row& out) = 0;
+
+protected:
+	void engine(int y, int x, int r, ChannelMask channels, Row& out) override;
+};
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,47 @@
+// Row.h (c44bench DDImage shim)
+//
+// One scanline from x to r. Channels get their own buffer when first
+// written; reading a channel that was never written gives zeros. As in
+// Nuke, the pointers are offset so that row[z][x] is the first pixel, and
+// copying a whole row shares the source's buffer instead of the samples.
+
+#pragma once
+
+#include "Channel.h"
+
+#include <vector>
+
+namespace DD {
+namespace Image {
+
+class Row
+{
+	int                _x = 0, _r = 0;
+	std::vector<float> _buf[Chan_Last + 1];
+	const float*       _read[Chan_Last + 1] = {};   // null: zeros
+	std::vector<float> _zeros;
+
+public:
+	Row(int x, int r) { range(x, r); }
+
+	int getLeft()  const { return _x; }
+	int getRight() const { return _r; }
+
+	// Sets the span and forgets what was written; buffers are kept.
+	void range(int x, int r);
+
+	const float* operator[](Channel z) const
+	{
+		return _read[z] ? _read[z] : _zeros.data() - _x;
+	}
+	// Contents are undefined until written, as in Nuke.
+	float* writable(Channel z);
+	void   erase(Channel z) { _read[z] = nullptr; }
+
+	// Copies the channels in 'set' between x and r from 'source', which
+	// must outlive this row's use of them if they cover the whole row.
+	void copy(const Row& source, ChannelMask set, int x, int r);
+};
+
+} // namespace Image
+} // namespace DD
@@ -0,0 +1,40 @@
+// ValueProvider.h (c44bench DDImage shim)
+//
+// Same virtuals as Nuke 16.1: four pure ones and the buffer overload of
+// provideValues, which by default forwards to the vector one.
+
+#pragma once
+
+#include "ArrayKnobI.h"
+#include "Format.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace DD {
+namespace Image {
+
+class Knob;
+
+class ValueProvider
+{
+public:
+	virtual ~ValueProvider() {}
+
+	virtual std::vector<double> provideValues(const ArrayKnobI* arrayKnob,
+	                                          const OutputContext& oc) const = 0;
+	virtual bool provideValuesEnabled(const Knob* knob, const OutputContext& oc) const = 0;
+	virtual bool isDefault(const Knob* knob, const OutputContext& oc) const = 0;
+	virtual bool isAnimated(const Knob* knob, const OutputContext& oc) const = 0;
+
+	virtual void provideValues(double* values, size_t nValues,
+	                           const ArrayKnobI* arrayKnob, const OutputContext& oc) const
+	{
+		const std::vector<double> v = provideValues(arrayKnob, oc);
+		std::copy_n(v.begin(), std::min(nValues, v.size()), values);
+	}
+};
+
+} // namespace Image
+} // namespace DD